@@ -2,11 +2,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
 
 #include <time.h>
 #include <unistd.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
 
+#include "libmatrix/app.h"
 #include "libmatrix/matrix.h"
+#include "libmatrix/task.h"
 
 int test_rev() {
     struct mat2d *mat = mat2d_create(2, 2);
@@ -57,9 +63,1621 @@ int test_dot() {
     return rc;
 }
 
+static struct mat2d *naive_dot(struct mat2d *left, struct mat2d *right) {
+    struct mat2d *result = mat2d_create(mat2d_get_rows(left), mat2d_get_cols(right));
+    for (size_t i = 0; i < mat2d_get_rows(left); i++) {
+        for (size_t j = 0; j < mat2d_get_cols(right); j++) {
+            double acc = 0.0;
+            for (size_t k = 0; k < mat2d_get_cols(left); k++) {
+                acc += mat2d_get(left, i, k) * mat2d_get(right, k, j);
+            }
+            mat2d_set(result, i, j, acc);
+        }
+    }
+    return result;
+}
+
+int test_dot_blocked() {
+    // Odd shapes exercise the partial register tiles and several cache blocks
+    size_t shapes[][3] = { { 3, 5, 7 }, { 97, 301, 53 }, { 250, 260, 270 } };
+    int rc = 0;
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        struct mat2d *mat1 = mat2d_create(shapes[s][0], shapes[s][1]);
+        struct mat2d *mat2 = mat2d_create(shapes[s][1], shapes[s][2]);
+        mat2d_fill_random(mat1);
+        mat2d_fill_random(mat2);
+
+        struct mat2d *result = NULL;
+        struct mat2d *expected = naive_dot(mat1, mat2);
+        mat2d_dot(&result, mat1, mat2);
+        if (!mat2d_eq(result, expected)) {
+            printf("Blocked product mismatch for %zux%zux%zu\n",
+                shapes[s][0], shapes[s][1], shapes[s][2]);
+            rc = -1;
+        }
+
+        mat2d_destroy(mat1);
+        mat2d_destroy(mat2);
+        mat2d_destroy(result);
+        mat2d_destroy(expected);
+    }
+
+    printf("test_dot_blocked: %s\n", rc == 0 ? "ok" : "FAILED");
+    return rc;
+}
+
+int test_lu_solve() {
+    size_t n = 300, nrhs = 17;
+    struct mat2d *mat = mat2d_create(n, n);
+    struct mat2d *rhs = mat2d_create(n, nrhs);
+    mat2d_fill_random(mat);
+    mat2d_fill_random(rhs);
+
+    int rc = 0;
+    struct mat2d_lu *lu = NULL;
+    struct mat2d *x = NULL;
+    struct mat2d *check = NULL;
+    if ((rc = mat2d_lu_factor(&lu, mat)) == 0) {
+        mat2d_lu_solve(&x, lu, rhs);
+        mat2d_dot(&check, mat, x);
+        if (!mat2d_eq(check, rhs)) {
+            rc = -1;
+        }
+    }
+
+    printf("test_lu_solve: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_lu_destroy(lu);
+    mat2d_destroy(mat);
+    mat2d_destroy(rhs);
+    mat2d_destroy(x);
+    mat2d_destroy(check);
+    return rc;
+}
+
+int test_inv_pivoting() {
+    // Zero leading diagonal: unsolvable without row exchanges
+    struct mat2d *mat = mat2d_create(3, 3);
+    mat2d_set(mat, 0, 1, 1.0);
+    mat2d_set(mat, 1, 0, 2.0);
+    mat2d_set(mat, 1, 2, 1.0);
+    mat2d_set(mat, 2, 2, 3.0);
+
+    struct mat2d *eye = mat2d_create(3, 3);
+    mat2d_fill_eye(eye);
+
+    int rc = 0;
+    struct mat2d *inv = NULL;
+    struct mat2d *check = NULL;
+    if ((rc = mat2d_inv(&inv, mat)) == 0) {
+        mat2d_dot(&check, mat, inv);
+        if (!mat2d_eq(check, eye)) {
+            rc = -1;
+        }
+    }
+
+    struct mat2d *singular = mat2d_create(3, 3);
+    mat2d_fill_one(singular);
+    struct mat2d *singular_inv = NULL;
+    if (mat2d_inv(&singular_inv, singular) != -1) {
+        rc = -1;
+    }
+
+    printf("test_inv_pivoting: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(mat);
+    mat2d_destroy(eye);
+    mat2d_destroy(inv);
+    mat2d_destroy(check);
+    mat2d_destroy(singular);
+    return rc;
+}
+
+int test_views() {
+    struct mat2d *mat = mat2d_create(120, 90);
+    mat2d_fill_random(mat);
+
+    int rc = 0;
+
+    // A transposed view must multiply like its materialized copy
+    struct mat2d *mat_t = mat2d_view_T(mat);
+    struct mat2d *mat_t_copy = NULL;
+    mat2d_clone(&mat_t_copy, mat_t);
+    struct mat2d *gram = NULL, *gram_copy = NULL;
+    mat2d_dot(&gram, mat_t, mat);
+    mat2d_dot(&gram_copy, mat_t_copy, mat);
+    if (!mat2d_eq(gram, gram_copy)) {
+        rc = -1;
+    }
+
+    // Writes through a submatrix view land in the parent
+    struct mat2d *sub = mat2d_view(mat, 10, 20, 30, 40);
+    mat2d_fill_value(sub, 7.0);
+    if (mat2d_get(mat, 10, 20) != 7.0 || mat2d_get(mat, 39, 59) != 7.0
+        || mat2d_get(mat, 40, 59) == 7.0) {
+        rc = -1;
+    }
+
+    // Square views invert like dense copies
+    struct mat2d *square = mat2d_view(mat, 5, 5, 60, 60);
+    struct mat2d *square_copy = NULL;
+    mat2d_clone(&square_copy, square);
+    struct mat2d *inv = NULL, *inv_copy = NULL;
+    mat2d_inv(&inv, square);
+    mat2d_inv(&inv_copy, square_copy);
+    if (!mat2d_eq(inv, inv_copy)) {
+        rc = -1;
+    }
+
+    // Every third row starting from the second
+    struct mat2d *shard = mat2d_view_rows_step(mat, 1, 3);
+    if (mat2d_get_rows(shard) != 40 || mat2d_get(shard, 2, 3) != mat2d_get(mat, 7, 3)) {
+        rc = -1;
+    }
+
+    printf("test_views: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(shard);
+    mat2d_destroy(inv);
+    mat2d_destroy(inv_copy);
+    mat2d_destroy(square_copy);
+    mat2d_destroy(square);
+    mat2d_destroy(sub);
+    mat2d_destroy(gram);
+    mat2d_destroy(gram_copy);
+    mat2d_destroy(mat_t_copy);
+    mat2d_destroy(mat_t);
+    mat2d_destroy(mat);
+    return rc;
+}
+
+int test_padded_alloc() {
+    const char *filename = "test_padded_alloc.bin";
+    int rc = 0;
+
+    struct mat2d *padded = mat2d_create_ex(33, 512, 0, MAT2D_ALLOC_PADDED);
+    struct mat2d *huge = mat2d_create_ex(16, 16, 0, MAT2D_ALLOC_HUGEPAGE);
+    if ((uintptr_t)mat2d_get_data(padded) % 64 != 0
+        || (uintptr_t)mat2d_get_data(huge) % (2 * 1024 * 1024) != 0
+        || mat2d_get_ld(padded) <= 512
+        || mat2d_get_ld(padded) % 8 != 0
+        || mat2d_get_size(padded) < sizeof(double) * 33 * mat2d_get_ld(padded)) {
+        rc = -1;
+    }
+
+    // Padding never reaches the file, in either direction
+    mat2d_fill_random(padded);
+    struct mat2d *dense = NULL, *repadded = NULL;
+    if (mat2d_write_to_binfile(padded, filename) != 0
+        || mat2d_read_from_binfile(&dense, filename) != 0
+        || !mat2d_is_contiguous(dense)
+        || !mat2d_eq(dense, padded)
+        || mat2d_read_from_binfile_ex(&repadded, filename, MAT2D_ALLOC_PADDED) != 0
+        || !mat2d_eq(repadded, padded)) {
+        rc = -1;
+    }
+    remove(filename);
+
+    printf("test_padded_alloc: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(padded);
+    mat2d_destroy(huge);
+    mat2d_destroy(dense);
+    mat2d_destroy(repadded);
+    return rc;
+}
+
+int test_arena() {
+    struct mat2d_arena *arena = mat2d_arena_create(0);
+    int rc = 0;
+
+    // After the first scope the arena is folded into one block, so later
+    // scopes with the same shape get the very same addresses back
+    double *first = NULL;
+    for (size_t iter = 0; iter < 3; iter++) {
+        mat2d_arena_begin(arena);
+        struct mat2d *a = mat2d_create_in(arena, 300, 300, MAT2D_ALLOC_PADDED);
+        mat2d_arena_begin(arena);
+        struct mat2d *b = mat2d_create_in(arena, 700, 700, MAT2D_ALLOC_DENSE);
+        mat2d_fill_one(b);
+        mat2d_arena_end(arena);
+        struct mat2d *c = mat2d_create_in(arena, 10, 10, MAT2D_ALLOC_DENSE);
+        mat2d_fill_eye(a);
+        mat2d_fill_eye(c);
+        if ((uintptr_t)mat2d_get_data(a) % 64 != 0 || mat2d_get(a, 299, 299) != 1.0) {
+            rc = -1;
+        }
+        if (iter == 1) {
+            first = mat2d_get_data(c);
+        } else if (iter == 2 && first != mat2d_get_data(c)) {
+            rc = -1;
+        }
+        mat2d_destroy(a);
+        mat2d_arena_end(arena);
+    }
+
+    printf("test_arena: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_arena_destroy(arena);
+    return rc;
+}
+
+int test_into() {
+    size_t n = 150;
+    int rc = 0;
+
+    struct mat2d *a = mat2d_create(n, n);
+    struct mat2d *b = mat2d_create(n, n);
+    mat2d_fill_random(a);
+    mat2d_fill_random(b);
+
+    // c = 2 * a * b - c, then the same product accumulated into a itself
+    struct mat2d *ab = NULL;
+    mat2d_dot(&ab, a, b);
+    struct mat2d *c = mat2d_create(n, n);
+    mat2d_fill_one(c);
+    mat2d_dot_into(c, a, b, 2.0, -1.0);
+    if (fabs(mat2d_get(c, 3, 4) - (2.0 * mat2d_get(ab, 3, 4) - 1.0)) > 1e-9) {
+        rc = -1;
+    }
+    struct mat2d *a_copy = NULL;
+    mat2d_clone(&a_copy, a);
+    mat2d_dot_into(a_copy, a_copy, b, 1.0, 0.0);
+    if (!mat2d_eq(a_copy, ab)) {
+        rc = -1;
+    }
+
+    // In-place Gauss-Jordan against the LU-based inverse
+    struct mat2d *inv = NULL;
+    mat2d_inv(&inv, a);
+    struct mat2d *inplace = NULL;
+    mat2d_clone(&inplace, a);
+    if (mat2d_inv_into(inplace, inplace) != 0 || !mat2d_eq(inplace, inv)) {
+        rc = -1;
+    }
+    struct mat2d *inv_out = mat2d_create(n, n);
+    if (mat2d_inv_into(inv_out, a) != 0 || !mat2d_eq(inv_out, inv)) {
+        rc = -1;
+    }
+
+    // Transposes: rectangular out of place, square in place
+    struct mat2d *rect = mat2d_create(3, 5);
+    mat2d_fill_random(rect);
+    struct mat2d *rect_t = NULL;
+    mat2d_T(&rect_t, rect);
+    if (mat2d_get_rows(rect_t) != 5 || mat2d_get(rect_t, 4, 2) != mat2d_get(rect, 2, 4)) {
+        rc = -1;
+    }
+    struct mat2d *sq = NULL;
+    mat2d_clone(&sq, a);
+    mat2d_T_into(sq, sq);
+    if (mat2d_get(sq, 7, 11) != mat2d_get(a, 11, 7)) {
+        rc = -1;
+    }
+    // Rectangular blocks sharing their storage cannot swap in place
+    struct mat2d *wide = mat2d_view(sq, 0, 0, 3, 5);
+    struct mat2d *tall = mat2d_view(sq, 0, 0, 5, 3);
+    if (mat2d_T_into(tall, wide) != -1) {
+        rc = -1;
+    }
+    mat2d_destroy(wide);
+    mat2d_destroy(tall);
+
+    printf("test_into: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(a);
+    mat2d_destroy(b);
+    mat2d_destroy(ab);
+    mat2d_destroy(c);
+    mat2d_destroy(a_copy);
+    mat2d_destroy(inv);
+    mat2d_destroy(inplace);
+    mat2d_destroy(inv_out);
+    mat2d_destroy(rect);
+    mat2d_destroy(rect_t);
+    mat2d_destroy(sq);
+    return rc;
+}
+
+int test_transpose() {
+    const size_t shapes[][2] = {{1, 1}, {3, 7}, {37, 70}, {129, 67}, {300, 41}};
+    int rc = 0;
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t rows = shapes[s][0], cols = shapes[s][1];
+        struct mat2d *mat = mat2d_create_ex(rows, cols, 0, MAT2D_ALLOC_PADDED);
+        mat2d_fill_random(mat);
+
+        // Out of place, and column-major export through a transposed view
+        struct mat2d *mat_t = NULL;
+        mat2d_T(&mat_t, mat);
+        struct mat2d *colmajor = mat2d_create(cols, rows);
+        struct mat2d *colmajor_t = mat2d_view_T(colmajor);
+        mat2d_copy(colmajor_t, mat);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                if (mat2d_get(mat_t, j, i) != mat2d_get(mat, i, j)
+                    || mat2d_get(colmajor, j, i) != mat2d_get(mat, i, j)) {
+                    rc = -1;
+                }
+            }
+        }
+
+        // In place on the leading square block
+        size_t n = rows < cols ? rows : cols;
+        struct mat2d *square = mat2d_view(mat, 0, 0, n, n);
+        mat2d_T_into(square, square);
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                if (mat2d_get(square, i, j) != mat2d_get(mat_t, i, j)) {
+                    rc = -1;
+                }
+            }
+        }
+
+        mat2d_destroy(square);
+        mat2d_destroy(colmajor_t);
+        mat2d_destroy(colmajor);
+        mat2d_destroy(mat_t);
+        mat2d_destroy(mat);
+    }
+
+    // A * B^T packs B through the transpose kernel
+    struct mat2d *a = mat2d_create(70, 90);
+    struct mat2d *b = mat2d_create(53, 90);
+    mat2d_fill_random(a);
+    mat2d_fill_random(b);
+    struct mat2d *b_t = mat2d_view_T(b);
+    struct mat2d *prod = NULL;
+    mat2d_dot(&prod, a, b_t);
+    struct mat2d *expected = naive_dot(a, b_t);
+    if (!mat2d_eq(prod, expected)) {
+        rc = -1;
+    }
+
+    printf("test_transpose: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(a);
+    mat2d_destroy(b);
+    mat2d_destroy(b_t);
+    mat2d_destroy(prod);
+    mat2d_destroy(expected);
+    return rc;
+}
+
+int test_mixed_precision() {
+    size_t n = 300, nrhs = 4;
+    int rc = 0;
+
+    // Diagonally dominant, so refinement converges in a few steps
+    struct mat2d *a = mat2d_create(n, n);
+    mat2d_fill_random(a);
+    for (size_t i = 0; i < n; i++) {
+        mat2d_set(a, i, i, mat2d_get(a, i, i) + n);
+    }
+    struct mat2d *b = mat2d_create(n, nrhs);
+    mat2d_fill_random(b);
+
+    struct mat2d_lu *lu = NULL;
+    struct mat2d *x = NULL, *x_mixed = NULL;
+    mat2d_lu_factor(&lu, a);
+    mat2d_lu_solve(&x, lu, b);
+    if (mat2d_solve_mixed(&x_mixed, a, b) != 0) {
+        rc = -1;
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < nrhs; j++) {
+                if (fabs(mat2d_get(x_mixed, i, j) - mat2d_get(x, i, j)) > 1e-14) {
+                    rc = -1;
+                }
+            }
+        }
+    }
+
+    struct mat2d *inv = NULL, *inv_mixed = NULL;
+    mat2d_inv(&inv, a);
+    if (mat2d_inv_mixed(&inv_mixed, a) != 0 || !mat2d_eq(inv, inv_mixed)) {
+        rc = -1;
+    }
+
+    // Entries beyond float range take the double fallback
+    struct mat2d *big = NULL;
+    mat2d_clone(&big, a);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            mat2d_set(big, i, j, 1e200 * mat2d_get(a, i, j));
+        }
+    }
+    struct mat2d *x_big = NULL;
+    if (mat2d_solve_mixed(&x_big, big, b) != 0
+        || fabs(1e200 * mat2d_get(x_big, 5, 1) - mat2d_get(x, 5, 1)) > 1e-12) {
+        rc = -1;
+    }
+
+    // Float GEMM against the double product
+    struct mat2f *af = mat2f_create(n, n);
+    struct mat2f *bf = mat2f_create(n, nrhs);
+    mat2f_from_mat2d(af, a);
+    mat2f_from_mat2d(bf, b);
+    struct mat2f *cf = NULL;
+    mat2f_dot(&cf, af, bf);
+    struct mat2d *c = NULL;
+    mat2d_dot(&c, a, b);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < nrhs; j++) {
+            double expected = mat2d_get(c, i, j);
+            if (fabs(mat2f_get(cf, i, j) - expected) > 1e-5 * fabs(expected) + 1e-3) {
+                rc = -1;
+            }
+        }
+    }
+
+    printf("test_mixed_precision: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_lu_destroy(lu);
+    mat2d_destroy(a);
+    mat2d_destroy(b);
+    mat2d_destroy(x);
+    mat2d_destroy(x_mixed);
+    mat2d_destroy(inv);
+    mat2d_destroy(inv_mixed);
+    mat2d_destroy(big);
+    mat2d_destroy(x_big);
+    mat2d_destroy(c);
+    mat2f_destroy(af);
+    mat2f_destroy(bf);
+    mat2f_destroy(cf);
+    return rc;
+}
+
+int test_batch() {
+    size_t count = 37, n = 5;
+    int rc = 0;
+
+    struct mat2d_batch *in = mat2d_batch_create(count, n, n);
+    struct mat2d_batch *out = mat2d_batch_create(count, n, n);
+    struct mat2d *item = mat2d_create(n, n);
+    for (size_t b = 0; b < count; b++) {
+        mat2d_fill_random(item);
+        memcpy(mat2d_batch_get_item(in, b), mat2d_get_data(item), sizeof(double) * n * n);
+    }
+
+    // Every inverse must match the single-matrix path
+    if (mat2d_batch_inv(out, in) != 0) {
+        rc = -1;
+    }
+    for (size_t b = 0; b < count; b++) {
+        memcpy(mat2d_get_data(item), mat2d_batch_get_item(in, b), sizeof(double) * n * n);
+        struct mat2d *inv = NULL;
+        mat2d_inv(&inv, item);
+        const double *batch_inv = mat2d_batch_get_item(out, b);
+        for (size_t e = 0; e < n * n; e++) {
+            if (fabs(batch_inv[e] - mat2d_get_data(inv)[e]) > 1e-9) {
+                rc = -1;
+            }
+        }
+        mat2d_destroy(inv);
+    }
+
+    // Products: (A^-1)^-1 * A^-1 = I, computed in place
+    mat2d_batch_inv(in, out);
+    mat2d_batch_dot(in, in, out);
+    for (size_t b = 0; b < count; b++) {
+        const double *eye = mat2d_batch_get_item(in, b);
+        for (size_t e = 0; e < n * n; e++) {
+            if (fabs(eye[e] - (e % (n + 1) == 0 ? 1.0 : 0.0)) > 1e-9) {
+                rc = -1;
+            }
+        }
+    }
+
+    // A singular item is reported
+    memset(mat2d_batch_get_item(in, 17), 0, sizeof(double) * n * n);
+    if (mat2d_batch_inv(out, in) == 0) {
+        rc = -1;
+    }
+
+    printf("test_batch: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(item);
+    mat2d_batch_destroy(in);
+    mat2d_batch_destroy(out);
+    return rc;
+}
+
+int test_small_kernels() {
+    int rc = 0;
+
+    for (size_t n = 2; n <= 8; n++) {
+        struct mat2d *a = mat2d_create(n, n);
+        struct mat2d *b = mat2d_create(n, n);
+        mat2d_fill_random(a);
+        mat2d_fill_random(b);
+
+        struct mat2d *prod = NULL;
+        mat2d_dot(&prod, a, b);
+        struct mat2d *expected = naive_dot(a, b);
+        if (!mat2d_eq(prod, expected)) {
+            rc = -1;
+        }
+
+        // The closed-form inverse against the pivoted LU solve
+        struct mat2d *eye = mat2d_create(n, n);
+        mat2d_fill_eye(eye);
+        struct mat2d_lu *lu = NULL;
+        struct mat2d *inv_lu = NULL, *inv = NULL;
+        mat2d_lu_factor(&lu, a);
+        mat2d_lu_solve(&inv_lu, lu, eye);
+        if (mat2d_inv(&inv, a) != 0 || !mat2d_eq(inv, inv_lu)) {
+            rc = -1;
+        }
+
+        // In place through a transposed view: (A^T)^-1 = (A^-1)^T, so the
+        // storage ends up holding A^-1
+        struct mat2d *a_t = mat2d_view_T(a);
+        mat2d_inv_into(a_t, a_t);
+        if (!mat2d_eq(a, inv)) {
+            rc = -1;
+        }
+
+        mat2d_destroy(a_t);
+        mat2d_lu_destroy(lu);
+        mat2d_destroy(a);
+        mat2d_destroy(b);
+        mat2d_destroy(prod);
+        mat2d_destroy(expected);
+        mat2d_destroy(eye);
+        mat2d_destroy(inv_lu);
+        mat2d_destroy(inv);
+    }
+
+    // Rank-deficient 3x3 is still reported as singular
+    struct mat2d *singular = mat2d_create(3, 3);
+    mat2d_fill_one(singular);
+    struct mat2d *inv = NULL;
+    if (mat2d_inv(&inv, singular) == 0) {
+        rc = -1;
+        mat2d_destroy(inv);
+    }
+
+    printf("test_small_kernels: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(singular);
+    return rc;
+}
+
+int test_dispatched_kernels() {
+    int rc = 0;
+
+    // Lengths around every vector width, so all tails are exercised
+    for (size_t n = 1; n <= 19; n++) {
+        struct mat2d *a = mat2d_create(23, n);
+        struct mat2d *x = mat2d_create(n, 1);
+        mat2d_fill_random(a);
+        mat2d_fill_random(x);
+
+        struct mat2d *y = NULL;
+        mat2d_dot(&y, a, x);
+        struct mat2d *expected = naive_dot(a, x);
+        if (!mat2d_eq(y, expected)) {
+            rc = -1;
+        }
+
+        // A single element off by more than EPS, placed last
+        struct mat2d *copy = NULL;
+        mat2d_clone(&copy, a);
+        if (!mat2d_eq(copy, a)) {
+            rc = -1;
+        }
+        mat2d_set(copy, 22, n - 1, mat2d_get(copy, 22, n - 1) + 1e-3);
+        if (mat2d_eq(copy, a)) {
+            rc = -1;
+        }
+
+        mat2d_fill_value(copy, 2.5);
+        if (mat2d_get(copy, 0, 0) != 2.5 || mat2d_get(copy, 22, n - 1) != 2.5) {
+            rc = -1;
+        }
+
+        // Row operations of the inverter run over the same tail lengths
+        struct mat2d *sq = mat2d_create(n, n);
+        mat2d_fill_random(sq);
+        for (size_t i = 0; i < n; i++) {
+            mat2d_set(sq, i, i, mat2d_get(sq, i, i) + n);
+        }
+        struct mat2d *eye = mat2d_create(n, n);
+        mat2d_fill_eye(eye);
+        struct mat2d *inv = NULL;
+        struct mat2d *check = NULL;
+        if (mat2d_inv(&inv, sq) != 0) {
+            rc = -1;
+        } else {
+            mat2d_dot(&check, sq, inv);
+            if (!mat2d_eq(check, eye)) {
+                rc = -1;
+            }
+        }
+
+        mat2d_destroy(a);
+        mat2d_destroy(x);
+        mat2d_destroy(y);
+        mat2d_destroy(expected);
+        mat2d_destroy(copy);
+        mat2d_destroy(sq);
+        mat2d_destroy(eye);
+        mat2d_destroy(inv);
+        mat2d_destroy(check);
+    }
+
+    printf("test_dispatched_kernels: %s\n", rc == 0 ? "ok" : "FAILED");
+    return rc;
+}
+
+int test_random_fill() {
+    int rc = 0;
+
+    // Same seed and shape give the same values in every layout: dense,
+    // padded rows and a transposed view of column-major storage
+    struct mat2d *dense = mat2d_create(7, 13);
+    struct mat2d *padded = mat2d_create_ex(7, 13, 0, MAT2D_ALLOC_PADDED);
+    struct mat2d *parent = mat2d_create(13, 7);
+    struct mat2d *strided = mat2d_view_T(parent);
+    mat2d_fill_random_seeded(dense, 42);
+    mat2d_fill_random_seeded(padded, 42);
+    mat2d_fill_random_seeded(strided, 42);
+
+    double max_diff = -1.0;
+    if (!mat2d_eq_ex(dense, padded, 0.0, &max_diff) || max_diff != 0.0
+        || !mat2d_eq_ex(dense, strided, 0.0, NULL)) {
+        rc = -1;
+    }
+    for (size_t i = 0; i < 7; i++) {
+        for (size_t j = 0; j < 13; j++) {
+            double v = mat2d_get(dense, i, j);
+            if (v < 0.0 || v >= 1.0) {
+                rc = -1;
+            }
+        }
+    }
+
+    // A row of the stream is the matching slice of a longer fill
+    struct mat2d *row = mat2d_create(1, 13);
+    struct mat2d *dense_row = mat2d_view_row(dense, 0);
+    mat2d_fill_random_seeded(row, 42);
+    if (!mat2d_eq_ex(row, dense_row, 0.0, NULL)) {
+        rc = -1;
+    }
+
+    mat2d_fill_random_seeded(padded, 43);
+    if (mat2d_eq(dense, padded)) {
+        rc = -1;
+    }
+
+    // Large enough to be split into chunks; the planted difference is
+    // reported exactly, with or without early exit
+    struct mat2d *big = mat2d_create(300, 301);
+    struct mat2d *other = NULL;
+    mat2d_fill_random_seeded(big, 7);
+    mat2d_clone(&other, big);
+    mat2d_set(other, 299, 300, mat2d_get(other, 299, 300) + 0.25);
+    if (mat2d_eq(big, other)
+        || mat2d_eq_ex(big, other, 0.25 + 1e-9, &max_diff) != true
+        || fabs(max_diff - 0.25) > 1e-12) {
+        rc = -1;
+    }
+
+    printf("test_random_fill: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(dense);
+    mat2d_destroy(padded);
+    mat2d_destroy(strided);
+    mat2d_destroy(parent);
+    mat2d_destroy(row);
+    mat2d_destroy(dense_row);
+    mat2d_destroy(big);
+    mat2d_destroy(other);
+    return rc;
+}
+
+int test_binfile_mapped() {
+    const char *filename = "test_binfile_mapped.bin";
+    int rc = 0;
+
+    struct mat2d *padded = mat2d_create_ex(37, 21, 0, MAT2D_ALLOC_PADDED);
+    mat2d_fill_random(padded);
+
+    // Padded rows keep their pitch on disk and map back without a copy
+    struct mat2d *mapped = NULL, *copy = NULL;
+    if (mat2d_write_to_binfile(padded, filename) != 0
+        || mat2d_open_mapped(&mapped, filename, MAT2D_MAP_VERIFY) != 0
+        || (uintptr_t)mat2d_get_data(mapped) % 64 != 0
+        || mat2d_get_ld(mapped) != mat2d_get_ld(padded)
+        || !mat2d_eq(mapped, padded)
+        || mat2d_read_from_binfile(&copy, filename) != 0
+        || !mat2d_is_contiguous(copy)
+        || !mat2d_eq(copy, padded)) {
+        rc = -1;
+    }
+    mat2d_destroy(mapped);
+    mat2d_destroy(copy);
+    mapped = copy = NULL;
+
+    // Copy-on-write pages are private: the file keeps the old value
+    double first = mat2d_get(padded, 0, 0);
+    if (mat2d_open_mapped(&mapped, filename, MAT2D_MAP_COW) != 0) {
+        rc = -1;
+    } else {
+        mat2d_set(mapped, 0, 0, first + 1.0);
+        if (mat2d_read_from_binfile(&copy, filename) != 0
+            || mat2d_get(copy, 0, 0) != first) {
+            rc = -1;
+        }
+    }
+    mat2d_destroy(mapped);
+    mat2d_destroy(copy);
+    mapped = copy = NULL;
+
+    // A flipped payload byte fails the checksum, unless nobody asks
+    FILE *file = fopen(filename, "r+b");
+    fseek(file, 64 + 100, SEEK_SET);
+    int byte = fgetc(file);
+    fseek(file, 64 + 100, SEEK_SET);
+    fputc(byte ^ 0x40, file);
+    fclose(file);
+    if (mat2d_read_from_binfile(&copy, filename) != -1
+        || mat2d_open_mapped(&mapped, filename, MAT2D_MAP_VERIFY) != -1
+        || mat2d_open_mapped(&mapped, filename, MAT2D_MAP_RDONLY) != 0) {
+        rc = -1;
+    }
+    mat2d_destroy(mapped);
+    mapped = NULL;
+
+    // Views are packed, and files from before the header still load
+    struct mat2d *view = mat2d_view_T(padded);
+    if (mat2d_write_to_binfile_ex(view, filename, 0) != 0
+        || mat2d_open_mapped(&mapped, filename, MAT2D_MAP_VERIFY) != 0
+        || mat2d_get_ld(mapped) != 37
+        || !mat2d_eq(mapped, view)) {
+        rc = -1;
+    }
+    mat2d_destroy(mapped);
+
+    size_t shape[2] = { 2, 3 };
+    double values[6] = { 1, 2, 3, 4, 5, 6 };
+    file = fopen(filename, "wb");
+    fwrite(shape, sizeof(size_t), 2, file);
+    fwrite(values, sizeof(double), 6, file);
+    fclose(file);
+    if (mat2d_read_from_binfile(&copy, filename) != 0
+        || mat2d_get_rows(copy) != 2 || mat2d_get(copy, 1, 2) != 6.0
+        || mat2d_open_mapped(&mapped, filename, MAT2D_MAP_RDONLY) != -1) {
+        rc = -1;
+    }
+    remove(filename);
+
+    printf("test_binfile_mapped: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(padded);
+    mat2d_destroy(view);
+    mat2d_destroy(copy);
+    return rc;
+}
+
+int test_csv_read() {
+    const char *filename = "test_csv_read.csv";
+    int rc = 0;
+
+    // Commas or blanks, CRLF, exponents and trailing blank lines
+    FILE *file = fopen(filename, "w");
+    fprintf(file, "1,2.5,-3e2\r\n 4 , 5,6\n7 8\t9\n\n");
+    fclose(file);
+    struct mat2d *mat = NULL;
+    if (mat2d_read_from_file(&mat, filename) != 0
+        || mat2d_get_rows(mat) != 3 || mat2d_get_cols(mat) != 3
+        || mat2d_get(mat, 0, 2) != -300.0
+        || mat2d_get(mat, 1, 0) != 4.0
+        || mat2d_get(mat, 2, 2) != 9.0) {
+        rc = -1;
+    }
+    mat2d_destroy(mat);
+    mat = NULL;
+
+    // Ragged rows and junk fields are errors
+    const char *bad[] = { "1,2\n3\n", "1,2\n3,x\n", "1,,2\n", "1,2,\n" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        file = fopen(filename, "w");
+        fputs(bad[i], file);
+        fclose(file);
+        if (mat2d_read_from_file(&mat, filename) != -1) {
+            rc = -1;
+        }
+    }
+
+    // Long rows across several parse chunks, printed with every digit:
+    // the values must come back bit for bit
+    struct mat2d *expected = mat2d_create(700, 600);
+    mat2d_fill_random(expected);
+    mat2d_set(expected, 3, 4, -1.5e-300);
+    mat2d_set(expected, 5, 6, 6.02214076e23);
+    file = fopen(filename, "w");
+    for (size_t i = 0; i < 700; i++) {
+        for (size_t j = 0; j < 600; j++) {
+            fprintf(file, j + 1 < 600 ? "%.17g," : "%.17g\n", mat2d_get(expected, i, j));
+        }
+    }
+    fclose(file);
+    double max_diff = -1.0;
+    if (mat2d_read_from_file(&mat, filename) != 0
+        || mat2d_get_rows(mat) != 700 || mat2d_get_cols(mat) != 600
+        || !mat2d_eq_ex(mat, expected, 0.0, &max_diff) || max_diff != 0.0) {
+        rc = -1;
+    }
+    remove(filename);
+
+    printf("test_csv_read: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(mat);
+    mat2d_destroy(expected);
+    return rc;
+}
+
+int test_text_write() {
+    const char *filename = "test_text_write.csv";
+    int rc = 0;
+
+    struct mat2d *small = mat2d_create(2, 3);
+    mat2d_set(small, 0, 0, 1.0);
+    mat2d_set(small, 0, 1, 0.1);
+    mat2d_set(small, 0, 2, -2.5e-7);
+    mat2d_set(small, 1, 0, 1e16);
+    mat2d_set(small, 1, 1, 1.0 / 3.0);
+    mat2d_set(small, 1, 2, -0.0);
+    char text[128] = { 0 };
+    mat2d_write_to_text_file(small, filename);
+    FILE *file = fopen(filename, "r");
+    fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    if (strcmp(text, "1,0.1,-2.5e-07\n1e+16,0.3333333333333333,-0\n") != 0) {
+        rc = -1;
+    }
+
+    // Default output reads back bit for bit, views included
+    struct mat2d *mat = mat2d_create(500, 300);
+    mat2d_fill_random(mat);
+    mat2d_set(mat, 7, 7, 4.9e-324);
+    mat2d_set(mat, 8, 8, -1.7976931348623157e308);
+    struct mat2d *view = mat2d_view_T(mat);
+    struct mat2d *back = NULL;
+    double max_diff = -1.0;
+    if (mat2d_write_to_text_file(view, filename) != 0
+        || mat2d_read_from_file(&back, filename) != 0
+        || !mat2d_eq_ex(back, view, 0.0, &max_diff) || max_diff != 0.0) {
+        rc = -1;
+    }
+    mat2d_destroy(back);
+    back = NULL;
+
+    // Limited precision, blank separated
+    if (mat2d_write_to_text_file_ex(small, filename, 3, ' ') != 0
+        || mat2d_read_from_file(&back, filename) != 0
+        || mat2d_get(back, 1, 1) != 0.333
+        || mat2d_get(back, 0, 2) != -2.5e-7) {
+        rc = -1;
+    }
+    remove(filename);
+
+    printf("test_text_write: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_destroy(small);
+    mat2d_destroy(view);
+    mat2d_destroy(mat);
+    mat2d_destroy(back);
+    return rc;
+}
+
+static mat2d_tiled *tiled_from(const char *filename, struct mat2d *mat, size_t tile) {
+    mat2d_tiled *tiled = mat2d_tiled_create(
+        filename, mat2d_get_rows(mat), mat2d_get_cols(mat), tile
+    );
+    if (tiled != NULL && mat2d_tiled_write_block(tiled, 0, 0, mat) != 0) {
+        mat2d_tiled_close(tiled);
+        return NULL;
+    }
+    return tiled;
+}
+
+int test_tiled() {
+    const size_t n = 150;
+    const size_t tile = 32;
+    const size_t slab = sizeof(double) * 5 * tile * tile;
+    int rc = 0;
+
+    struct mat2d *a = mat2d_create(n, n);
+    mat2d_fill_random_seeded(a, 11);
+    struct mat2d *expected = NULL;
+    mat2d_inv(&expected, a);
+
+    // Two slabs run every stream synchronously; eight prefetch and
+    // solve several tile columns per pass
+    size_t budgets[] = { 2 * slab, 8 * slab };
+    for (size_t t = 0; t < sizeof(budgets) / sizeof(budgets[0]); t++) {
+        mat2d_tiled *in = tiled_from("test_tiled_a.bin", a, tile);
+        mat2d_tiled *out = mat2d_tiled_create("test_tiled_inv.bin", n, n, tile);
+        struct mat2d *inv = mat2d_create(n, n);
+        double max_diff = -1.0;
+        if (in == NULL || out == NULL
+            || mat2d_tiled_inv(out, in, budgets[t]) != 0
+            || mat2d_tiled_read_block(out, 0, 0, inv) != 0
+            || !mat2d_eq_ex(inv, expected, 1e-9, &max_diff)) {
+            rc = -1;
+        }
+        mat2d_tiled_close(in);
+        mat2d_tiled_close(out);
+        mat2d_destroy(inv);
+    }
+
+    // A single slab is below any driver's minimum
+    mat2d_tiled *in = mat2d_tiled_open("test_tiled_a.bin");
+    mat2d_tiled *out = mat2d_tiled_open("test_tiled_inv.bin");
+    if (in == NULL || out == NULL || mat2d_tiled_inv(out, in, slab) == 0) {
+        rc = -1;
+    }
+    mat2d_tiled_close(in);
+    mat2d_tiled_close(out);
+
+    // A payload in the other byte order is refused
+    FILE *file = fopen("test_tiled_a.bin", "r+b");
+    if (file != NULL) {
+        fseek(file, 12, SEEK_SET);
+        int c = fgetc(file);
+        fseek(file, 12, SEEK_SET);
+        fputc(c ^ 3, file);
+        fclose(file);
+    }
+    in = mat2d_tiled_open("test_tiled_a.bin");
+    if (file == NULL || in != NULL) {
+        rc = -1;
+    }
+    mat2d_tiled_close(in);
+
+    // Products with ragged edge tiles, and the export to a binfile
+    struct mat2d *left = mat2d_create(n, 70);
+    struct mat2d *right = mat2d_create(70, 90);
+    mat2d_fill_random_seeded(left, 12);
+    mat2d_fill_random_seeded(right, 13);
+    struct mat2d *prod = NULL;
+    mat2d_dot(&prod, left, right);
+    mat2d_tiled *tl = tiled_from("test_tiled_l.bin", left, tile);
+    mat2d_tiled *tr = tiled_from("test_tiled_r.bin", right, tile);
+    mat2d_tiled *tp = mat2d_tiled_create("test_tiled_p.bin", n, 90, tile);
+    struct mat2d *back = NULL;
+    if (tl == NULL || tr == NULL || tp == NULL
+        || mat2d_tiled_dot(tp, tl, tr, 3 * slab) != 0
+        || mat2d_tiled_write_to_binfile(tp, "test_tiled_p.mat") != 0
+        || mat2d_read_from_binfile(&back, "test_tiled_p.mat") != 0
+        || !mat2d_eq_ex(back, prod, 1e-12, NULL)) {
+        rc = -1;
+    }
+
+    // Blocks that straddle tiles
+    struct mat2d *block = mat2d_create(40, 50);
+    struct mat2d *src = mat2d_view(prod, 20, 30, 40, 50);
+    if (tp == NULL || mat2d_tiled_read_block(tp, 20, 30, block) != 0
+        || !mat2d_eq_ex(block, src, 1e-12, NULL)) {
+        rc = -1;
+    }
+
+    printf("test_tiled: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    mat2d_tiled_close(tl);
+    mat2d_tiled_close(tr);
+    mat2d_tiled_close(tp);
+    remove("test_tiled_a.bin");
+    remove("test_tiled_inv.bin");
+    remove("test_tiled_l.bin");
+    remove("test_tiled_r.bin");
+    remove("test_tiled_p.bin");
+    remove("test_tiled_p.mat");
+    mat2d_destroy(src);
+    mat2d_destroy(block);
+    mat2d_destroy(back);
+    mat2d_destroy(prod);
+    mat2d_destroy(left);
+    mat2d_destroy(right);
+    mat2d_destroy(expected);
+    mat2d_destroy(a);
+    return rc;
+}
+
+static long file_size(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+int test_tilefile() {
+    const char *filename = "test_tilefile.tlz";
+    size_t rows = 150, cols = 110;
+    int rc = 0;
+
+    // Smooth data compresses; noise is stored raw and still round-trips
+    struct mat2d *smooth = mat2d_create(rows, cols);
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            mat2d_set(smooth, i, j, 0.25 * i + 0.5 * j);
+        }
+    }
+    struct mat2d *noise = mat2d_create(rows, cols);
+    mat2d_fill_random_seeded(noise, 7);
+
+    struct mat2d *sources[] = { smooth, noise };
+    for (size_t s = 0; s < 2; s++) {
+        for (unsigned flags = 0; flags <= MAT2D_TILE_SHUFFLE; flags++) {
+            struct mat2d *back = NULL;
+            double max_diff = -1.0;
+            if (mat2d_write_to_tilefile(sources[s], filename, 64, 48, flags) != 0
+                || mat2d_read_from_tilefile(&back, filename) != 0
+                || !mat2d_eq_ex(back, sources[s], 0.0, &max_diff) || max_diff != 0.0) {
+                rc = -1;
+            }
+            mat2d_destroy(back);
+        }
+    }
+
+    // A transposed view as the source, and the size win on smooth data
+    struct mat2d *smooth_t = mat2d_view_T(smooth);
+    struct mat2d *expected_t = NULL;
+    struct mat2d *back_t = NULL;
+    mat2d_T(&expected_t, smooth);
+    if (mat2d_write_to_tilefile(smooth_t, filename, 32, 32, MAT2D_TILE_SHUFFLE) != 0
+        || mat2d_read_from_tilefile(&back_t, filename) != 0
+        || !mat2d_eq_ex(back_t, expected_t, 0.0, NULL)) {
+        rc = -1;
+    }
+    if (mat2d_write_to_tilefile(smooth, filename, 64, 48, MAT2D_TILE_SHUFFLE) != 0
+        || file_size(filename) >= (long)(sizeof(double) * rows * cols / 2)) {
+        rc = -1;
+    }
+
+    // A tile too large for the u32 size in its index entry
+    if (mat2d_write_to_tilefile(smooth, filename, 1 << 16, 1 << 13, 0) != -1) {
+        rc = -1;
+    }
+
+    // Partial reads: a row range and one interior tile
+    mat2d_tilefile *f = mat2d_tilefile_open(filename);
+    struct mat2d *band = mat2d_create(30, cols);
+    struct mat2d *tile = mat2d_create(64, 48);
+    struct mat2d *band_src = mat2d_view(smooth, 50, 0, 30, cols);
+    struct mat2d *tile_src = mat2d_view(smooth, 64, 48, 64, 48);
+    if (f == NULL || mat2d_tilefile_get_rows(f) != rows
+        || mat2d_tilefile_get_cols(f) != cols
+        || mat2d_tilefile_get_tile_rows(f) != 64
+        || mat2d_tilefile_get_tile_cols(f) != 48
+        || mat2d_tilefile_read_block(f, 50, 0, band) != 0
+        || !mat2d_eq_ex(band, band_src, 0.0, NULL)
+        || mat2d_tilefile_read_block(f, 64, 48, tile) != 0
+        || !mat2d_eq_ex(tile, tile_src, 0.0, NULL)
+        || mat2d_tilefile_read_block(f, 130, 0, band) != -1) {
+        rc = -1;
+    }
+    mat2d_tilefile_close(f);
+
+    // A flipped byte in the first tile fails it and only it
+    FILE *file = fopen(filename, "r+b");
+    if (file != NULL) {
+        fseek(file, 80, SEEK_SET);
+        int c = fgetc(file);
+        fseek(file, 80, SEEK_SET);
+        fputc(c ^ 0x5a, file);
+        fclose(file);
+    }
+    struct mat2d *corrupt = NULL;
+    f = mat2d_tilefile_open(filename);
+    if (mat2d_read_from_tilefile(&corrupt, filename) != -1
+        || f == NULL || mat2d_tilefile_read_block(f, 0, 0, tile) != -1
+        || mat2d_tilefile_read_block(f, 64, 48, tile) != 0
+        || !mat2d_eq_ex(tile, tile_src, 0.0, NULL)) {
+        rc = -1;
+    }
+    mat2d_tilefile_close(f);
+
+    printf("test_tilefile: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    remove(filename);
+    mat2d_destroy(corrupt);
+    mat2d_destroy(tile_src);
+    mat2d_destroy(band_src);
+    mat2d_destroy(tile);
+    mat2d_destroy(band);
+    mat2d_destroy(back_t);
+    mat2d_destroy(expected_t);
+    mat2d_destroy(smooth_t);
+    mat2d_destroy(noise);
+    mat2d_destroy(smooth);
+    return rc;
+}
+
+static int pipeline_double(struct mat2d **out, struct mat2d *in, void *arg) {
+    double *scale = arg;
+    struct mat2d *result = NULL;
+    if (mat2d_clone(&result, in) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < mat2d_get_rows(result); i++) {
+        for (size_t j = 0; j < mat2d_get_cols(result); j++) {
+            mat2d_set(result, i, j, *scale * mat2d_get(result, i, j));
+        }
+    }
+    *out = result;
+    return 0;
+}
+
+int test_pipeline() {
+    enum { COUNT = 6 };
+    char names[2 * COUNT][32];
+    const char *inputs[COUNT], *outputs[COUNT];
+    struct mat2d *mats[COUNT];
+    int rc = 0;
+
+    for (size_t i = 0; i < COUNT; i++) {
+        snprintf(names[i], sizeof(names[i]), "test_pipe_in%zu.bin", i);
+        snprintf(names[COUNT + i], sizeof(names[i]), "test_pipe_out%zu.bin", i);
+        inputs[i] = names[i];
+        outputs[i] = names[COUNT + i];
+        mats[i] = mat2d_create(20 + i, 20 + i);
+        mat2d_fill_random_seeded(mats[i], i);
+        mat2d_write_to_binfile(mats[i], inputs[i]);
+    }
+
+    // Inverses through a queue shorter than the batch
+    struct mat2d_pipeline_stats stats;
+    if (mat2d_pipeline_run(inputs, outputs, COUNT, NULL, NULL, 2, 0, &stats) != 0
+        || stats.read.jobs != COUNT || stats.compute.jobs != COUNT
+        || stats.write.jobs != COUNT || stats.read.bytes == 0) {
+        rc = -1;
+    }
+    for (size_t i = 0; i < COUNT && rc == 0; i++) {
+        struct mat2d *inv = NULL, *expected = NULL;
+        mat2d_inv(&expected, mats[i]);
+        if (mat2d_read_from_binfile(&inv, outputs[i]) != 0
+            || !mat2d_eq_ex(inv, expected, 1e-9, NULL)) {
+            rc = -1;
+        }
+        mat2d_destroy(inv);
+        mat2d_destroy(expected);
+    }
+
+    // A custom stage, text output, and a missing input that fails alone
+    double scale = 2.0;
+    inputs[3] = "test_pipe_missing.bin";
+    if (mat2d_pipeline_run(
+            inputs, outputs, COUNT, pipeline_double, &scale,
+            1, MAT2D_PIPE_TEXT_OUT, &stats
+        ) != -1 || stats.write.jobs != COUNT - 1) {
+        rc = -1;
+    }
+    struct mat2d *doubled = NULL;
+    if (mat2d_read_from_file(&doubled, outputs[0]) != 0
+        || mat2d_get(doubled, 5, 7) != 2.0 * mat2d_get(mats[0], 5, 7)) {
+        rc = -1;
+    }
+    mat2d_destroy(doubled);
+
+    printf("test_pipeline: %s\n", rc == 0 ? "ok" : "FAILED");
+
+    for (size_t i = 0; i < COUNT; i++) {
+        remove(names[i]);
+        remove(names[COUNT + i]);
+        mat2d_destroy(mats[i]);
+    }
+    return rc;
+}
+
+static bool is_root() {
+    return mat2d_app_get_rank() == mat2d_app_get_root_indx();
+}
+
+#ifdef USE_MPI
+// The tests from here on are collective over MPI_COMM_WORLD: every rank
+// runs them, the root alone touches whole matrices and reports
+
+// Whole matrix written to filename on the root matches expected
+static bool root_file_eq(const char *filename, struct mat2d *expected) {
+    if (!is_root()) {
+        return true;
+    }
+    struct mat2d *mat = NULL;
+    bool eq = mat2d_read_from_binfile(&mat, filename) == 0
+        && mat2d_get_rows(mat) == mat2d_get_rows(expected)
+        && mat2d_get_cols(mat) == mat2d_get_cols(expected)
+        && mat2d_eq_ex(mat, expected, 0.0, NULL);
+    mat2d_destroy(mat);
+    return eq;
+}
+
+int test_cyclic_io() {
+    const char *in_name = "test_cyclic_io_in.bin";
+    const char *out_name = "test_cyclic_io_out.bin";
+    size_t size = mat2d_app_get_size();
+    // One row, fewer rows than ranks, and a tail of a partial round
+    size_t sizes[] = { 1, size + 1, 3 * size + 2 };
+    int rc = 0;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int legacy = 0; legacy < 2; legacy++) {
+            size_t n = sizes[s];
+            struct mat2d *mat = NULL, *eye = NULL;
+            if (is_root()) {
+                // Versioned files keep the padded pitch of the matrix
+                mat = mat2d_create_ex(n, n, 0, legacy ? 0 : MAT2D_ALLOC_PADDED);
+                eye = mat2d_create(n, n);
+                mat2d_fill_random_seeded(mat, 17 + n);
+                mat2d_fill_eye(eye);
+                if (legacy) {
+                    size_t shape[2] = { n, n };
+                    FILE *file = fopen(in_name, "wb");
+                    fwrite(shape, sizeof(size_t), 2, file);
+                    fwrite(mat2d_get_data(mat), sizeof(double), n * n, file);
+                    fclose(file);
+                } else {
+                    mat2d_write_to_binfile(mat, in_name);
+                }
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+
+            // The identity shard goes out first, then the input itself
+            struct mat2d_inv_task *task = mat2d_app_create_task();
+            if (mad2d_app_read_matrix(task, in_name) != 0
+                || mad2d_app_write_matrix(task, out_name) != 0
+                || !root_file_eq(out_name, eye)) {
+                rc = -1;
+            } else {
+                struct mat2d *shard = NULL;
+                mat2d_clone(&shard, mat2d_app_get_forward_matrix(task));
+                mat2d_destroy(mat2d_app_get_reverse_matrix(task));
+                mat2d_app_set_reverse_matrix(task, shard);
+                if (mad2d_app_write_matrix(task, out_name) != 0
+                    || !root_file_eq(out_name, mat)) {
+                    rc = -1;
+                }
+            }
+            mat2d_app_destroy_task(task);
+            mat2d_destroy(mat);
+            mat2d_destroy(eye);
+        }
+    }
+
+    // A missing file fails on every rank
+    struct mat2d_inv_task *task = mat2d_app_create_task();
+    if (mad2d_app_read_matrix(task, "test_cyclic_io_missing.bin") != -1) {
+        rc = -1;
+    }
+    mat2d_app_destroy_task(task);
+
+    MPI_Allreduce(MPI_IN_PLACE, &rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (is_root()) {
+        printf("test_cyclic_io: %s\n", rc == 0 ? "ok" : "FAILED");
+        remove(in_name);
+        remove(out_name);
+    }
+    return rc;
+}
+
+int test_cyclic_shards() {
+    size_t size = mat2d_app_get_size();
+    // Fewer rows than ranks, one round and a row, and many rounds; with
+    // one rank the short case has no rows and must fail everywhere
+    size_t sizes[] = { 1, size - 1, size + 1, 300 };
+    int rc = 0;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        // Every rank rebuilds the input to check its own shard
+        struct mat2d *mat = mat2d_create(n > 0 ? n : 1, n + 3);
+        mat2d_fill_random_seeded(mat, 31 + n);
+        struct mat2d_inv_task *task = mat2d_app_create_task();
+        struct mat2d *expected = NULL;
+        if (is_root() && n > 0) {
+            struct mat2d *forward = NULL, *reverse = mat2d_create(n, n + 3);
+            mat2d_clone(&forward, mat);
+            mat2d_fill_random_seeded(reverse, 57 + n);
+            mat2d_clone(&expected, reverse);
+            mat2d_app_set_forward_matrix(task, forward);
+            mat2d_app_set_reverse_matrix(task, reverse);
+        }
+
+        if (mad2d_app_redistribute_matrix(task) != 0) {
+            if (n > 0) {
+                rc = -1;
+            }
+        } else if (n == 0) {
+            rc = -1;
+        } else {
+            struct mat2d *shard = mat2d_app_get_forward_matrix(task);
+            size_t rank = mat2d_app_get_rank();
+            for (size_t i = 0; i < mat2d_get_rows(shard); i++) {
+                size_t row = rank + i * size;
+                for (size_t j = 0; j < n + 3; j++) {
+                    double want = row < n ? mat2d_get(mat, row, j) : 0.0;
+                    if (mat2d_get(shard, i, j) != want) {
+                        rc = -1;
+                    }
+                }
+            }
+            if (mad2d_app_unite_matrix(task) != 0
+                || (is_root() && !mat2d_eq_ex(
+                    mat2d_app_get_reverse_matrix(task), expected, 0.0, NULL))) {
+                rc = -1;
+            }
+        }
+        mat2d_app_destroy_task(task);
+        mat2d_destroy(expected);
+        mat2d_destroy(mat);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (is_root()) {
+        printf("test_cyclic_shards: %s\n", rc == 0 ? "ok" : "FAILED");
+    }
+    return rc;
+}
+
+// Inverse of the root's mat through a task: redistribute, invert the
+// shards with inv, unite. NULL on the other ranks and on failure.
+static struct mat2d *task_inv(struct mat2d *mat, int (*inv)(struct mat2d_inv_task *)) {
+    struct mat2d_inv_task *task = mat2d_app_create_task();
+    if (is_root()) {
+        struct mat2d *forward = NULL, *eye = mat2d_create(
+            mat2d_get_rows(mat), mat2d_get_cols(mat)
+        );
+        mat2d_clone(&forward, mat);
+        mat2d_fill_eye(eye);
+        mat2d_app_set_forward_matrix(task, forward);
+        mat2d_app_set_reverse_matrix(task, eye);
+    }
+    struct mat2d *result = NULL;
+    if (mad2d_app_redistribute_matrix(task) == 0
+        && inv(task) == 0
+        && mad2d_app_unite_matrix(task) == 0
+        && is_root()) {
+        result = mat2d_app_get_reverse_matrix(task);
+        mat2d_app_set_reverse_matrix(task, NULL);
+    }
+    mat2d_app_destroy_task(task);
+    return result;
+}
+
+int test_inv_pipelined() {
+    size_t size = mat2d_app_get_size();
+    // Neither inverter pivots, so the inputs are diagonally dominant.
+    // Sizes give ranks one row, one extra row, and many rows each.
+    size_t sizes[] = { 1, size + 1, 97 };
+    int rc = 0;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        struct mat2d *mat = NULL, *expected = NULL;
+        if (is_root()) {
+            mat = mat2d_create(n, n);
+            mat2d_fill_random_seeded(mat, 71 + n);
+            for (size_t i = 0; i < n; i++) {
+                mat2d_set(mat, i, i, mat2d_get(mat, i, i) + n);
+            }
+            mat2d_inv(&expected, mat);
+        }
+
+        struct mat2d *v1 = task_inv(mat, mat2d_inv_MPI_v1);
+        struct mat2d *v2 = task_inv(mat, mat2d_inv_MPI_v2);
+        if (is_root() && (v1 == NULL || v2 == NULL
+            || !mat2d_eq_ex(v1, expected, 1e-9, NULL)
+            || !mat2d_eq_ex(v2, expected, 1e-9, NULL)
+            || !mat2d_eq_ex(v2, v1, 1e-12, NULL))) {
+            rc = -1;
+        }
+        mat2d_destroy(v1);
+        mat2d_destroy(v2);
+        mat2d_destroy(expected);
+        mat2d_destroy(mat);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (is_root()) {
+        printf("test_inv_pipelined: %s\n", rc == 0 ? "ok" : "FAILED");
+    }
+    return rc;
+}
+
+int test_dist_inv() {
+    size_t size = mat2d_app_get_size();
+    // Squarest, 1 x P and P x 1 grids
+    size_t grids[][2] = { { 0, 0 }, { 1, size }, { size, 1 } };
+    size_t nbs[] = { 1, 3, 8 };
+    size_t n = 37;
+    int rc = 0;
+
+    // A zero diagonal forces row exchanges at every step
+    struct mat2d *mat = NULL, *eye = NULL;
+    if (is_root()) {
+        mat = mat2d_create(n, n);
+        eye = mat2d_create(n, n);
+        mat2d_fill_random_seeded(mat, 91);
+        for (size_t i = 0; i < n; i++) {
+            mat2d_set(mat, i, i, 0.0);
+        }
+        mat2d_fill_eye(eye);
+    }
+
+    for (size_t g = 0; g < sizeof(grids) / sizeof(grids[0]); g++) {
+        mat2d_grid *grid = mat2d_grid_create(grids[g][0], grids[g][1]);
+        if (grid == NULL) {
+            rc = -1;
+            continue;
+        }
+        for (size_t b = 0; b < sizeof(nbs) / sizeof(nbs[0]); b++) {
+            mat2d_dist *in = mat2d_dist_create(grid, n, n, nbs[b]);
+            mat2d_dist *out = mat2d_dist_create(grid, n, n, nbs[b]);
+            struct mat2d *inv = NULL, *prod = NULL;
+            if (in == NULL || out == NULL
+                || mat2d_dist_scatter(in, mat) != 0
+                || mat2d_dist_inv(out, in) != 0
+                || mat2d_dist_gather(&inv, out) != 0) {
+                rc = -1;
+            } else if (is_root()) {
+                mat2d_dot(&prod, mat, inv);
+                if (!mat2d_eq_ex(prod, eye, 1e-9, NULL)) {
+                    rc = -1;
+                }
+            }
+            mat2d_destroy(prod);
+            mat2d_destroy(inv);
+            mat2d_dist_destroy(out);
+            mat2d_dist_destroy(in);
+        }
+
+        // A singular matrix fails on every rank
+        struct mat2d *zero = NULL;
+        if (is_root()) {
+            zero = mat2d_create(n, n);
+            mat2d_fill_zero(zero);
+        }
+        mat2d_dist *in = mat2d_dist_create(grid, n, n, 4);
+        mat2d_dist *out = mat2d_dist_create(grid, n, n, 4);
+        if (in == NULL || out == NULL
+            || mat2d_dist_scatter(in, zero) != 0
+            || mat2d_dist_inv(out, in) != -1) {
+            rc = -1;
+        }
+        mat2d_dist_destroy(out);
+        mat2d_dist_destroy(in);
+        mat2d_destroy(zero);
+        mat2d_grid_destroy(grid);
+    }
+    mat2d_destroy(mat);
+    mat2d_destroy(eye);
+
+    MPI_Allreduce(MPI_IN_PLACE, &rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (is_root()) {
+        printf("test_dist_inv: %s\n", rc == 0 ? "ok" : "FAILED");
+    }
+    return rc;
+}
+
+int test_dist_dot() {
+    size_t size = mat2d_app_get_size();
+    // m x k x n: none square or a multiple of nb, then k below nb
+    size_t shapes[][3] = { { 130, 129, 65 }, { 50, 5, 41 }, { 1, 70, 3 } };
+    size_t grids[][2] = { { 0, 0 }, { 1, size }, { size, 1 } };
+    size_t nbs[] = { 8, 64 };
+    int rc = 0;
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t m = shapes[s][0], k = shapes[s][1], n = shapes[s][2];
+        struct mat2d *left = NULL, *right = NULL, *expected = NULL;
+        if (is_root()) {
+            left = mat2d_create(m, k);
+            right = mat2d_create(k, n);
+            mat2d_fill_random_seeded(left, 101 + s);
+            mat2d_fill_random_seeded(right, 201 + s);
+            mat2d_dot(&expected, left, right);
+        }
+
+        for (size_t g = 0; g < sizeof(grids) / sizeof(grids[0]); g++) {
+            mat2d_grid *grid = mat2d_grid_create(grids[g][0], grids[g][1]);
+            for (size_t b = 0; b < sizeof(nbs) / sizeof(nbs[0]) && grid != NULL; b++) {
+                mat2d_dist *a = mat2d_dist_create(grid, m, k, nbs[b]);
+                mat2d_dist *bm = mat2d_dist_create(grid, k, n, nbs[b]);
+                mat2d_dist *c = mat2d_dist_create(grid, m, n, nbs[b]);
+                struct mat2d *result = NULL;
+                if (a == NULL || bm == NULL || c == NULL
+                    || mat2d_dist_scatter(a, left) != 0
+                    || mat2d_dist_scatter(bm, right) != 0
+                    || mat2d_dist_dot(c, a, bm) != 0
+                    || mat2d_dist_gather(&result, c) != 0
+                    || (is_root() && !mat2d_eq_ex(result, expected, 1e-10, NULL))) {
+                    rc = -1;
+                }
+                // Swapped operands no longer multiply
+                if (m != n && c != NULL && mat2d_dist_dot(c, bm, a) != -1) {
+                    rc = -1;
+                }
+                mat2d_destroy(result);
+                mat2d_dist_destroy(c);
+                mat2d_dist_destroy(bm);
+                mat2d_dist_destroy(a);
+            }
+            if (grid == NULL) {
+                rc = -1;
+            }
+            mat2d_grid_destroy(grid);
+        }
+
+        // The task path, on the default block size
+        struct mat2d *result = NULL;
+        if (mat2d_dot_mpi(&result, left, right) != 0
+            || (is_root() && !mat2d_eq_ex(result, expected, 1e-10, NULL))) {
+            rc = -1;
+        }
+        mat2d_destroy(result);
+        mat2d_destroy(expected);
+        mat2d_destroy(right);
+        mat2d_destroy(left);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (is_root()) {
+        printf("test_dist_dot: %s\n", rc == 0 ? "ok" : "FAILED");
+    }
+    return rc;
+}
+
+#endif
+
 int main(int argc, char **argv)
 {
-    test_rev();
-    test_dot();
-    return 0;
+    if (mat2d_app_init(argc, argv) != 0) {
+        mat2d_app_destroy();
+        return 1;
+    }
+
+    int rc = 0;
+    if (is_root()) {
+        rc |= test_rev();
+        rc |= test_dot();
+        rc |= test_dot_blocked();
+        rc |= test_lu_solve();
+        rc |= test_inv_pivoting();
+        rc |= test_views();
+        rc |= test_padded_alloc();
+        rc |= test_arena();
+        rc |= test_into();
+        rc |= test_transpose();
+        rc |= test_mixed_precision();
+        rc |= test_batch();
+        rc |= test_small_kernels();
+        rc |= test_dispatched_kernels();
+        rc |= test_random_fill();
+        rc |= test_binfile_mapped();
+        rc |= test_csv_read();
+        rc |= test_text_write();
+        rc |= test_tiled();
+        rc |= test_tilefile();
+        rc |= test_pipeline();
+    }
+#ifdef USE_MPI
+    rc |= test_cyclic_io();
+    rc |= test_cyclic_shards();
+    rc |= test_inv_pipelined();
+    rc |= test_dist_inv();
+    rc |= test_dist_dot();
+#endif
+
+    mat2d_app_destroy();
+    return rc != 0 ? 1 : 0;
 }
\ No newline at end of file
@@ -1,11 +1,19 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <stddef.h>
+
 typedef struct mat2d_inv_task mat2d_inv_task;
+typedef struct mat2d_grid mat2d_grid;
+typedef struct mat2d_dist mat2d_dist;
+typedef struct mat2d_dot_task mat2d_dot_task;
 
 int init();
 void destroy();
 
+struct mat2d_inv_task* mat2d_app_create_task();
+void mat2d_app_destroy_task(struct mat2d_inv_task *task);
+
 struct mat2d* mat2d_app_get_forward_matrix(struct mat2d_inv_task *task);
 struct mat2d* mat2d_app_get_reverse_matrix(struct mat2d_inv_task *task);
 void mat2d_app_set_forward_matrix(
@@ -16,7 +24,77 @@ void mat2d_app_set_reverse_matrix(
     struct mat2d_inv_task *task, 
     struct mat2d* mat
 );
-int mad2d_app_redistribute_matrix();
-int mad2d_app_unite_matrix();
+// Collective over MPI_COMM_WORLD. redistribute scatters the root's
+// matrices into cyclic row shards on every rank; unite gathers the
+// shards of the inverse back into a whole matrix on the root.
+int mad2d_app_redistribute_matrix(struct mat2d_inv_task *task);
+int mad2d_app_unite_matrix(struct mat2d_inv_task *task);
+
+// Collective MPI-IO over a binary matrix file: each rank reads and
+// writes only its own cyclic rows, so no rank holds the whole matrix.
+// read replaces both matrices of the task with the input shard and the
+// identity shard; write stores the distributed inverse.
+int mad2d_app_read_matrix(struct mat2d_inv_task *task, const char *filename);
+int mad2d_app_write_matrix(struct mat2d_inv_task *task, const char *filename);
+
+int mat2d_inv_MPI_v1(struct mat2d_inv_task *task);
+// Same result as v1, with the broadcast of each pivot row overlapped
+// with the update of the step before
+int mat2d_inv_MPI_v2(struct mat2d_inv_task *task);
+
+// P x Q process grid over MPI_COMM_WORLD. A side of 0 is derived from
+// the rank count, both 0 give the squarest grid; P * Q must equal the
+// rank count. All grid and dist calls are collective over the grid and
+// fail on every rank or on none.
+mat2d_grid* mat2d_grid_create(size_t nprow, size_t npcol);
+void mat2d_grid_destroy(mat2d_grid *grid);
+size_t mat2d_grid_get_nprow(mat2d_grid *grid);
+size_t mat2d_grid_get_npcol(mat2d_grid *grid);
+size_t mat2d_grid_get_myrow(mat2d_grid *grid);
+size_t mat2d_grid_get_mycol(mat2d_grid *grid);
+
+// Matrices distributed over a grid in nb x nb blocks, 2D block-cyclic
+// as in ScaLAPACK. Each rank keeps its blocks in one local matrix,
+// zeroed at creation. scatter and gather move whole matrices to and
+// from the root, where full is significant.
+//
+// mat2d_dist_lu_factor overwrites mat with its LU factors and stores
+// the n row swaps in piv on every rank. Operands of lu_solve and inv
+// share the grid and the block size; inv leaves in untouched.
+mat2d_dist* mat2d_dist_create(mat2d_grid *grid, size_t rows, size_t cols, size_t nb);
+void mat2d_dist_destroy(mat2d_dist *dist);
+size_t mat2d_dist_get_rows(mat2d_dist *dist);
+size_t mat2d_dist_get_cols(mat2d_dist *dist);
+size_t mat2d_dist_get_nb(mat2d_dist *dist);
+struct mat2d* mat2d_dist_get_local(mat2d_dist *dist);
+int mat2d_dist_scatter(mat2d_dist *dist, struct mat2d *full);
+int mat2d_dist_gather(struct mat2d **out, mat2d_dist *dist);
+int mat2d_dist_lu_factor(mat2d_dist *mat, size_t *piv);
+int mat2d_dist_lu_solve(mat2d_dist *lu, const size_t *piv, mat2d_dist *rhs);
+int mat2d_dist_inv(mat2d_dist *out, mat2d_dist *in);
+
+// SUMMA product over the grid, with the panel broadcasts of one block
+// overlapping the local GEMM of the one before. Any shapes that
+// multiply; operands share the grid and nb, and out is neither of them.
+int mat2d_dist_dot(mat2d_dist *out, mat2d_dist *left, mat2d_dist *right);
+
+// Distributed product in the shape of the inverse task: distribute
+// sends the root's operands out over the squarest grid in nb x nb
+// blocks (0 picks a default), collect brings the product back to the
+// root. The task does not own the operands; it owns the result.
+// mat2d_dot_mpi runs all three steps and hands the result to out on
+// the root.
+struct mat2d_dot_task* mat2d_app_create_dot_task();
+void mat2d_app_destroy_dot_task(struct mat2d_dot_task *task);
+void mat2d_app_set_dot_operands(
+    struct mat2d_dot_task *task,
+    struct mat2d *left,
+    struct mat2d *right
+);
+struct mat2d* mat2d_app_get_dot_result(struct mat2d_dot_task *task);
+int mad2d_app_distribute_dot(struct mat2d_dot_task *task, size_t nb);
+int mat2d_dot_MPI_summa(struct mat2d_dot_task *task);
+int mad2d_app_collect_dot(struct mat2d_dot_task *task);
+int mat2d_dot_mpi(struct mat2d **out, struct mat2d *left, struct mat2d *right);
 
 #endif
\ No newline at end of file
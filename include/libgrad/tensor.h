@@ -8,36 +8,255 @@
 #define MPI_ENABLED
 
 typedef struct mat2d mat2d;
+typedef struct mat2d_lu mat2d_lu;
+typedef struct mat2d_arena mat2d_arena;
+typedef struct mat2f mat2f;
+typedef struct mat2d_batch mat2d_batch;
+typedef struct mat2d_tiled mat2d_tiled;
+typedef struct mat2d_tilefile mat2d_tilefile;
+
+// Storage is always 64-byte aligned. PADDED rounds the leading dimension
+// up to a cache line and away from cache-set aliasing strides; HUGEPAGE
+// aligns to 2 MiB and asks the kernel for transparent huge pages.
+enum mat2d_alloc_flags {
+    MAT2D_ALLOC_DENSE    = 0,
+    MAT2D_ALLOC_PADDED   = 1 << 0,
+    MAT2D_ALLOC_HUGEPAGE = 1 << 1
+};
 
 mat2d* mat2d_create(size_t n, size_t k);
+// ld == 0 picks the leading dimension from flags
+mat2d* mat2d_create_ex(size_t n, size_t k, size_t ld, unsigned flags);
+// Matrices created in an arena live until the enclosing
+// mat2d_arena_end; their contents start undefined and mat2d_destroy
+// on them is a no-op
+mat2d* mat2d_create_in(mat2d_arena *arena, size_t n, size_t k, unsigned flags);
 int mat2d_clone(mat2d **out, mat2d *in);
+int mat2d_copy(mat2d *dst, mat2d *src);
 void mat2d_destroy(mat2d *mat);
 
+// Views alias the parent's buffer without copying and must not outlive
+// it. Every mat2d_* routine accepts them; release with mat2d_destroy.
+mat2d* mat2d_view(mat2d *mat, size_t row, size_t col, size_t rows, size_t cols);
+mat2d* mat2d_view_row(mat2d *mat, size_t row);
+mat2d* mat2d_view_col(mat2d *mat, size_t col);
+mat2d* mat2d_view_rows_step(mat2d *mat, size_t first_row, size_t step);
+mat2d* mat2d_view_T(mat2d *mat);
+bool mat2d_is_contiguous(mat2d *mat);
+
+// Scoped bump allocator for temporaries; capacity == 0 grows on demand
+mat2d_arena* mat2d_arena_create(size_t capacity);
+void mat2d_arena_destroy(mat2d_arena *arena);
+void mat2d_arena_begin(mat2d_arena *arena);
+void mat2d_arena_end(mat2d_arena *arena);
+void* mat2d_arena_alloc(mat2d_arena *arena, size_t bytes);
+
 double mat2d_get(mat2d *mat, size_t indx1, size_t indx2);
 size_t mat2d_get_rows(mat2d *mat);
 size_t mat2d_get_cols(mat2d *mat);
 size_t mat2d_get_size(mat2d *mat);
+size_t mat2d_get_ld(mat2d *mat);
 double* mat2d_get_data(mat2d *mat);
 double* mat2d_get_row_ref(mat2d *mat, size_t row);
 double* mat2d_get_row_cloned(mat2d *mat, size_t row);
 void mat2d_set(mat2d *mat, size_t indx1, size_t indx2, double value);
 
 bool mat2d_eq(struct mat2d* left, struct mat2d* right);
+bool mat2d_eq_ex(struct mat2d *left, struct mat2d *right, double eps, double *max_diff);
+
+bool mat2d_overlaps(mat2d *a, mat2d *b);
 
 int mat2d_inv(struct mat2d** out, struct mat2d* in);
+int mat2d_lu_factor(struct mat2d_lu **out, struct mat2d *in);
+int mat2d_lu_solve(struct mat2d **out, struct mat2d_lu *lu, struct mat2d *rhs);
+void mat2d_lu_destroy(struct mat2d_lu *lu);
 int mat2d_T(struct mat2d** out, struct mat2d* in);
 int mat2d_dot(struct mat2d** out, struct mat2d* left, struct mat2d* right);
 
+// Allocation-free variants writing into caller-owned matrices. out may be
+// the input itself for mat2d_inv_into and, when square, mat2d_T_into;
+// mat2d_dot_into accepts an out aliasing either operand.
+int mat2d_inv_into(struct mat2d *out, struct mat2d *in);
+int mat2d_inv_inplace(struct mat2d *mat);
+int mat2d_T_into(struct mat2d *out, struct mat2d *in);
+int mat2d_dot_into(
+    struct mat2d *out,
+    struct mat2d *left, struct mat2d *right,
+    double alpha, double beta
+);
+
+// Single precision matrices share the allocation flags, arenas and GEMM
+// of mat2d. Conversions from double fail when a value overflows float.
+// They are local to one process: the MPI routines only send doubles.
+mat2f* mat2f_create(size_t n, size_t k);
+mat2f* mat2f_create_ex(size_t n, size_t k, size_t ld, unsigned flags);
+mat2f* mat2f_create_in(mat2d_arena *arena, size_t n, size_t k, unsigned flags);
+void mat2f_destroy(mat2f *mat);
+size_t mat2f_get_rows(mat2f *mat);
+size_t mat2f_get_cols(mat2f *mat);
+size_t mat2f_get_ld(mat2f *mat);
+float* mat2f_get_data(mat2f *mat);
+float mat2f_get(mat2f *mat, size_t indx1, size_t indx2);
+void mat2f_set(mat2f *mat, size_t indx1, size_t indx2, float value);
+int mat2f_from_mat2d(mat2f *dst, mat2d *src);
+int mat2d_from_mat2f(mat2d *dst, mat2f *src);
+int mat2f_dot(mat2f **out, mat2f *left, mat2f *right);
+int mat2f_dot_into(
+    mat2f *out,
+    mat2f *left, mat2f *right,
+    float alpha, float beta
+);
+
+// Mixed precision: factor A in float, then refine the solution with
+// double residuals until it reaches double accuracy. Falls back to a
+// double factorization when refinement stalls (ill-conditioned A).
+int mat2d_solve_mixed(struct mat2d **out, struct mat2d *a, struct mat2d *rhs);
+int mat2d_inv_mixed(struct mat2d **out, struct mat2d *in);
+
+// Batches of same-shaped small matrices stored back to back, each one
+// row-major. Operations run across the whole batch in one call,
+// vectorized over matrices and split between threads.
+mat2d_batch* mat2d_batch_create(size_t count, size_t n, size_t k);
+void mat2d_batch_destroy(mat2d_batch *batch);
+size_t mat2d_batch_get_count(mat2d_batch *batch);
+size_t mat2d_batch_get_rows(mat2d_batch *batch);
+size_t mat2d_batch_get_cols(mat2d_batch *batch);
+double* mat2d_batch_get_item(mat2d_batch *batch, size_t idx);
+int mat2d_batch_inv(mat2d_batch *out, mat2d_batch *in);
+int mat2d_batch_dot(mat2d_batch *out, mat2d_batch *left, mat2d_batch *right);
+
 void mat2d_fill_random(struct mat2d *mat);
+// Reproducible for a given seed and shape, whatever the thread count
+void mat2d_fill_random_seeded(struct mat2d *mat, uint64_t seed);
 void mat2d_fill_eye(struct mat2d *mat);
 void mat2d_fill_zero(struct mat2d *mat);
 void mat2d_fill_one(struct mat2d *mat);
 void mat2d_fill_value(struct mat2d *mat, double value);
 
+// Binary files carry a versioned 64-byte header (magic, element type,
+// shape, leading dimension) followed by the little-endian rows at a
+// 64-byte aligned offset. CHECKSUM stores a checksum of the payload,
+// verified on every copying read; mat2d_write_to_binfile sets it.
+enum mat2d_file_flags {
+    MAT2D_FILE_CHECKSUM = 1 << 0
+};
+
+// Mapped matrices alias the file's page cache: opening takes constant
+// time and rows are paged in on first touch. Mappings are read-only and
+// writes fault, unless COW, which makes written pages private copies;
+// the file itself is never modified. VERIFY checks the checksum up
+// front, at the cost of reading the whole file. Release with
+// mat2d_destroy.
+enum mat2d_map_flags {
+    MAT2D_MAP_RDONLY = 0,
+    MAT2D_MAP_COW    = 1 << 0,
+    MAT2D_MAP_VERIFY = 1 << 1
+};
+
 int mat2d_read_from_file(mat2d **out, const char *filename);
 int mat2d_read_from_binfile(mat2d **out, const char *filename);
+int mat2d_read_from_binfile_ex(mat2d **out, const char *filename, unsigned flags);
+int mat2d_open_mapped(mat2d **out, const char *filename, unsigned flags);
+// One row per line, fields separated by sep; ',' gives the CSV that
+// mat2d_read_from_file reads. Precision 0 writes the shortest text that
+// reads back as exactly the same double, 1..17 at most that many
+// significant digits. mat2d_write_to_text_file is round-trip CSV.
 int mat2d_write_to_text_file(const mat2d *mat, const char *filename);
+int mat2d_write_to_text_file_ex(
+    const mat2d *mat,
+    const char *filename,
+    int precision, char sep
+);
 int mat2d_write_to_binfile(const mat2d *mat, const char *filename);
+int mat2d_write_to_binfile_ex(const mat2d *mat, const char *filename, unsigned flags);
+
+// Out-of-core matrices live in a file of square tiles and are never
+// loaded whole. Blocks move between memory and the file with read_block
+// and write_block, which accept views and mapped matrices, so a binfile
+// opened with mat2d_open_mapped imports without being read into memory.
+// Operands of one operation share the tile size.
+//
+// The drivers hold at most budget bytes of matrix data, in slabs of
+// rows x tile, and fail if fewer than two fit. I/O runs on a background
+// thread that prefetches the next slab and writes finished ones behind.
+// mat2d_tiled_lu_factor overwrites mat with factors and pivots (n
+// entries) only mat2d_tiled_lu_solve understands; mat2d_tiled_inv
+// factors in in place. out of mat2d_tiled_dot must not be an operand.
+mat2d_tiled* mat2d_tiled_create(const char *filename, size_t rows, size_t cols, size_t tile);
+mat2d_tiled* mat2d_tiled_open(const char *filename);
+void mat2d_tiled_close(mat2d_tiled *mat);
+size_t mat2d_tiled_get_rows(mat2d_tiled *mat);
+size_t mat2d_tiled_get_cols(mat2d_tiled *mat);
+size_t mat2d_tiled_get_tile(mat2d_tiled *mat);
+int mat2d_tiled_read_block(mat2d_tiled *mat, size_t row, size_t col, mat2d *dst);
+int mat2d_tiled_write_block(mat2d_tiled *mat, size_t row, size_t col, mat2d *src);
+int mat2d_tiled_write_to_binfile(mat2d_tiled *mat, const char *filename);
+int mat2d_tiled_lu_factor(mat2d_tiled *mat, size_t *piv, size_t budget);
+int mat2d_tiled_lu_solve(mat2d_tiled *lu, const size_t *piv, mat2d_tiled *rhs, size_t budget);
+int mat2d_tiled_inv(mat2d_tiled *out, mat2d_tiled *in, size_t budget);
+int mat2d_tiled_dot(mat2d_tiled *out, mat2d_tiled *left, mat2d_tiled *right, size_t budget);
+
+// Compressed tile files split a matrix into tile_rows x tile_cols tiles,
+// each compressed on its own with a checksum, behind an index at the end
+// of the file. read_block decodes only the tiles a block overlaps, so a
+// rank or a slab fetches its part without touching the rest. SHUFFLE
+// groups the bytes of the doubles by significance before compressing,
+// which usually shrinks smooth data further. Tiles that do not compress
+// are stored as they are.
+enum mat2d_tile_flags {
+    MAT2D_TILE_SHUFFLE = 1 << 0
+};
+
+int mat2d_write_to_tilefile(
+    const mat2d *mat,
+    const char *filename,
+    size_t tile_rows, size_t tile_cols,
+    unsigned flags
+);
+int mat2d_read_from_tilefile(mat2d **out, const char *filename);
+mat2d_tilefile* mat2d_tilefile_open(const char *filename);
+void mat2d_tilefile_close(mat2d_tilefile *f);
+size_t mat2d_tilefile_get_rows(mat2d_tilefile *f);
+size_t mat2d_tilefile_get_cols(mat2d_tilefile *f);
+size_t mat2d_tilefile_get_tile_rows(mat2d_tilefile *f);
+size_t mat2d_tilefile_get_tile_cols(mat2d_tilefile *f);
+int mat2d_tilefile_read_block(mat2d_tilefile *f, size_t row, size_t col, mat2d *dst);
+
+// Batch driver: reads, transforms and writes a list of files with the
+// three stages on their own threads, joined by queues of depth matrices,
+// so reading file i + 1 and writing result i - 1 overlap computing i.
+// compute == NULL inverts. Files are binary unless TEXT_IN / TEXT_OUT.
+// A job that fails at any stage is skipped and makes the run return -1.
+enum mat2d_pipeline_flags {
+    MAT2D_PIPE_TEXT_IN  = 1 << 0,
+    MAT2D_PIPE_TEXT_OUT = 1 << 1
+};
+
+// Jobs a stage finished, the time it spent on them (not waiting on its
+// queues) and, for I/O stages, the file bytes they moved
+struct mat2d_pipeline_stage {
+    size_t jobs;
+    double seconds;
+    size_t bytes;
+};
+
+struct mat2d_pipeline_stats {
+    struct mat2d_pipeline_stage read, compute, write;
+    double wall_seconds;
+};
+
+typedef int (*mat2d_pipeline_fn)(mat2d **out, mat2d *in, void *arg);
+
+int mat2d_pipeline_run(
+    const char *const *inputs,
+    const char *const *outputs,
+    size_t count,
+    mat2d_pipeline_fn compute, void *arg,
+    size_t depth,
+    unsigned flags,
+    struct mat2d_pipeline_stats *stats
+);
+void mat2d_pipeline_print_stats(const struct mat2d_pipeline_stats *stats, FILE *file);
 
 void mat2d_debug(mat2d *mat, FILE *file);
 void mat2d_debug_console(mat2d *mat);
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "libmatrix/matrix.h"
+
+#include "arena.h"
+
+#define ARENA_ALIGN 64
+#define ARENA_MAX_DEPTH 32
+#define ARENA_MIN_CHUNK (1024 * 1024)
+
+struct arena_chunk {
+    struct arena_chunk *prev;
+    size_t size, used;
+    char *data;
+};
+
+struct arena_mark {
+    struct arena_chunk *chunk;
+    size_t used;
+    size_t total;
+};
+
+struct mat2d_arena {
+    // Newest chunk; older ones are reachable through prev
+    struct arena_chunk *head;
+    // Bytes handed out in the open scopes and the peak of that value
+    size_t total, high_water;
+    struct arena_mark marks[ARENA_MAX_DEPTH];
+    size_t depth;
+};
+
+static size_t round_up(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+static struct arena_chunk *arena_chunk_create(size_t size, struct arena_chunk *prev) {
+    struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk));
+    if (chunk == NULL) {
+        return NULL;
+    }
+    void *data = NULL;
+    if (posix_memalign(&data, ARENA_ALIGN, size) != 0) {
+        free(chunk);
+        return NULL;
+    }
+    chunk->prev = prev;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->data = data;
+    return chunk;
+}
+
+static void arena_chunk_destroy(struct arena_chunk *chunk) {
+    free(chunk->data);
+    free(chunk);
+}
+
+struct mat2d_arena* mat2d_arena_create(size_t capacity) {
+    struct mat2d_arena *arena = calloc(1, sizeof(struct mat2d_arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    if (capacity > 0) {
+        arena->head = arena_chunk_create(round_up(capacity, ARENA_ALIGN), NULL);
+        if (arena->head == NULL) {
+            free(arena);
+            return NULL;
+        }
+    }
+    return arena;
+}
+
+// arena maybe null
+void mat2d_arena_destroy(struct mat2d_arena *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    struct arena_chunk *chunk = arena->head;
+    while (chunk != NULL) {
+        struct arena_chunk *prev = chunk->prev;
+        arena_chunk_destroy(chunk);
+        chunk = prev;
+    }
+    free(arena);
+}
+
+void mat2d_arena_begin(struct mat2d_arena *arena) {
+    assert(arena->depth < ARENA_MAX_DEPTH);
+    struct arena_mark *mark = &arena->marks[arena->depth++];
+    mark->chunk = arena->head;
+    mark->used = arena->head != NULL ? arena->head->used : 0;
+    mark->total = arena->total;
+}
+
+// Releases everything allocated since the matching begin. Once the
+// outermost scope is closed, chunks grown during the scopes are folded
+// into a single block sized for the high-water mark, so a steady-state
+// workload keeps reusing one warm block without touching the heap.
+void mat2d_arena_end(struct mat2d_arena *arena) {
+    assert(arena->depth > 0);
+    struct arena_mark *mark = &arena->marks[--arena->depth];
+
+    while (arena->head != mark->chunk) {
+        struct arena_chunk *prev = arena->head->prev;
+        arena_chunk_destroy(arena->head);
+        arena->head = prev;
+    }
+    if (arena->head != NULL) {
+        arena->head->used = mark->used;
+    }
+    arena->total = mark->total;
+
+    bool fragmented = arena->head == NULL
+        || arena->head->prev != NULL
+        || arena->head->size < arena->high_water;
+    if (arena->depth == 0 && arena->total == 0 && fragmented) {
+        while (arena->head != NULL) {
+            struct arena_chunk *prev = arena->head->prev;
+            arena_chunk_destroy(arena->head);
+            arena->head = prev;
+        }
+        if (arena->high_water > 0) {
+            arena->head = arena_chunk_create(
+                round_up(arena->high_water, ARENA_ALIGN), NULL
+            );
+        }
+    }
+}
+
+void* mat2d_arena_alloc(struct mat2d_arena *arena, size_t bytes) {
+    bytes = round_up(bytes > 0 ? bytes : 1, ARENA_ALIGN);
+
+    struct arena_chunk *chunk = arena->head;
+    if (chunk == NULL || chunk->size - chunk->used < bytes) {
+        size_t size = chunk != NULL ? 2 * chunk->size : ARENA_MIN_CHUNK;
+        if (size < bytes) {
+            size = bytes;
+        }
+        chunk = arena_chunk_create(size, arena->head);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        arena->head = chunk;
+    }
+
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += bytes;
+    arena->total += bytes;
+    if (arena->total > arena->high_water) {
+        arena->high_water = arena->total;
+    }
+    return ptr;
+}
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+static void scratch_destroy(void *arena) {
+    mat2d_arena_destroy(arena);
+}
+
+static void scratch_init(void) {
+    pthread_key_create(&scratch_key, scratch_destroy);
+}
+
+mat2d_arena* arena_scratch(void) {
+    pthread_once(&scratch_once, scratch_init);
+    struct mat2d_arena *arena = pthread_getspecific(scratch_key);
+    if (arena == NULL) {
+        arena = mat2d_arena_create(0);
+        assert(arena != NULL);
+        pthread_setspecific(scratch_key, arena);
+    }
+    return arena;
+}
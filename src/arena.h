@@ -0,0 +1,10 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "libmatrix/matrix.h"
+
+// Per-thread arena for library-internal temporaries. Callers bracket
+// their use with mat2d_arena_begin/mat2d_arena_end; scopes nest.
+mat2d_arena* arena_scratch(void);
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "libmatrix/matrix.h"
+
+#include "arena.h"
+#include "cpu.h"
+
+#define BATCH_ALIGN 64
+
+// Matrices processed together, one per vector lane
+#define BATCH_LANES 4
+
+typedef double batch_vec __attribute__((vector_size(BATCH_LANES * sizeof(double))));
+typedef int64_t batch_mask __attribute__((vector_size(BATCH_LANES * sizeof(int64_t))));
+
+// Lane-wise select and absolute value. Macros rather than functions, so
+// that no vector crosses a call boundary in the baseline instantiation.
+#define BATCH_BLEND(mask, a, b) \
+    ((batch_vec)(((batch_mask)(a) & (mask)) | ((batch_mask)(b) & ~(mask))))
+#define BATCH_ABS(a) BATCH_BLEND((a) < 0.0, -(a), (a))
+
+struct mat2d_batch {
+    double *data;
+    size_t count, rows, cols;
+    // Distance between consecutive matrices, in elements
+    size_t stride;
+};
+
+struct batch_kernels {
+    int (*inv)(batch_vec *w, size_t n, size_t *perm);
+    void (*dot)(
+        batch_vec *c, const batch_vec *a, const batch_vec *b,
+        size_t m, size_t n, size_t k
+    );
+};
+
+#define BATCH_TARGET __attribute__((target("avx2,fma")))
+#define BATCH_FN(name) name##_avx2
+#include "batch_impl.h"
+
+#define BATCH_TARGET
+#define BATCH_FN(name) name##_generic
+#include "batch_impl.h"
+
+static const struct batch_kernels *batch_get_kernels(void) {
+    static const struct batch_kernels generic = {
+        batch_inv_group_generic, batch_dot_group_generic
+    };
+    static const struct batch_kernels avx2 = {
+        batch_inv_group_avx2, batch_dot_group_avx2
+    };
+    if (cpu_get_level() >= CPU_LEVEL_AVX2) {
+        return &avx2;
+    }
+    return &generic;
+}
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+struct mat2d_batch* mat2d_batch_create(size_t count, size_t rows, size_t cols) {
+    struct mat2d_batch *batch = malloc(sizeof(struct mat2d_batch));
+    if (batch == NULL) {
+        return NULL;
+    }
+    size_t bytes = sizeof(double) * count * rows * cols;
+    bytes = (bytes + BATCH_ALIGN - 1) / BATCH_ALIGN * BATCH_ALIGN;
+    void *data = NULL;
+    if (posix_memalign(&data, BATCH_ALIGN, bytes > 0 ? bytes : BATCH_ALIGN) != 0) {
+        free(batch);
+        return NULL;
+    }
+    memset(data, 0, bytes);
+
+    batch->data = data;
+    batch->count = count;
+    batch->rows = rows;
+    batch->cols = cols;
+    batch->stride = rows * cols;
+    return batch;
+}
+
+// batch maybe null
+void mat2d_batch_destroy(struct mat2d_batch *batch) {
+    if (batch == NULL) {
+        return;
+    }
+    free(batch->data);
+    free(batch);
+}
+
+size_t mat2d_batch_get_count(struct mat2d_batch *batch) {
+    return batch->count;
+}
+
+size_t mat2d_batch_get_rows(struct mat2d_batch *batch) {
+    return batch->rows;
+}
+
+size_t mat2d_batch_get_cols(struct mat2d_batch *batch) {
+    return batch->cols;
+}
+
+double* mat2d_batch_get_item(struct mat2d_batch *batch, size_t idx) {
+    assert(idx < batch->count);
+    return &batch->data[idx * batch->stride];
+}
+
+// Interleaves the matrices [first, first + lanes) into w. Unused lanes
+// are filled with pad on the diagonal, so that padding an inversion
+// with identities never reports a singular matrix.
+static void batch_gather(
+    batch_vec *w, const struct mat2d_batch *batch,
+    size_t first, size_t lanes, double pad
+) {
+    size_t elems = batch->rows * batch->cols;
+    for (size_t l = 0; l < BATCH_LANES; l++) {
+        if (l < lanes) {
+            const double *src = &batch->data[(first + l) * batch->stride];
+            for (size_t e = 0; e < elems; e++) {
+                w[e][l] = src[e];
+            }
+        } else {
+            for (size_t e = 0; e < elems; e++) {
+                w[e][l] = e / batch->cols == e % batch->cols ? pad : 0.0;
+            }
+        }
+    }
+}
+
+static void batch_scatter(
+    struct mat2d_batch *batch, const batch_vec *w,
+    size_t first, size_t lanes
+) {
+    size_t elems = batch->rows * batch->cols;
+    for (size_t l = 0; l < lanes; l++) {
+        double *dst = &batch->data[(first + l) * batch->stride];
+        for (size_t e = 0; e < elems; e++) {
+            dst[e] = w[e][l];
+        }
+    }
+}
+
+// out may be in itself. Returns -1 if any matrix is singular; the other
+// inverses are still computed.
+int mat2d_batch_inv(struct mat2d_batch *out, struct mat2d_batch *in) {
+    assert(in->rows == in->cols);
+    assert(out->count == in->count && out->rows == in->rows && out->cols == in->cols);
+    size_t n = in->rows;
+    size_t groups = (in->count + BATCH_LANES - 1) / BATCH_LANES;
+    const struct batch_kernels *kernels = batch_get_kernels();
+
+    int failed = 0;
+    #pragma omp parallel reduction(|:failed)
+    {
+        // One scratch scope per thread, reused by all its groups
+        mat2d_arena *scratch = arena_scratch();
+        mat2d_arena_begin(scratch);
+        batch_vec *w = mat2d_arena_alloc(scratch, sizeof(batch_vec) * n * n);
+        size_t *perm = mat2d_arena_alloc(scratch, sizeof(size_t) * n * BATCH_LANES);
+        assert(w != NULL && perm != NULL);
+
+        #pragma omp for schedule(static)
+        for (size_t g = 0; g < groups; g++) {
+            size_t first = g * BATCH_LANES;
+            size_t lanes = min_size(BATCH_LANES, in->count - first);
+            batch_gather(w, in, first, lanes, 1.0);
+            if (kernels->inv(w, n, perm) != 0) {
+                failed = 1;
+            }
+            batch_scatter(out, w, first, lanes);
+        }
+        mat2d_arena_end(scratch);
+    }
+    return failed ? -1 : 0;
+}
+
+// out[i] = left[i] * right[i]; out may alias either operand when the
+// shapes allow it
+int mat2d_batch_dot(
+    struct mat2d_batch *out,
+    struct mat2d_batch *left, struct mat2d_batch *right
+) {
+    assert(left->count == right->count && out->count == left->count);
+    assert(left->cols == right->rows);
+    assert(out->rows == left->rows && out->cols == right->cols);
+    size_t m = left->rows, n = right->cols, k = left->cols;
+    size_t groups = (left->count + BATCH_LANES - 1) / BATCH_LANES;
+    const struct batch_kernels *kernels = batch_get_kernels();
+
+    #pragma omp parallel
+    {
+        mat2d_arena *scratch = arena_scratch();
+        mat2d_arena_begin(scratch);
+        batch_vec *a = mat2d_arena_alloc(scratch, sizeof(batch_vec) * m * k);
+        batch_vec *b = mat2d_arena_alloc(scratch, sizeof(batch_vec) * k * n);
+        batch_vec *c = mat2d_arena_alloc(scratch, sizeof(batch_vec) * m * n);
+        assert(a != NULL && b != NULL && c != NULL);
+
+        #pragma omp for schedule(static)
+        for (size_t g = 0; g < groups; g++) {
+            size_t first = g * BATCH_LANES;
+            size_t lanes = min_size(BATCH_LANES, left->count - first);
+            batch_gather(a, left, first, lanes, 0.0);
+            batch_gather(b, right, first, lanes, 0.0);
+            kernels->dot(c, a, b, m, n, k);
+            batch_scatter(out, c, first, lanes);
+        }
+        mat2d_arena_end(scratch);
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Lane-parallel kernels for batch.c, instantiated once per target. The
+// includer defines:
+//   BATCH_TARGET    function attributes of the instantiation
+//   BATCH_FN(name)  suffixes the generated function names
+// Operands are interleaved: element (i, j) of the BATCH_LANES matrices of
+// a group is the vector w[i * cols + j], one matrix per lane.
+// No include guard: this file is meant to be included once per target.
+
+// In-place Gauss-Jordan with partial pivoting chosen per lane. The pivot
+// search and elimination run on whole vectors; only the O(n) row and
+// column exchanges touch lanes one by one. perm holds n * BATCH_LANES
+// pivot rows. Returns -1 when some lane hit a zero pivot.
+BATCH_TARGET
+static int BATCH_FN(batch_inv_group)(batch_vec *w, size_t n, size_t *perm) {
+    batch_mask singular = { 0 };
+    const batch_vec zero = { 0 };
+
+    for (size_t k = 0; k < n; k++) {
+        batch_vec best = BATCH_ABS(w[k * n + k]);
+        batch_vec pidx = zero + (double)k;
+        for (size_t i = k + 1; i < n; i++) {
+            batch_vec v = BATCH_ABS(w[i * n + k]);
+            batch_mask better = v > best;
+            best = BATCH_BLEND(better, v, best);
+            pidx = BATCH_BLEND(better, zero + (double)i, pidx);
+        }
+        batch_mask zero_pivot = best == zero;
+        singular |= zero_pivot;
+        for (size_t l = 0; l < BATCH_LANES; l++) {
+            size_t p = (size_t)pidx[l];
+            perm[k * BATCH_LANES + l] = p;
+            if (p == k) {
+                continue;
+            }
+            for (size_t j = 0; j < n; j++) {
+                double tmp = w[k * n + j][l];
+                w[k * n + j][l] = w[p * n + j][l];
+                w[p * n + j][l] = tmp;
+            }
+        }
+
+        // Singular lanes divide by one instead to keep the others finite
+        batch_vec diag = BATCH_BLEND(zero_pivot, zero + 1.0, w[k * n + k]);
+        batch_vec rdiag = (zero + 1.0) / diag;
+        batch_vec *prow = &w[k * n];
+        prow[k] = zero + 1.0;
+        for (size_t j = 0; j < n; j++) {
+            prow[j] *= rdiag;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (i == k) {
+                continue;
+            }
+            batch_vec *arow = &w[i * n];
+            batch_vec factor = arow[k];
+            arow[k] = zero;
+            for (size_t j = 0; j < n; j++) {
+                arow[j] -= factor * prow[j];
+            }
+        }
+    }
+
+    // Row exchanges on A become column exchanges on A^-1, undone in
+    // reverse order
+    for (size_t k = n; k-- > 0;) {
+        for (size_t l = 0; l < BATCH_LANES; l++) {
+            size_t c = perm[k * BATCH_LANES + l];
+            if (c == k) {
+                continue;
+            }
+            for (size_t i = 0; i < n; i++) {
+                double tmp = w[i * n + k][l];
+                w[i * n + k][l] = w[i * n + c][l];
+                w[i * n + c][l] = tmp;
+            }
+        }
+    }
+    for (size_t l = 0; l < BATCH_LANES; l++) {
+        if (singular[l]) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// c = a * b for an m x k by k x n group
+BATCH_TARGET
+static void BATCH_FN(batch_dot_group)(
+    batch_vec *c, const batch_vec *a, const batch_vec *b,
+    size_t m, size_t n, size_t k
+) {
+    const batch_vec zero = { 0 };
+    for (size_t i = 0; i < m; i++) {
+        batch_vec *crow = &c[i * n];
+        for (size_t j = 0; j < n; j++) {
+            crow[j] = zero;
+        }
+        for (size_t p = 0; p < k; p++) {
+            batch_vec aip = a[i * k + p];
+            const batch_vec *brow = &b[p * n];
+            for (size_t j = 0; j < n; j++) {
+                crow[j] += aip * brow[j];
+            }
+        }
+    }
+}
+
+#undef BATCH_TARGET
+#undef BATCH_FN
@@ -0,0 +1,408 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libmatrix/matrix.h"
+
+#include "binfile.h"
+#include "matrix_internal.h"
+
+#define SUM_P1 UINT64_C(0x9E3779B185EBCA87)
+#define SUM_P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define SUM_P3 UINT64_C(0x165667B19E3779F9)
+#define SUM_P5 UINT64_C(0x27D4EB2F165667C5)
+
+void binfile_swap_words(void *data, size_t count) {
+#if !BINFILE_NATIVE_LE
+    uint64_t *w = data;
+    for (size_t i = 0; i < count; i++) {
+        w[i] = __builtin_bswap64(w[i]);
+    }
+#else
+    (void)data;
+    (void)count;
+#endif
+}
+
+void binfile_encode_header(const struct binfile_header *hdr, unsigned char *buf) {
+    memset(buf, 0, BINFILE_HEADER_SIZE);
+    memcpy(buf, BINFILE_MAGIC, BINFILE_MAGIC_SIZE);
+    binfile_store_le32(&buf[8], hdr->version);
+    binfile_store_le32(&buf[12], hdr->dtype);
+    binfile_store_le32(&buf[16], hdr->flags);
+    binfile_store_le64(&buf[24], hdr->rows);
+    binfile_store_le64(&buf[32], hdr->cols);
+    binfile_store_le64(&buf[40], hdr->ld);
+    binfile_store_le64(&buf[48], hdr->data_offset);
+    binfile_store_le64(&buf[56], hdr->checksum);
+}
+
+int binfile_decode_header(struct binfile_header *hdr, const unsigned char *buf) {
+    if (memcmp(buf, BINFILE_MAGIC, BINFILE_MAGIC_SIZE) != 0) {
+        return -1;
+    }
+    hdr->version = binfile_load_le32(&buf[8]);
+    hdr->dtype = binfile_load_le32(&buf[12]);
+    hdr->flags = binfile_load_le32(&buf[16]);
+    hdr->rows = binfile_load_le64(&buf[24]);
+    hdr->cols = binfile_load_le64(&buf[32]);
+    hdr->ld = binfile_load_le64(&buf[40]);
+    hdr->data_offset = binfile_load_le64(&buf[48]);
+    hdr->checksum = binfile_load_le64(&buf[56]);
+    return 0;
+}
+
+size_t binfile_dtype_size(uint32_t dtype) {
+    switch (dtype) {
+    case BINFILE_F64:
+        return sizeof(double);
+    case BINFILE_F32:
+        return sizeof(float);
+    default:
+        return 0;
+    }
+}
+
+int binfile_check_header(
+    const struct binfile_header *hdr,
+    uint64_t file_size,
+    size_t *payload_bytes
+) {
+    size_t elem = binfile_dtype_size(hdr->dtype);
+    uint64_t elements, bytes, end;
+    if (hdr->version != BINFILE_VERSION || elem == 0
+        || hdr->ld < hdr->cols
+        || hdr->data_offset < BINFILE_HEADER_SIZE
+        || hdr->data_offset % BINFILE_ALIGN != 0
+        || __builtin_mul_overflow(hdr->rows, hdr->ld, &elements)
+        || __builtin_mul_overflow(elements, elem, &bytes)
+        || __builtin_add_overflow(bytes, hdr->data_offset, &end)
+        || end > file_size
+        || bytes > SIZE_MAX) {
+        return -1;
+    }
+    *payload_bytes = bytes;
+    return 0;
+}
+
+static uint64_t sum_rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t sum_round(uint64_t acc, uint64_t word) {
+    return sum_rotl(acc + word * SUM_P2, 31) * SUM_P1;
+}
+
+void binfile_sum_init(struct binfile_sum *sum) {
+    sum->acc[0] = SUM_P1 + SUM_P2;
+    sum->acc[1] = SUM_P2;
+    sum->acc[2] = 0;
+    sum->acc[3] = -SUM_P1;
+    sum->words = 0;
+}
+
+void binfile_sum_update(struct binfile_sum *sum, const void *data, size_t bytes) {
+    assert(bytes % sizeof(uint64_t) == 0);
+    const unsigned char *p = data;
+    size_t n = bytes / sizeof(uint64_t);
+    size_t i = 0;
+
+    // Word k always feeds lane k % 4, however the stream is split
+    for (; i < n && sum->words % 4 != 0; i++, sum->words++) {
+        size_t lane = sum->words % 4;
+        sum->acc[lane] = sum_round(sum->acc[lane], binfile_load_le64(&p[8 * i]));
+    }
+    uint64_t a0 = sum->acc[0], a1 = sum->acc[1], a2 = sum->acc[2], a3 = sum->acc[3];
+    for (; i + 4 <= n; i += 4) {
+        a0 = sum_round(a0, binfile_load_le64(&p[8 * i]));
+        a1 = sum_round(a1, binfile_load_le64(&p[8 * i + 8]));
+        a2 = sum_round(a2, binfile_load_le64(&p[8 * i + 16]));
+        a3 = sum_round(a3, binfile_load_le64(&p[8 * i + 24]));
+        sum->words += 4;
+    }
+    sum->acc[0] = a0;
+    sum->acc[1] = a1;
+    sum->acc[2] = a2;
+    sum->acc[3] = a3;
+    for (; i < n; i++, sum->words++) {
+        size_t lane = sum->words % 4;
+        sum->acc[lane] = sum_round(sum->acc[lane], binfile_load_le64(&p[8 * i]));
+    }
+}
+
+uint64_t binfile_sum_final(const struct binfile_sum *sum) {
+    uint64_t h = sum_rotl(sum->acc[0], 1) + sum_rotl(sum->acc[1], 7)
+        + sum_rotl(sum->acc[2], 12) + sum_rotl(sum->acc[3], 18);
+    h ^= sum->words * SUM_P5;
+    h ^= h >> 33;
+    h *= SUM_P2;
+    h ^= h >> 29;
+    h *= SUM_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Pre-versioned files: native size_t rows and cols, then the dense payload
+static int read_legacy(struct mat2d **out, FILE *file, unsigned flags) {
+    size_t rows, cols;
+    if (fread(&rows, sizeof(size_t), 1, file) != 1 ||
+        fread(&cols, sizeof(size_t), 1, file) != 1) {
+        return -1;
+    }
+
+    struct mat2d *mat = mat2d_create_ex(rows, cols, 0, flags);
+    if (mat == NULL) {
+        return -1;
+    }
+
+    // The file is always dense; padded rows are filled one at a time
+    size_t elements = rows * cols;
+    size_t nread = 0;
+    if (mat2d_dense(mat)) {
+        nread = fread(mat->data, sizeof(double), elements, file);
+    } else {
+        for (size_t i = 0; i < rows; i++) {
+            nread += fread(mat2d_at(mat, i, 0), sizeof(double), cols, file);
+        }
+    }
+    if (nread != elements) {
+        mat2d_destroy(mat);
+        return -1;
+    }
+
+    *out = mat;
+    return 0;
+}
+
+static int read_versioned(
+    struct mat2d **out, FILE *file,
+    const struct binfile_header *hdr,
+    unsigned flags
+) {
+    struct stat st;
+    size_t payload;
+    if (fstat(fileno(file), &st) != 0
+        || binfile_check_header(hdr, st.st_size, &payload) != 0
+        || hdr->dtype != BINFILE_F64
+        || fseek(file, hdr->data_offset, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    struct mat2d *mat = mat2d_create_ex(hdr->rows, hdr->cols, 0, flags);
+    if (mat == NULL) {
+        return -1;
+    }
+
+    struct binfile_sum sum;
+    binfile_sum_init(&sum);
+    int rc = 0;
+    if (mat->rs == hdr->ld) {
+        // Same pitch: the payload lands in place in one read
+        size_t elements = hdr->rows * hdr->ld;
+        if (fread(mat->data, sizeof(double), elements, file) != elements) {
+            rc = -1;
+        } else {
+            binfile_sum_update(&sum, mat->data, payload);
+            binfile_swap_words(mat->data, elements);
+        }
+    } else {
+        double *row = malloc(sizeof(double) * (hdr->ld > 0 ? hdr->ld : 1));
+        assert(row != NULL);
+        for (size_t i = 0; i < hdr->rows && rc == 0; i++) {
+            if (fread(row, sizeof(double), hdr->ld, file) != hdr->ld) {
+                rc = -1;
+                break;
+            }
+            binfile_sum_update(&sum, row, sizeof(double) * hdr->ld);
+            binfile_swap_words(row, hdr->ld);
+            memcpy(mat2d_at(mat, i, 0), row, sizeof(double) * hdr->cols);
+        }
+        free(row);
+    }
+
+    if (rc == 0 && (hdr->flags & BINFILE_HAS_CHECKSUM)
+        && binfile_sum_final(&sum) != hdr->checksum) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        mat2d_destroy(mat);
+        return -1;
+    }
+    *out = mat;
+    return 0;
+}
+
+int mat2d_read_from_binfile(struct mat2d **out, const char *filename) {
+    return mat2d_read_from_binfile_ex(out, filename, MAT2D_ALLOC_DENSE);
+}
+
+// Accepts both the versioned format and the older bare rows/cols files
+int mat2d_read_from_binfile_ex(struct mat2d **out, const char *filename, unsigned flags) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return -1;
+    }
+
+    unsigned char buf[BINFILE_HEADER_SIZE];
+    struct binfile_header hdr;
+    int rc;
+    if (fread(buf, 1, sizeof(buf), file) == sizeof(buf)
+        && binfile_decode_header(&hdr, buf) == 0) {
+        rc = read_versioned(out, file, &hdr, flags);
+    } else {
+        rewind(file);
+        rc = read_legacy(out, file, flags);
+    }
+
+    fclose(file);
+    return rc;
+}
+
+int mat2d_write_to_binfile(const struct mat2d *mat, const char *filename) {
+    return mat2d_write_to_binfile_ex(mat, filename, MAT2D_FILE_CHECKSUM);
+}
+
+// Matrices that own their storage keep their row pitch, so a padded
+// matrix maps back padded; views are packed to ld == cols
+int mat2d_write_to_binfile_ex(const struct mat2d *mat, const char *filename, unsigned flags) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        perror("Failed to open file");
+        return -1;
+    }
+
+    struct binfile_header hdr = {
+        .version = BINFILE_VERSION,
+        .dtype = BINFILE_F64,
+        .flags = (flags & MAT2D_FILE_CHECKSUM) ? BINFILE_HAS_CHECKSUM : 0,
+        .rows = mat->rows,
+        .cols = mat->cols,
+        .ld = mat->storage != NULL && mat->cs == 1 ? mat->rs : mat->cols,
+        .data_offset = BINFILE_HEADER_SIZE,
+        .checksum = 0,
+    };
+
+    // The checksum is only known at the end: write the header twice
+    unsigned char buf[BINFILE_HEADER_SIZE];
+    binfile_encode_header(&hdr, buf);
+    if (fwrite(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+        perror("Error writing matrix header");
+        fclose(file);
+        return -1;
+    }
+
+    struct binfile_sum sum;
+    binfile_sum_init(&sum);
+    int rc = 0;
+    if (BINFILE_NATIVE_LE && mat2d_dense(mat) && hdr.ld == mat->cols) {
+        size_t elements = mat->rows * mat->cols;
+        binfile_sum_update(&sum, mat->data, sizeof(double) * elements);
+        if (fwrite(mat->data, sizeof(double), elements, file) != elements) {
+            rc = -1;
+        }
+    } else {
+        // Row by row through a buffer: gathers strided views, zeroes the
+        // padding and fixes the byte order
+        double *row = calloc(hdr.ld > 0 ? hdr.ld : 1, sizeof(double));
+        assert(row != NULL);
+        for (size_t i = 0; i < mat->rows && rc == 0; i++) {
+            const double *src = mat2d_at(mat, i, 0);
+            for (size_t j = 0; j < mat->cols; j++) {
+                row[j] = src[j * mat->cs];
+            }
+            binfile_swap_words(row, mat->cols);
+            binfile_sum_update(&sum, row, sizeof(double) * hdr.ld);
+            if (fwrite(row, sizeof(double), hdr.ld, file) != hdr.ld) {
+                rc = -1;
+            }
+        }
+        free(row);
+    }
+    if (rc != 0) {
+        perror("Error writing matrix data");
+        fclose(file);
+        return -1;
+    }
+
+    if (hdr.flags & BINFILE_HAS_CHECKSUM) {
+        hdr.checksum = binfile_sum_final(&sum);
+        binfile_encode_header(&hdr, buf);
+        if (fseek(file, 0, SEEK_SET) != 0
+            || fwrite(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+            perror("Error writing matrix header");
+            rc = -1;
+        }
+    }
+
+    if (fclose(file) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+int mat2d_open_mapped(struct mat2d **out, const char *filename, unsigned flags) {
+    if (!BINFILE_NATIVE_LE) {
+        // The pages are used as is, so they must already be in host order
+        return -1;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    unsigned char buf[BINFILE_HEADER_SIZE];
+    struct binfile_header hdr;
+    struct stat st;
+    size_t payload;
+    if (fstat(fd, &st) != 0
+        || pread(fd, buf, sizeof(buf), 0) != sizeof(buf)
+        || binfile_decode_header(&hdr, buf) != 0
+        || binfile_check_header(&hdr, st.st_size, &payload) != 0
+        || hdr.dtype != BINFILE_F64) {
+        close(fd);
+        return -1;
+    }
+
+    // Private mappings never write back; with PROT_WRITE the first store
+    // to a page gives this process its own copy of it
+    size_t map_size = hdr.data_offset + payload;
+    int prot = PROT_READ | ((flags & MAT2D_MAP_COW) ? PROT_WRITE : 0);
+    void *base = mmap(NULL, map_size, prot, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    double *data = (double *)((unsigned char *)base + hdr.data_offset);
+    if ((flags & MAT2D_MAP_VERIFY) && (hdr.flags & BINFILE_HAS_CHECKSUM)) {
+        struct binfile_sum sum;
+        binfile_sum_init(&sum);
+        binfile_sum_update(&sum, data, payload);
+        if (binfile_sum_final(&sum) != hdr.checksum) {
+            munmap(base, map_size);
+            return -1;
+        }
+    }
+
+    struct mat2d *mat = malloc(sizeof(struct mat2d));
+    assert(mat != NULL);
+    mat->data = data;
+    mat->rows = hdr.rows;
+    mat->cols = hdr.cols;
+    mat->rs = hdr.ld;
+    mat->cs = 1;
+    mat->storage = base;
+    mat->storage_size = map_size;
+    mat->in_arena = false;
+    mat->mapped = true;
+
+    *out = mat;
+    return 0;
+}
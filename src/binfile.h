@@ -0,0 +1,112 @@
+#ifndef BINFILE_H
+#define BINFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// On-disk layout of a versioned matrix file, all fields little-endian:
+//
+//    0  magic        "MAT2DBIN"
+//    8  version      u32, BINFILE_VERSION
+//   12  dtype        u32, enum binfile_dtype
+//   16  flags        u32, BINFILE_HAS_CHECKSUM
+//   20  reserved     u32, zero
+//   24  rows         u64
+//   32  cols         u64
+//   40  ld           u64, row pitch in elements, >= cols
+//   48  data_offset  u64, multiple of BINFILE_ALIGN
+//   56  checksum     u64, over the rows * ld elements of the payload
+//
+// The payload holds rows * ld little-endian elements starting at
+// data_offset; padding elements past cols are written as zero.
+
+#define BINFILE_MAGIC "MAT2DBIN"
+#define BINFILE_MAGIC_SIZE 8
+#define BINFILE_VERSION 1
+#define BINFILE_HEADER_SIZE 64
+#define BINFILE_ALIGN 64
+
+#define BINFILE_HAS_CHECKSUM (1u << 0)
+
+enum binfile_dtype {
+    BINFILE_F64 = 1,
+    BINFILE_F32 = 2
+};
+
+struct binfile_header {
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t flags;
+    uint64_t rows, cols;
+    uint64_t ld;
+    uint64_t data_offset;
+    uint64_t checksum;
+};
+
+void binfile_encode_header(const struct binfile_header *hdr, unsigned char *buf);
+
+// Returns -1 when buf does not start with the magic; 0 otherwise, even
+// if the header is not usable (see binfile_check_header)
+int binfile_decode_header(struct binfile_header *hdr, const unsigned char *buf);
+
+// Validates a decoded header against the size of its file. On success
+// stores the size of the payload in bytes.
+int binfile_check_header(
+    const struct binfile_header *hdr,
+    uint64_t file_size,
+    size_t *payload_bytes
+);
+
+size_t binfile_dtype_size(uint32_t dtype);
+
+#define BINFILE_NATIVE_LE (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+// Little-endian field access shared by the file formats
+static inline void binfile_store_le32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static inline void binfile_store_le64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static inline uint32_t binfile_load_le32(const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= (uint32_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+static inline uint64_t binfile_load_le64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if !BINFILE_NATIVE_LE
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// Converts count 8-byte words between file and host byte order in place;
+// a no-op on little-endian hosts
+void binfile_swap_words(void *data, size_t count);
+
+// Streaming 64-bit checksum in the style of xxHash64: four independent
+// lanes over 8-byte little-endian words, so a multi-GB payload is
+// verified at memory bandwidth. Updates must be whole words.
+struct binfile_sum {
+    uint64_t acc[4];
+    uint64_t words;
+};
+
+void binfile_sum_init(struct binfile_sum *sum);
+void binfile_sum_update(struct binfile_sum *sum, const void *data, size_t bytes);
+uint64_t binfile_sum_final(const struct binfile_sum *sum);
+
+#endif
@@ -0,0 +1,44 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "cpu.h"
+
+static enum cpu_level detected_level = CPU_LEVEL_SSE2;
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+static enum cpu_level cpu_detect_hw(void) {
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma")) {
+        return CPU_LEVEL_SSE2;
+    }
+    if (!__builtin_cpu_supports("avx512f")) {
+        return CPU_LEVEL_AVX2;
+    }
+    return CPU_LEVEL_AVX512;
+}
+
+static void cpu_detect(void) {
+    enum cpu_level level = cpu_detect_hw();
+
+    const char *override = getenv("MAT2D_CPU");
+    if (override != NULL) {
+        enum cpu_level requested = level;
+        if (strcmp(override, "sse2") == 0) {
+            requested = CPU_LEVEL_SSE2;
+        } else if (strcmp(override, "avx2") == 0) {
+            requested = CPU_LEVEL_AVX2;
+        } else if (strcmp(override, "avx512") == 0) {
+            requested = CPU_LEVEL_AVX512;
+        }
+        if (requested < level) {
+            level = requested;
+        }
+    }
+    detected_level = level;
+}
+
+enum cpu_level cpu_get_level(void) {
+    pthread_once(&detect_once, cpu_detect);
+    return detected_level;
+}
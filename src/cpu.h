@@ -0,0 +1,19 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Instruction set tiers the kernels are built for; each implies the ones
+// below it
+enum cpu_level {
+    CPU_LEVEL_SSE2,
+    // AVX2 and FMA
+    CPU_LEVEL_AVX2,
+    // AVX-512 Foundation
+    CPU_LEVEL_AVX512
+};
+
+// Highest tier the running CPU supports, detected once. The MAT2D_CPU
+// environment variable (sse2, avx2 or avx512) lowers it, e.g. to test
+// the fallbacks on a modern host; it never raises it past the hardware.
+enum cpu_level cpu_get_level(void);
+
+#endif
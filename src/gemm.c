@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <immintrin.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "arena.h"
+#include "cpu.h"
+#include "gemm.h"
+#include "transpose.h"
+
+// Register tile computed by one microkernel call: MR rows by one or
+// two vectors of the element type
+#define GEMM_MR 6
+#define GEMM_NR_D 8
+#define GEMM_NR_S 16
+
+// Cache blocking: A panel (MC x KC) stays in L2, B micro-panel
+// (KC x NR) in L1, B panel (KC x NC) in L3
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4080
+
+// Below this many multiply-adds packing costs more than it saves
+#define GEMM_SMALL_FLOPS (48 * 48 * 48)
+
+// Below this many multiply-adds one thread beats waking the others
+#define GEMM_PAR_FLOPS (192 * 192 * 192)
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static size_t round_up(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+// Threads worth spending on an m x n x k product. Calls already inside a
+// parallel region, such as those of the batch kernels, stay on their
+// thread.
+static size_t gemm_threads(size_t m, size_t n, size_t k) {
+#ifdef _OPENMP
+    if (m * n * k >= GEMM_PAR_FLOPS && !omp_in_parallel()) {
+        return omp_get_max_threads();
+    }
+#endif
+    (void)m;
+    (void)n;
+    (void)k;
+    return 1;
+}
+
+#define GEMM_AVX2_ROW_STORE_D(r, lo, hi)                                     \
+    do {                                                                     \
+        double *crow = &c[(r) * ldc];                                        \
+        __m256d l = _mm256_mul_pd(valpha, lo);                               \
+        __m256d h = _mm256_mul_pd(valpha, hi);                               \
+        if (beta != 0.0) {                                                   \
+            l = _mm256_fmadd_pd(vbeta, _mm256_loadu_pd(crow), l);            \
+            h = _mm256_fmadd_pd(vbeta, _mm256_loadu_pd(crow + 4), h);        \
+        }                                                                    \
+        _mm256_storeu_pd(crow, l);                                           \
+        _mm256_storeu_pd(crow + 4, h);                                       \
+    } while (0)
+
+// 6x8 tile held in 12 ymm accumulators; packed panels are 64-byte aligned
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2_d(
+    size_t kc,
+    const double *a,
+    const double *b,
+    double *c, size_t ldc,
+    double alpha, double beta
+) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+    for (size_t p = 0; p < kc; p++) {
+        __m256d b0 = _mm256_load_pd(b);
+        __m256d b1 = _mm256_load_pd(b + 4);
+        __m256d ai;
+
+        ai = _mm256_broadcast_sd(a + 0);
+        c00 = _mm256_fmadd_pd(ai, b0, c00);
+        c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + 1);
+        c10 = _mm256_fmadd_pd(ai, b0, c10);
+        c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + 2);
+        c20 = _mm256_fmadd_pd(ai, b0, c20);
+        c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + 3);
+        c30 = _mm256_fmadd_pd(ai, b0, c30);
+        c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + 4);
+        c40 = _mm256_fmadd_pd(ai, b0, c40);
+        c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + 5);
+        c50 = _mm256_fmadd_pd(ai, b0, c50);
+        c51 = _mm256_fmadd_pd(ai, b1, c51);
+
+        a += GEMM_MR;
+        b += GEMM_NR_D;
+    }
+
+    __m256d valpha = _mm256_set1_pd(alpha);
+    __m256d vbeta = _mm256_set1_pd(beta);
+    GEMM_AVX2_ROW_STORE_D(0, c00, c01);
+    GEMM_AVX2_ROW_STORE_D(1, c10, c11);
+    GEMM_AVX2_ROW_STORE_D(2, c20, c21);
+    GEMM_AVX2_ROW_STORE_D(3, c30, c31);
+    GEMM_AVX2_ROW_STORE_D(4, c40, c41);
+    GEMM_AVX2_ROW_STORE_D(5, c50, c51);
+}
+
+#define GEMM_AVX2_ROW_STORE_S(r, lo, hi)                                     \
+    do {                                                                     \
+        float *crow = &c[(r) * ldc];                                         \
+        __m256 l = _mm256_mul_ps(valpha, lo);                                \
+        __m256 h = _mm256_mul_ps(valpha, hi);                                \
+        if (beta != 0.0) {                                                   \
+            l = _mm256_fmadd_ps(vbeta, _mm256_loadu_ps(crow), l);            \
+            h = _mm256_fmadd_ps(vbeta, _mm256_loadu_ps(crow + 8), h);        \
+        }                                                                    \
+        _mm256_storeu_ps(crow, l);                                           \
+        _mm256_storeu_ps(crow + 8, h);                                       \
+    } while (0)
+
+// 6x16 float tile, same register layout as the double kernel
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2_s(
+    size_t kc,
+    const float *a,
+    const float *b,
+    float *c, size_t ldc,
+    float alpha, float beta
+) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for (size_t p = 0; p < kc; p++) {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+        __m256 ai;
+
+        ai = _mm256_broadcast_ss(a + 0);
+        c00 = _mm256_fmadd_ps(ai, b0, c00);
+        c01 = _mm256_fmadd_ps(ai, b1, c01);
+        ai = _mm256_broadcast_ss(a + 1);
+        c10 = _mm256_fmadd_ps(ai, b0, c10);
+        c11 = _mm256_fmadd_ps(ai, b1, c11);
+        ai = _mm256_broadcast_ss(a + 2);
+        c20 = _mm256_fmadd_ps(ai, b0, c20);
+        c21 = _mm256_fmadd_ps(ai, b1, c21);
+        ai = _mm256_broadcast_ss(a + 3);
+        c30 = _mm256_fmadd_ps(ai, b0, c30);
+        c31 = _mm256_fmadd_ps(ai, b1, c31);
+        ai = _mm256_broadcast_ss(a + 4);
+        c40 = _mm256_fmadd_ps(ai, b0, c40);
+        c41 = _mm256_fmadd_ps(ai, b1, c41);
+        ai = _mm256_broadcast_ss(a + 5);
+        c50 = _mm256_fmadd_ps(ai, b0, c50);
+        c51 = _mm256_fmadd_ps(ai, b1, c51);
+
+        a += GEMM_MR;
+        b += GEMM_NR_S;
+    }
+
+    __m256 valpha = _mm256_set1_ps(alpha);
+    __m256 vbeta = _mm256_set1_ps(beta);
+    GEMM_AVX2_ROW_STORE_S(0, c00, c01);
+    GEMM_AVX2_ROW_STORE_S(1, c10, c11);
+    GEMM_AVX2_ROW_STORE_S(2, c20, c21);
+    GEMM_AVX2_ROW_STORE_S(3, c30, c31);
+    GEMM_AVX2_ROW_STORE_S(4, c40, c41);
+    GEMM_AVX2_ROW_STORE_S(5, c50, c51);
+}
+
+#define GEMM_T double
+#define GEMM_NR GEMM_NR_D
+#define GEMM_FN(name) name##_d
+#define GEMM_NAME gemm_dgemm
+#define GEMM_KERNEL_AVX2 gemm_kernel_avx2_d
+#define GEMM_TRANSPOSE transpose_d
+#include "gemm_impl.h"
+
+#define GEMM_T float
+#define GEMM_NR GEMM_NR_S
+#define GEMM_FN(name) name##_s
+#define GEMM_NAME gemm_sgemm
+#define GEMM_KERNEL_AVX2 gemm_kernel_avx2_s
+#include "gemm_impl.h"
@@ -0,0 +1,29 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stddef.h>
+
+// C = alpha * A * B + beta * C. A is m x k, B is k x n, C is m x n.
+// Element (i, j) of an operand X lives at x[i * rsx + j * csx], so
+// row-major blocks, strided views and transposes are all accepted.
+// When beta == 0 the previous contents of C are never read.
+void gemm_dgemm(
+    size_t m, size_t n, size_t k,
+    double alpha,
+    const double *a, size_t rsa, size_t csa,
+    const double *b, size_t rsb, size_t csb,
+    double beta,
+    double *c, size_t rsc, size_t csc
+);
+
+// Single precision counterpart of gemm_dgemm
+void gemm_sgemm(
+    size_t m, size_t n, size_t k,
+    float alpha,
+    const float *a, size_t rsa, size_t csa,
+    const float *b, size_t rsb, size_t csb,
+    float beta,
+    float *c, size_t rsc, size_t csc
+);
+
+#endif
@@ -0,0 +1,299 @@
+// Blocked GEMM body shared by the double and float instantiations in
+// gemm.c. The includer defines:
+//   GEMM_T            element type
+//   GEMM_NR           register tile width for that type
+//   GEMM_FN(name)     suffixes internal helper names
+//   GEMM_NAME         public entry point
+//   GEMM_KERNEL_AVX2  AVX2+FMA microkernel for GEMM_MR x GEMM_NR
+//   GEMM_TRANSPOSE    optional transpose_* used to pack transposed B
+// No include guard: this file is meant to be included once per type.
+
+typedef void (*GEMM_FN(gemm_kernel_fn))(
+    size_t kc,
+    const GEMM_T *a,
+    const GEMM_T *b,
+    GEMM_T *c, size_t ldc,
+    GEMM_T alpha, GEMM_T beta
+);
+
+static void GEMM_FN(gemm_kernel_scalar)(
+    size_t kc,
+    const GEMM_T *a,
+    const GEMM_T *b,
+    GEMM_T *c, size_t ldc,
+    GEMM_T alpha, GEMM_T beta
+) {
+    GEMM_T ab[GEMM_MR * GEMM_NR] = { 0 };
+    for (size_t p = 0; p < kc; p++) {
+        for (size_t i = 0; i < GEMM_MR; i++) {
+            GEMM_T aip = a[i];
+            for (size_t j = 0; j < GEMM_NR; j++) {
+                ab[i * GEMM_NR + j] += aip * b[j];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    for (size_t i = 0; i < GEMM_MR; i++) {
+        GEMM_T *crow = &c[i * ldc];
+        if (beta == 0) {
+            for (size_t j = 0; j < GEMM_NR; j++) {
+                crow[j] = alpha * ab[i * GEMM_NR + j];
+            }
+        } else {
+            for (size_t j = 0; j < GEMM_NR; j++) {
+                crow[j] = alpha * ab[i * GEMM_NR + j] + beta * crow[j];
+            }
+        }
+    }
+}
+
+static GEMM_FN(gemm_kernel_fn) GEMM_FN(gemm_get_kernel)(void) {
+    if (cpu_get_level() >= CPU_LEVEL_AVX2) {
+        return GEMM_KERNEL_AVX2;
+    }
+    return GEMM_FN(gemm_kernel_scalar);
+}
+
+// Packs an mc x kc block of A into MR-row micro-panels, column by column,
+// zero-padding the last panel up to MR rows
+static void GEMM_FN(gemm_pack_a)(
+    size_t mc, size_t kc,
+    const GEMM_T *a, size_t rsa, size_t csa,
+    GEMM_T *packed
+) {
+    for (size_t ir = 0; ir < mc; ir += GEMM_MR) {
+        size_t mr = min_size(GEMM_MR, mc - ir);
+        const GEMM_T *src = &a[ir * rsa];
+        for (size_t p = 0; p < kc; p++) {
+            size_t i = 0;
+            for (; i < mr; i++) {
+                packed[i] = src[i * rsa + p * csa];
+            }
+            for (; i < GEMM_MR; i++) {
+                packed[i] = 0;
+            }
+            packed += GEMM_MR;
+        }
+    }
+}
+
+// Packs a kc x nc block of B into NR-column micro-panels, row by row,
+// zero-padding the last panel up to NR columns
+static void GEMM_FN(gemm_pack_b)(
+    size_t kc, size_t nc,
+    const GEMM_T *b, size_t rsb, size_t csb,
+    GEMM_T *packed
+) {
+    for (size_t jr = 0; jr < nc; jr += GEMM_NR) {
+        size_t nr = min_size(GEMM_NR, nc - jr);
+        const GEMM_T *src = &b[jr * csb];
+#ifdef GEMM_TRANSPOSE
+        if (rsb == 1 && csb != 1) {
+            // Transposed B: the micro-panel is a transpose of the block
+            GEMM_TRANSPOSE(nr, kc, src, csb, packed, GEMM_NR);
+            for (size_t p = 0; p < kc; p++) {
+                for (size_t j = nr; j < GEMM_NR; j++) {
+                    packed[p * GEMM_NR + j] = 0;
+                }
+            }
+            packed += kc * GEMM_NR;
+            continue;
+        }
+#endif
+        for (size_t p = 0; p < kc; p++) {
+            const GEMM_T *brow = &src[p * rsb];
+            size_t j = 0;
+            if (csb == 1) {
+                for (; j < nr; j++) {
+                    packed[j] = brow[j];
+                }
+            } else {
+                for (; j < nr; j++) {
+                    packed[j] = brow[j * csb];
+                }
+            }
+            for (; j < GEMM_NR; j++) {
+                packed[j] = 0;
+            }
+            packed += GEMM_NR;
+        }
+    }
+}
+
+static void GEMM_FN(gemm_macro_kernel)(
+    GEMM_FN(gemm_kernel_fn) kernel,
+    size_t mc, size_t nc, size_t kc,
+    GEMM_T alpha,
+    const GEMM_T *packed_a,
+    const GEMM_T *packed_b,
+    GEMM_T beta,
+    GEMM_T *c, size_t rsc, size_t csc
+) {
+    GEMM_T edge[GEMM_MR * GEMM_NR];
+
+    for (size_t jr = 0; jr < nc; jr += GEMM_NR) {
+        size_t nr = min_size(GEMM_NR, nc - jr);
+        for (size_t ir = 0; ir < mc; ir += GEMM_MR) {
+            size_t mr = min_size(GEMM_MR, mc - ir);
+            const GEMM_T *ap = &packed_a[ir * kc];
+            const GEMM_T *bp = &packed_b[jr * kc];
+            GEMM_T *ctile = &c[ir * rsc + jr * csc];
+
+            if (mr == GEMM_MR && nr == GEMM_NR && csc == 1) {
+                kernel(kc, ap, bp, ctile, rsc, alpha, beta);
+                continue;
+            }
+
+            // Partial or non-unit-stride tile: compute the full register
+            // tile into scratch and merge only the valid part back into C
+            kernel(kc, ap, bp, edge, GEMM_NR, alpha, 0);
+            for (size_t i = 0; i < mr; i++) {
+                GEMM_T *crow = &ctile[i * rsc];
+                for (size_t j = 0; j < nr; j++) {
+                    crow[j * csc] = beta == 0
+                        ? edge[i * GEMM_NR + j]
+                        : edge[i * GEMM_NR + j] + beta * crow[j * csc];
+                }
+            }
+        }
+    }
+}
+
+static void GEMM_FN(gemm_scale)(
+    size_t m, size_t n,
+    GEMM_T beta,
+    GEMM_T *c, size_t rsc, size_t csc
+) {
+    if (beta == 1) {
+        return;
+    }
+    for (size_t i = 0; i < m; i++) {
+        GEMM_T *crow = &c[i * rsc];
+        if (beta == 0 && csc == 1) {
+            memset(crow, 0, sizeof(GEMM_T) * n);
+        } else if (beta == 0) {
+            for (size_t j = 0; j < n; j++) {
+                crow[j * csc] = 0;
+            }
+        } else {
+            for (size_t j = 0; j < n; j++) {
+                crow[j * csc] *= beta;
+            }
+        }
+    }
+}
+
+// Unpacked i-k-j loop for products too small to amortize packing
+static void GEMM_FN(gemm_small)(
+    size_t m, size_t n, size_t k,
+    GEMM_T alpha,
+    const GEMM_T *a, size_t rsa, size_t csa,
+    const GEMM_T *b, size_t rsb, size_t csb,
+    GEMM_T beta,
+    GEMM_T *c, size_t rsc, size_t csc
+) {
+    GEMM_FN(gemm_scale)(m, n, beta, c, rsc, csc);
+    for (size_t i = 0; i < m; i++) {
+        GEMM_T *crow = &c[i * rsc];
+        const GEMM_T *arow = &a[i * rsa];
+        for (size_t p = 0; p < k; p++) {
+            GEMM_T aip = alpha * arow[p * csa];
+            const GEMM_T *brow = &b[p * rsb];
+            if (csb == 1 && csc == 1) {
+                for (size_t j = 0; j < n; j++) {
+                    crow[j] += aip * brow[j];
+                }
+            } else {
+                for (size_t j = 0; j < n; j++) {
+                    crow[j * csc] += aip * brow[j * csb];
+                }
+            }
+        }
+    }
+}
+
+void GEMM_NAME(
+    size_t m, size_t n, size_t k,
+    GEMM_T alpha,
+    const GEMM_T *a, size_t rsa, size_t csa,
+    const GEMM_T *b, size_t rsb, size_t csb,
+    GEMM_T beta,
+    GEMM_T *c, size_t rsc, size_t csc
+) {
+    if (m == 0 || n == 0) {
+        return;
+    }
+    if (k == 0 || alpha == 0) {
+        GEMM_FN(gemm_scale)(m, n, beta, c, rsc, csc);
+        return;
+    }
+    if (m * n * k <= GEMM_SMALL_FLOPS) {
+        GEMM_FN(gemm_small)(
+            m, n, k, alpha, a, rsa, csa, b, rsb, csb,
+            beta, c, rsc, csc
+        );
+        return;
+    }
+
+    GEMM_FN(gemm_kernel_fn) kernel = GEMM_FN(gemm_get_kernel)();
+    size_t threads = gemm_threads(m, n, k);
+    size_t nc_max = round_up(min_size(n, GEMM_NC), GEMM_NR);
+    size_t kc_max = min_size(k, GEMM_KC);
+    // Narrower row blocks when there are too few to go round the threads
+    size_t mc_step = min_size(GEMM_MC, round_up((m + threads - 1) / threads, GEMM_MR));
+    size_t mc_max = round_up(min_size(m, mc_step), GEMM_MR);
+
+    mat2d_arena *scratch = arena_scratch();
+    mat2d_arena_begin(scratch);
+    GEMM_T *packed_b = mat2d_arena_alloc(scratch, sizeof(GEMM_T) * nc_max * kc_max);
+    assert(packed_b != NULL);
+
+    // All threads pack the shared B panel, then each takes whole row
+    // blocks of C with its own packed A
+    #pragma omp parallel num_threads(threads) if(threads > 1)
+    {
+        mat2d_arena *local = arena_scratch();
+        mat2d_arena_begin(local);
+        GEMM_T *packed_a = mat2d_arena_alloc(local, sizeof(GEMM_T) * mc_max * kc_max);
+        assert(packed_a != NULL);
+
+        for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+            size_t nc = min_size(GEMM_NC, n - jc);
+            for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+                size_t kc = min_size(GEMM_KC, k - pc);
+                GEMM_T beta_pc = pc == 0 ? beta : 1;
+                const GEMM_T *bpc = &b[pc * rsb + jc * csb];
+
+                #pragma omp for schedule(static)
+                for (size_t jr = 0; jr < nc; jr += GEMM_NR) {
+                    GEMM_FN(gemm_pack_b)(
+                        kc, min_size(GEMM_NR, nc - jr),
+                        &bpc[jr * csb], rsb, csb, &packed_b[jr * kc]
+                    );
+                }
+                #pragma omp for schedule(static)
+                for (size_t ic = 0; ic < m; ic += mc_step) {
+                    size_t mc = min_size(mc_step, m - ic);
+                    GEMM_FN(gemm_pack_a)(mc, kc, &a[ic * rsa + pc * csa], rsa, csa, packed_a);
+                    GEMM_FN(gemm_macro_kernel)(
+                        kernel, mc, nc, kc, alpha,
+                        packed_a, packed_b,
+                        beta_pc, &c[ic * rsc + jc * csc], rsc, csc
+                    );
+                }
+            }
+        }
+        mat2d_arena_end(local);
+    }
+
+    mat2d_arena_end(scratch);
+}
+
+#undef GEMM_T
+#undef GEMM_NR
+#undef GEMM_FN
+#undef GEMM_NAME
+#undef GEMM_KERNEL_AVX2
+#undef GEMM_TRANSPOSE
@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "libmatrix/matrix.h"
+
+#include "arena.h"
+#include "gemm.h"
+#include "kernels.h"
+#include "matrix_internal.h"
+
+// Column panel width of the blocked in-place Gauss-Jordan
+#define GJ_NB 64
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static void swap_rows(double *a, size_t lda, size_t n, size_t r1, size_t r2) {
+    if (r1 == r2) {
+        return;
+    }
+    double *row1 = &a[r1 * lda];
+    double *row2 = &a[r2 * lda];
+    for (size_t j = 0; j < n; j++) {
+        double tmp = row1[j];
+        row1[j] = row2[j];
+        row2[j] = tmp;
+    }
+}
+
+static void swap_cols(double *a, size_t lda, size_t n, size_t c1, size_t c2) {
+    if (c1 == c2) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        double *row = &a[i * lda];
+        double tmp = row[c1];
+        row[c1] = row[c2];
+        row[c2] = tmp;
+    }
+}
+
+// Unblocked in-place Gauss-Jordan restricted to the n x jb column panel
+// starting at k0. Afterwards the panel holds the panel columns of the
+// accumulated elimination transform, which the caller applies to the
+// remaining columns with GEMM.
+static int gj_panel(
+    double *a, size_t lda, size_t n,
+    size_t k0, size_t jb,
+    size_t *piv
+) {
+    for (size_t jj = 0; jj < jb; jj++) {
+        size_t c = k0 + jj;
+
+        size_t p = c;
+        double pmax = fabs(a[c * lda + c]);
+        for (size_t i = c + 1; i < n; i++) {
+            double v = fabs(a[i * lda + c]);
+            if (v > pmax) {
+                pmax = v;
+                p = i;
+            }
+        }
+        if (pmax == 0.0) {
+            return -1;
+        }
+        piv[c] = p;
+        swap_rows(a, lda, n, c, p);
+
+        double *prow = &a[c * lda + k0];
+        double rdiag = 1.0 / prow[jj];
+        kern_scale(jb, rdiag, prow);
+        prow[jj] = rdiag;
+
+        for (size_t i = 0; i < n; i++) {
+            if (i == c) {
+                continue;
+            }
+            double *arow = &a[i * lda + k0];
+            double factor = arow[jj];
+            if (factor == 0.0) {
+                continue;
+            }
+            kern_axpy(jb, -factor, prow, arow);
+            arow[jj] = -factor * rdiag;
+        }
+    }
+    return 0;
+}
+
+// Applies the panel transform T to the column block [c0, c1): rows above
+// and below the panel get A0X += A01 * A1X and A2X += A21 * A1X, the
+// panel rows become A1X = A11 * A1X
+static void gj_update(
+    double *a, size_t lda, size_t n,
+    size_t k0, size_t jb,
+    size_t c0, size_t c1,
+    mat2d_arena *scratch
+) {
+    size_t w = c1 - c0;
+    if (w == 0) {
+        return;
+    }
+    size_t k1 = k0 + jb;
+
+    mat2d_arena_begin(scratch);
+    double *a1x = mat2d_arena_alloc(scratch, sizeof(double) * jb * w);
+    assert(a1x != NULL);
+    for (size_t i = 0; i < jb; i++) {
+        const double *src = &a[(k0 + i) * lda + c0];
+        for (size_t j = 0; j < w; j++) {
+            a1x[i * w + j] = src[j];
+        }
+    }
+
+    gemm_dgemm(
+        k0, w, jb,
+        1.0, &a[k0], lda, 1,
+        a1x, w, 1,
+        1.0, &a[c0], lda, 1
+    );
+    gemm_dgemm(
+        n - k1, w, jb,
+        1.0, &a[k1 * lda + k0], lda, 1,
+        a1x, w, 1,
+        1.0, &a[k1 * lda + c0], lda, 1
+    );
+    gemm_dgemm(
+        jb, w, jb,
+        1.0, &a[k0 * lda + k0], lda, 1,
+        a1x, w, 1,
+        0.0, &a[k0 * lda + c0], lda, 1
+    );
+    mat2d_arena_end(scratch);
+}
+
+static int gj_invert(double *a, size_t lda, size_t n, mat2d_arena *scratch) {
+    mat2d_arena_begin(scratch);
+    size_t *piv = mat2d_arena_alloc(scratch, sizeof(size_t) * n);
+    assert(piv != NULL);
+
+    int rc = 0;
+    for (size_t k0 = 0; k0 < n && rc == 0; k0 += GJ_NB) {
+        size_t jb = min_size(GJ_NB, n - k0);
+        if ((rc = gj_panel(a, lda, n, k0, jb, piv)) != 0) {
+            break;
+        }
+        gj_update(a, lda, n, k0, jb, 0, k0, scratch);
+        gj_update(a, lda, n, k0, jb, k0 + jb, n, scratch);
+    }
+
+    // Row exchanges on A become column exchanges on A^-1, undone in
+    // reverse order
+    if (rc == 0) {
+        for (size_t k = n; k-- > 0;) {
+            swap_cols(a, lda, n, k, piv[k]);
+        }
+    }
+
+    mat2d_arena_end(scratch);
+    return rc;
+}
+
+// On failure (singular input) the contents of mat are unspecified
+int mat2d_inv_inplace(struct mat2d *mat) {
+    assert(mat->rows == mat->cols);
+    size_t n = mat->rows;
+    if (n == 0) {
+        return 0;
+    }
+
+    mat2d_arena *scratch = arena_scratch();
+    int rc = 0;
+    if (mat->cs == 1) {
+        rc = gj_invert(mat->data, mat->rs, n, scratch);
+    } else if (mat->rs == 1) {
+        // Transposed storage: (A^T)^-1 = (A^-1)^T, so invert the parent
+        rc = gj_invert(mat->data, mat->cs, n, scratch);
+    } else {
+        mat2d_arena_begin(scratch);
+        struct mat2d *dense = mat2d_create_in(scratch, n, n, MAT2D_ALLOC_PADDED);
+        assert(dense != NULL);
+        mat2d_copy(dense, mat);
+        rc = gj_invert(dense->data, dense->rs, n, scratch);
+        if (rc == 0) {
+            mat2d_copy(mat, dense);
+        }
+        mat2d_arena_end(scratch);
+    }
+    return rc;
+}
@@ -0,0 +1,120 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "kernels.h"
+
+struct kern_ops {
+    double (*dot)(size_t n, const double *x, const double *y);
+    void (*axpy)(size_t n, double alpha, const double *x, double *y);
+    void (*axpy2)(
+        size_t n, double alpha,
+        const double *x1, double *y1,
+        const double *x2, double *y2
+    );
+    void (*ger)(
+        size_t m, size_t n, double alpha,
+        const double *x, size_t incx,
+        const double *y,
+        double *a, size_t lda
+    );
+    void (*scale)(size_t n, double alpha, double *x);
+    void (*fill)(size_t n, double value, double *x);
+    bool (*close)(size_t n, const double *x, const double *y, double eps);
+    double (*max_diff)(size_t n, const double *x, const double *y);
+    void (*axpy_s)(size_t n, float alpha, const float *x, float *y);
+    void (*ger_s)(
+        size_t m, size_t n, float alpha,
+        const float *x, size_t incx,
+        const float *y,
+        float *a, size_t lda
+    );
+    void (*scale_s)(size_t n, float alpha, float *x);
+};
+
+#define KERN_TARGET
+#define KERN_WIDTH 2
+#define KERN_FN(name) name##_sse2
+#include "kernels_impl.h"
+
+#define KERN_TARGET __attribute__((target("avx2,fma")))
+#define KERN_WIDTH 4
+#define KERN_FN(name) name##_avx2
+#include "kernels_impl.h"
+
+#define KERN_TARGET __attribute__((target("avx512f")))
+#define KERN_WIDTH 8
+#define KERN_FN(name) name##_avx512
+#include "kernels_impl.h"
+
+// No cached pointer here: cpu_get_level settles the level once under
+// pthread_once, so OpenMP threads can dispatch concurrently
+static const struct kern_ops *kern_get_ops(void) {
+    switch (cpu_get_level()) {
+    case CPU_LEVEL_AVX512:
+        return &kern_ops_avx512;
+    case CPU_LEVEL_AVX2:
+        return &kern_ops_avx2;
+    default:
+        return &kern_ops_sse2;
+    }
+}
+
+double kern_dot(size_t n, const double *x, const double *y) {
+    return kern_get_ops()->dot(n, x, y);
+}
+
+void kern_axpy(size_t n, double alpha, const double *x, double *y) {
+    kern_get_ops()->axpy(n, alpha, x, y);
+}
+
+void kern_axpy2(
+    size_t n, double alpha,
+    const double *x1, double *y1,
+    const double *x2, double *y2
+) {
+    kern_get_ops()->axpy2(n, alpha, x1, y1, x2, y2);
+}
+
+void kern_ger(
+    size_t m, size_t n, double alpha,
+    const double *x, size_t incx,
+    const double *y,
+    double *a, size_t lda
+) {
+    kern_get_ops()->ger(m, n, alpha, x, incx, y, a, lda);
+}
+
+void kern_scale(size_t n, double alpha, double *x) {
+    kern_get_ops()->scale(n, alpha, x);
+}
+
+void kern_fill(size_t n, double value, double *x) {
+    kern_get_ops()->fill(n, value, x);
+}
+
+bool kern_close(size_t n, const double *x, const double *y, double eps) {
+    return kern_get_ops()->close(n, x, y, eps);
+}
+
+double kern_max_diff(size_t n, const double *x, const double *y) {
+    return kern_get_ops()->max_diff(n, x, y);
+}
+
+void kern_axpy_s(size_t n, float alpha, const float *x, float *y) {
+    kern_get_ops()->axpy_s(n, alpha, x, y);
+}
+
+void kern_ger_s(
+    size_t m, size_t n, float alpha,
+    const float *x, size_t incx,
+    const float *y,
+    float *a, size_t lda
+) {
+    kern_get_ops()->ger_s(m, n, alpha, x, incx, y, a, lda);
+}
+
+void kern_scale_s(size_t n, float alpha, float *x) {
+    kern_get_ops()->scale_s(n, alpha, x);
+}
@@ -0,0 +1,54 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Contiguous vector loops, compiled for SSE2, AVX2+FMA and AVX-512 and
+// dispatched through cpu_get_level
+
+// Returns sum x[i] * y[i]
+double kern_dot(size_t n, const double *x, const double *y);
+
+// y += alpha * x
+void kern_axpy(size_t n, double alpha, const double *x, double *y);
+
+// y1 += alpha * x1 and y2 += alpha * x2 in a single pass
+void kern_axpy2(
+    size_t n, double alpha,
+    const double *x1, double *y1,
+    const double *x2, double *y2
+);
+
+// A += alpha * x * y^T for the m x n row-major A; x is read with stride
+// incx, so a column of another matrix can be passed directly
+void kern_ger(
+    size_t m, size_t n, double alpha,
+    const double *x, size_t incx,
+    const double *y,
+    double *a, size_t lda
+);
+
+// x *= alpha
+void kern_scale(size_t n, double alpha, double *x);
+
+// x = value
+void kern_fill(size_t n, double value, double *x);
+
+// |x[i] - y[i]| <= eps for every i; stops at the first vector that fails
+bool kern_close(size_t n, const double *x, const double *y, double eps);
+
+// Returns max |x[i] - y[i]|, ignoring NaN differences; 0 for n == 0
+double kern_max_diff(size_t n, const double *x, const double *y);
+
+// Float versions of kern_axpy, kern_ger and kern_scale
+void kern_axpy_s(size_t n, float alpha, const float *x, float *y);
+void kern_ger_s(
+    size_t m, size_t n, float alpha,
+    const float *x, size_t incx,
+    const float *y,
+    float *a, size_t lda
+);
+void kern_scale_s(size_t n, float alpha, float *x);
+
+#endif
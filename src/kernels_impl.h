@@ -0,0 +1,237 @@
+// Kernel bodies for kernels.c, instantiated once per instruction set. The
+// includer defines:
+//   KERN_TARGET     function attributes of the instantiation
+//   KERN_WIDTH      doubles per vector register; floats get twice as many
+//   KERN_FN(name)   suffixes the generated names
+// No include guard: this file is meant to be included once per target.
+
+// Reduced alignment makes every dereference an unaligned load or store
+typedef double KERN_FN(vec)
+    __attribute__((vector_size(KERN_WIDTH * sizeof(double)), aligned(sizeof(double))));
+typedef long long KERN_FN(mask)
+    __attribute__((vector_size(KERN_WIDTH * sizeof(long long))));
+
+// The same register holds twice as many floats
+typedef float KERN_FN(vecf)
+    __attribute__((vector_size(KERN_WIDTH * sizeof(double)), aligned(sizeof(float))));
+
+#define KERN_VEC KERN_FN(vec)
+#define KERN_LOAD(p) (*(const KERN_VEC *)(p))
+#define KERN_STORE(p, v) (*(KERN_VEC *)(p) = (v))
+#define KERN_WIDTH_S (2 * KERN_WIDTH)
+#define KERN_LOAD_S(p) (*(const KERN_FN(vecf) *)(p))
+#define KERN_STORE_S(p, v) (*(KERN_FN(vecf) *)(p) = (v))
+
+KERN_TARGET
+static double KERN_FN(kern_dot)(size_t n, const double *x, const double *y) {
+    KERN_VEC acc0 = { 0 }, acc1 = { 0 };
+    size_t i = 0;
+    for (; i + 2 * KERN_WIDTH <= n; i += 2 * KERN_WIDTH) {
+        acc0 += KERN_LOAD(&x[i]) * KERN_LOAD(&y[i]);
+        acc1 += KERN_LOAD(&x[i + KERN_WIDTH]) * KERN_LOAD(&y[i + KERN_WIDTH]);
+    }
+    for (; i + KERN_WIDTH <= n; i += KERN_WIDTH) {
+        acc0 += KERN_LOAD(&x[i]) * KERN_LOAD(&y[i]);
+    }
+    acc0 += acc1;
+
+    double sum = 0.0;
+    for (size_t l = 0; l < KERN_WIDTH; l++) {
+        sum += acc0[l];
+    }
+    for (; i < n; i++) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+KERN_TARGET
+static void KERN_FN(kern_axpy)(size_t n, double alpha, const double *x, double *y) {
+    size_t i = 0;
+    for (; i + 2 * KERN_WIDTH <= n; i += 2 * KERN_WIDTH) {
+        KERN_STORE(&y[i], KERN_LOAD(&y[i]) + alpha * KERN_LOAD(&x[i]));
+        KERN_STORE(
+            &y[i + KERN_WIDTH],
+            KERN_LOAD(&y[i + KERN_WIDTH]) + alpha * KERN_LOAD(&x[i + KERN_WIDTH])
+        );
+    }
+    for (; i + KERN_WIDTH <= n; i += KERN_WIDTH) {
+        KERN_STORE(&y[i], KERN_LOAD(&y[i]) + alpha * KERN_LOAD(&x[i]));
+    }
+    for (; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// Both halves of an augmented row [y1 | y2] in one pass, so the row
+// operation of Gauss-Jordan streams the pivot row pair only once
+KERN_TARGET
+static void KERN_FN(kern_axpy2)(
+    size_t n, double alpha,
+    const double *x1, double *y1,
+    const double *x2, double *y2
+) {
+    size_t i = 0;
+    for (; i + KERN_WIDTH <= n; i += KERN_WIDTH) {
+        KERN_STORE(&y1[i], KERN_LOAD(&y1[i]) + alpha * KERN_LOAD(&x1[i]));
+        KERN_STORE(&y2[i], KERN_LOAD(&y2[i]) + alpha * KERN_LOAD(&x2[i]));
+    }
+    for (; i < n; i++) {
+        y1[i] += alpha * x1[i];
+        y2[i] += alpha * x2[i];
+    }
+}
+
+KERN_TARGET
+static void KERN_FN(kern_ger)(
+    size_t m, size_t n, double alpha,
+    const double *x, size_t incx,
+    const double *y,
+    double *a, size_t lda
+) {
+    for (size_t i = 0; i < m; i++) {
+        double axi = alpha * x[i * incx];
+        if (axi != 0.0) {
+            KERN_FN(kern_axpy)(n, axi, y, &a[i * lda]);
+        }
+    }
+}
+
+KERN_TARGET
+static void KERN_FN(kern_scale)(size_t n, double alpha, double *x) {
+    size_t i = 0;
+    for (; i + KERN_WIDTH <= n; i += KERN_WIDTH) {
+        KERN_STORE(&x[i], alpha * KERN_LOAD(&x[i]));
+    }
+    for (; i < n; i++) {
+        x[i] *= alpha;
+    }
+}
+
+KERN_TARGET
+static void KERN_FN(kern_fill)(size_t n, double value, double *x) {
+    KERN_VEC v = { 0 };
+    v += value;
+    size_t i = 0;
+    for (; i + KERN_WIDTH <= n; i += KERN_WIDTH) {
+        KERN_STORE(&x[i], v);
+    }
+    for (; i < n; i++) {
+        x[i] = value;
+    }
+}
+
+// NaN differences compare as close, matching the scalar fabs(d) > eps
+KERN_TARGET
+static bool KERN_FN(kern_close)(size_t n, const double *x, const double *y, double eps) {
+    size_t i = 0;
+    for (; i + KERN_WIDTH <= n; i += KERN_WIDTH) {
+        KERN_VEC d = KERN_LOAD(&x[i]) - KERN_LOAD(&y[i]);
+        KERN_FN(mask) far = (d > eps) | (d < -eps);
+        for (size_t l = 0; l < KERN_WIDTH; l++) {
+            if (far[l]) {
+                return false;
+            }
+        }
+    }
+    for (; i < n; i++) {
+        double d = x[i] - y[i];
+        if (d > eps || d < -eps) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// NaN differences are skipped, as in kern_close
+KERN_TARGET
+static double KERN_FN(kern_max_diff)(size_t n, const double *x, const double *y) {
+    // Every bit but the sign
+    KERN_FN(mask) magnitude = { 0 };
+    magnitude += INT64_MAX;
+    KERN_VEC m = { 0 };
+    size_t i = 0;
+    for (; i + KERN_WIDTH <= n; i += KERN_WIDTH) {
+        KERN_VEC d = KERN_LOAD(&x[i]) - KERN_LOAD(&y[i]);
+        // A NaN lane never compares greater, so it is never kept
+        KERN_VEC ad = (KERN_VEC)((KERN_FN(mask))d & magnitude);
+        KERN_FN(mask) gt = ad > m;
+        m = (KERN_VEC)(((KERN_FN(mask))ad & gt) | ((KERN_FN(mask))m & ~gt));
+    }
+
+    double max = 0.0;
+    for (size_t l = 0; l < KERN_WIDTH; l++) {
+        if (m[l] > max) {
+            max = m[l];
+        }
+    }
+    for (; i < n; i++) {
+        double d = x[i] - y[i];
+        double ad = d < 0 ? -d : d;
+        if (ad > max) {
+            max = ad;
+        }
+    }
+    return max;
+}
+
+KERN_TARGET
+static void KERN_FN(kern_axpy_s)(size_t n, float alpha, const float *x, float *y) {
+    size_t i = 0;
+    for (; i + KERN_WIDTH_S <= n; i += KERN_WIDTH_S) {
+        KERN_STORE_S(&y[i], KERN_LOAD_S(&y[i]) + alpha * KERN_LOAD_S(&x[i]));
+    }
+    for (; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+KERN_TARGET
+static void KERN_FN(kern_ger_s)(
+    size_t m, size_t n, float alpha,
+    const float *x, size_t incx,
+    const float *y,
+    float *a, size_t lda
+) {
+    for (size_t i = 0; i < m; i++) {
+        float axi = alpha * x[i * incx];
+        if (axi != 0.0f) {
+            KERN_FN(kern_axpy_s)(n, axi, y, &a[i * lda]);
+        }
+    }
+}
+
+KERN_TARGET
+static void KERN_FN(kern_scale_s)(size_t n, float alpha, float *x) {
+    size_t i = 0;
+    for (; i + KERN_WIDTH_S <= n; i += KERN_WIDTH_S) {
+        KERN_STORE_S(&x[i], alpha * KERN_LOAD_S(&x[i]));
+    }
+    for (; i < n; i++) {
+        x[i] *= alpha;
+    }
+}
+
+static const struct kern_ops KERN_FN(kern_ops) = {
+    KERN_FN(kern_dot),
+    KERN_FN(kern_axpy),
+    KERN_FN(kern_axpy2),
+    KERN_FN(kern_ger),
+    KERN_FN(kern_scale),
+    KERN_FN(kern_fill),
+    KERN_FN(kern_close),
+    KERN_FN(kern_max_diff),
+    KERN_FN(kern_axpy_s),
+    KERN_FN(kern_ger_s),
+    KERN_FN(kern_scale_s),
+};
+
+#undef KERN_WIDTH_S
+#undef KERN_LOAD_S
+#undef KERN_STORE_S
+#undef KERN_VEC
+#undef KERN_LOAD
+#undef KERN_STORE
+#undef KERN_TARGET
+#undef KERN_WIDTH
+#undef KERN_FN
@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "libmatrix/matrix.h"
+
+#include "arena.h"
+#include "gemm.h"
+#include "kernels.h"
+#include "matrix_internal.h"
+#include "small.h"
+
+// Panel width of the blocked factorization and triangular solves
+#define LU_NB 64
+
+// Threaded parts of the factorization and solves split into strips of
+// this many columns or blocks of this many rows, and stay on one thread
+// below LU_PAR_MIN elements
+#define LU_PAR_COLS 256
+#define LU_PAR_ROWS 256
+#define LU_PAR_MIN (1 << 15)
+
+// Refinement steps before the mixed solver gives up on the float
+// factorization, as in LAPACK's dsgesv
+#define MIXED_MAX_ITERS 30
+
+struct mat2d_lu {
+    // Unit lower L below the diagonal, U on and above it, P*A = L*U
+    struct mat2d *lu;
+    // Row i was swapped with row piv[i] at step i
+    size_t *piv;
+};
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+#define LU_T double
+#define LU_FN(name) name##_d
+#define LU_GEMM gemm_dgemm
+#define LU_FABS fabs
+#define LU_AXPY kern_axpy
+#define LU_SCALE kern_scale
+#define LU_GER kern_ger
+#include "lu_impl.h"
+
+#define LU_T float
+#define LU_FN(name) name##_s
+#define LU_GEMM gemm_sgemm
+#define LU_FABS fabsf
+#define LU_AXPY kern_axpy_s
+#define LU_SCALE kern_scale_s
+#define LU_GER kern_ger_s
+#include "lu_impl.h"
+
+// Copies in into lu->lu and factors it; storage is provided by the caller
+static int lu_factor_into(struct mat2d_lu *lu, struct mat2d *in) {
+    size_t n = mat2d_get_rows(in);
+    mat2d_copy(lu->lu, in);
+    return lu_factor_blocked_d(
+        mat2d_get_data(lu->lu), mat2d_get_ld(lu->lu),
+        n, lu->piv
+    );
+}
+
+int mat2d_lu_factor(struct mat2d_lu **out, struct mat2d *in) {
+    assert(mat2d_get_rows(in) == mat2d_get_cols(in));
+    size_t n = mat2d_get_rows(in);
+
+    struct mat2d_lu *lu = malloc(sizeof(struct mat2d_lu));
+    if (lu == NULL) {
+        return -1;
+    }
+    lu->piv = malloc(sizeof(size_t) * (n > 0 ? n : 1));
+    if (lu->piv == NULL) {
+        free(lu);
+        return -1;
+    }
+    // The pivot search walks columns, so keep the factor on padded rows
+    lu->lu = mat2d_create_ex(n, n, 0, MAT2D_ALLOC_PADDED);
+    if (lu->lu == NULL) {
+        free(lu->piv);
+        free(lu);
+        return -1;
+    }
+
+    if (lu_factor_into(lu, in) != 0) {
+        mat2d_lu_destroy(lu);
+        return -1;
+    }
+
+    *out = lu;
+    return 0;
+}
+
+static void lu_solve_inplace(struct mat2d_lu *lu, struct mat2d *x) {
+    lu_solve_piv_d(
+        mat2d_get_data(lu->lu), mat2d_get_ld(lu->lu),
+        mat2d_get_rows(lu->lu), lu->piv,
+        mat2d_get_data(x), mat2d_get_ld(x), mat2d_get_cols(x)
+    );
+}
+
+int mat2d_lu_solve(struct mat2d **out, struct mat2d_lu *lu, struct mat2d *rhs) {
+    assert(mat2d_get_rows(rhs) == mat2d_get_rows(lu->lu));
+
+    struct mat2d *x = NULL;
+    mat2d_clone(&x, rhs);
+    lu_solve_inplace(lu, x);
+
+    *out = x;
+    return 0;
+}
+
+// lu maybe null
+void mat2d_lu_destroy(struct mat2d_lu *lu) {
+    if (lu == NULL) {
+        return;
+    }
+    mat2d_destroy(lu->lu);
+    free(lu->piv);
+    free(lu);
+}
+
+// out == in (or a view with the same layout) inverts in place with
+// Gauss-Jordan; otherwise A is factored in scratch and out = solve(A, I)
+int mat2d_inv_into(struct mat2d *out, struct mat2d *in) {
+    assert(in->rows == in->cols);
+    assert(out->rows == in->rows && out->cols == in->cols);
+    size_t n = in->rows;
+
+    // Closed form for the smallest sizes; it reads all of in before
+    // writing, so any aliasing is fine
+    if (n >= 2 && n <= SMALL_INV_MAX
+        && small_inv(n, in->data, in->rs, in->cs, out->data, out->rs, out->cs) == 0) {
+        return 0;
+    }
+    if (out->data == in->data && out->rs == in->rs && out->cs == in->cs) {
+        return mat2d_inv_inplace(out);
+    }
+    if (mat2d_overlaps(out, in)) {
+        return -1;
+    }
+
+    // The factorization is scratch: once the scratch arena has warmed up,
+    // repeated inversions allocate nothing
+    mat2d_arena *scratch = arena_scratch();
+    mat2d_arena_begin(scratch);
+
+    struct mat2d_lu lu = {
+        .lu = mat2d_create_in(scratch, n, n, MAT2D_ALLOC_PADDED),
+        .piv = mat2d_arena_alloc(scratch, sizeof(size_t) * n),
+    };
+    assert(lu.lu != NULL && lu.piv != NULL);
+
+    int rc = lu_factor_into(&lu, in);
+    if (rc == 0 && out->cs == 1) {
+        // A^-1 = solve(A, I), computed in place in the identity
+        mat2d_fill_eye(out);
+        lu_solve_inplace(&lu, out);
+    } else if (rc == 0) {
+        struct mat2d *inverse = mat2d_create_in(scratch, n, n, MAT2D_ALLOC_DENSE);
+        assert(inverse != NULL);
+        mat2d_fill_eye(inverse);
+        lu_solve_inplace(&lu, inverse);
+        mat2d_copy(out, inverse);
+    }
+
+    mat2d_arena_end(scratch);
+    return rc;
+}
+
+int mat2d_inv(struct mat2d **out, struct mat2d *in) {
+    struct mat2d *inverse = mat2d_create(in->rows, in->cols);
+    int rc = mat2d_inv_into(inverse, in);
+    if (rc != 0) {
+        mat2d_destroy(inverse);
+        return rc;
+    }
+
+    *out = inverse;
+    return 0;
+}
+
+static double mixed_norm_inf(struct mat2d *mat) {
+    double norm = 0.0;
+    for (size_t i = 0; i < mat->rows; i++) {
+        double sum = 0.0;
+        for (size_t j = 0; j < mat->cols; j++) {
+            sum += fabs(*mat2d_at(mat, i, j));
+        }
+        norm = fmax(norm, sum);
+    }
+    return norm;
+}
+
+// Every column of the residual is below cte times the matching column of x
+static bool mixed_converged(struct mat2d *r, struct mat2d *x, double cte) {
+    for (size_t j = 0; j < x->cols; j++) {
+        double rmax = 0.0, xmax = 0.0;
+        for (size_t i = 0; i < x->rows; i++) {
+            rmax = fmax(rmax, fabs(*mat2d_at(r, i, j)));
+            xmax = fmax(xmax, fabs(*mat2d_at(x, i, j)));
+        }
+        if (rmax > xmax * cte) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Solves A * X = B into the dense x: the O(n^3) factorization runs in
+// float, each refinement step costs one double residual and two float
+// triangular solves
+static int lu_solve_mixed_into(struct mat2d *x, struct mat2d *a, struct mat2d *b) {
+    size_t n = a->rows;
+    size_t nrhs = b->cols;
+
+    mat2d_arena *scratch = arena_scratch();
+    mat2d_arena_begin(scratch);
+    struct mat2f *af = mat2f_create_in(scratch, n, n, MAT2D_ALLOC_PADDED);
+    struct mat2f *df = mat2f_create_in(scratch, n, nrhs, MAT2D_ALLOC_DENSE);
+    struct mat2d *r = mat2d_create_in(scratch, n, nrhs, MAT2D_ALLOC_DENSE);
+    size_t *piv = mat2d_arena_alloc(scratch, sizeof(size_t) * n);
+    assert(af != NULL && df != NULL && r != NULL && piv != NULL);
+
+    bool refined = false;
+    if (mat2f_from_mat2d(af, a) == 0
+        && lu_factor_blocked_s(af->data, af->ld, n, piv) == 0
+        && mat2f_from_mat2d(df, b) == 0) {
+        lu_solve_piv_s(af->data, af->ld, n, piv, df->data, df->ld, nrhs);
+        mat2d_from_mat2f(x, df);
+
+        double cte = mixed_norm_inf(a) * DBL_EPSILON * sqrt((double)n);
+        for (size_t iter = 0; iter < MIXED_MAX_ITERS; iter++) {
+            // r = b - A * x, in double
+            mat2d_copy(r, b);
+            gemm_dgemm(
+                n, nrhs, n,
+                -1.0, a->data, a->rs, a->cs,
+                x->data, x->rs, x->cs,
+                1.0, r->data, r->rs, r->cs
+            );
+            if (mixed_converged(r, x, cte)) {
+                refined = true;
+                break;
+            }
+
+            // x += A^-1 * r with the float factors
+            if (mat2f_from_mat2d(df, r) != 0) {
+                break;
+            }
+            lu_solve_piv_s(af->data, af->ld, n, piv, df->data, df->ld, nrhs);
+            for (size_t i = 0; i < n; i++) {
+                double *xrow = mat2d_at(x, i, 0);
+                const float *drow = &df->data[i * df->ld];
+                for (size_t j = 0; j < nrhs; j++) {
+                    xrow[j] += drow[j];
+                }
+            }
+        }
+    }
+
+    int rc = 0;
+    if (!refined) {
+        // Out of float range, singular in float, or too ill-conditioned
+        // for refinement to converge: solve in double instead
+        struct mat2d_lu lu = {
+            .lu = mat2d_create_in(scratch, n, n, MAT2D_ALLOC_PADDED),
+            .piv = piv,
+        };
+        assert(lu.lu != NULL);
+        rc = lu_factor_into(&lu, a);
+        if (rc == 0) {
+            mat2d_copy(x, b);
+            lu_solve_inplace(&lu, x);
+        }
+    }
+
+    mat2d_arena_end(scratch);
+    return rc;
+}
+
+int mat2d_solve_mixed(struct mat2d **out, struct mat2d *a, struct mat2d *rhs) {
+    assert(a->rows == a->cols);
+    assert(rhs->rows == a->rows);
+
+    struct mat2d *x = mat2d_create(rhs->rows, rhs->cols);
+    int rc = lu_solve_mixed_into(x, a, rhs);
+    if (rc != 0) {
+        mat2d_destroy(x);
+        return rc;
+    }
+
+    *out = x;
+    return 0;
+}
+
+int mat2d_inv_mixed(struct mat2d **out, struct mat2d *in) {
+    assert(in->rows == in->cols);
+    size_t n = in->rows;
+
+    mat2d_arena *scratch = arena_scratch();
+    mat2d_arena_begin(scratch);
+    struct mat2d *eye = mat2d_create_in(scratch, n, n, MAT2D_ALLOC_DENSE);
+    assert(eye != NULL);
+    mat2d_fill_eye(eye);
+    int rc = mat2d_solve_mixed(out, in, eye);
+    mat2d_arena_end(scratch);
+    return rc;
+}
@@ -0,0 +1,191 @@
+// Blocked LU kernels shared by the double and float instantiations in
+// lu.c. The includer defines:
+//   LU_T           element type
+//   LU_FN(name)    suffixes the generated function names
+//   LU_GEMM        gemm_dgemm or gemm_sgemm
+//   LU_FABS        fabs or fabsf
+//   LU_AXPY        y += alpha * x over a contiguous row
+//   LU_SCALE       x *= alpha over a contiguous row
+//   LU_GER         rank-1 update A += alpha * x * y^T, x strided
+// No include guard: this file is meant to be included once per type.
+
+static void LU_FN(swap_rows)(LU_T *a, size_t lda, size_t n, size_t r1, size_t r2) {
+    if (r1 == r2) {
+        return;
+    }
+    LU_T *row1 = &a[r1 * lda];
+    LU_T *row2 = &a[r2 * lda];
+    for (size_t j = 0; j < n; j++) {
+        LU_T tmp = row1[j];
+        row1[j] = row2[j];
+        row2[j] = tmp;
+    }
+}
+
+// Unblocked factorization of the n x jb panel starting at column j0.
+// Pivot rows are swapped across the full width so the trailing matrix
+// and the already factored columns stay consistent.
+static int LU_FN(lu_factor_panel)(
+    LU_T *a, size_t lda, size_t n,
+    size_t j0, size_t jb,
+    size_t *piv
+) {
+    for (size_t j = j0; j < j0 + jb; j++) {
+        size_t p = j;
+        LU_T pmax = LU_FABS(a[j * lda + j]);
+        for (size_t i = j + 1; i < n; i++) {
+            LU_T v = LU_FABS(a[i * lda + j]);
+            if (v > pmax) {
+                pmax = v;
+                p = i;
+            }
+        }
+        if (pmax == 0) {
+            return -1;
+        }
+
+        piv[j] = p;
+        LU_FN(swap_rows)(a, lda, n, j, p);
+
+        LU_T *prow = &a[j * lda];
+        LU_T rdiag = 1 / prow[j];
+        for (size_t i = j + 1; i < n; i++) {
+            a[i * lda + j] *= rdiag;
+        }
+        // The rest of the panel takes the rank-1 update -l * u^T, a block
+        // of rows per thread
+        size_t width = j0 + jb - j - 1;
+        #pragma omp parallel for schedule(static) if((n - j - 1) * width >= LU_PAR_MIN)
+        for (size_t i0 = j + 1; i0 < n; i0 += LU_PAR_ROWS) {
+            LU_GER(
+                min_size(LU_PAR_ROWS, n - i0), width, -1,
+                &a[i0 * lda + j], lda,
+                &prow[j + 1],
+                &a[i0 * lda + j + 1], lda
+            );
+        }
+    }
+    return 0;
+}
+
+// Solves L * X = B in place for the unit lower triangular nb x nb block
+// L, X being nb x nrhs. Columns of X are independent, so each thread
+// takes a strip of them.
+static void LU_FN(lu_solve_unit_block)(
+    const LU_T *l, size_t ldl, size_t nb,
+    LU_T *x, size_t ldx, size_t nrhs
+) {
+    #pragma omp parallel for schedule(static) if(nb * nrhs >= LU_PAR_MIN)
+    for (size_t j0 = 0; j0 < nrhs; j0 += LU_PAR_COLS) {
+        size_t w = min_size(LU_PAR_COLS, nrhs - j0);
+        for (size_t i = 1; i < nb; i++) {
+            LU_T *xrow = &x[i * ldx + j0];
+            for (size_t k = 0; k < i; k++) {
+                LU_AXPY(w, -l[i * ldl + k], &x[k * ldx + j0], xrow);
+            }
+        }
+    }
+}
+
+// Right-looking blocked LU: factor a panel, solve for the block row of U,
+// then push the rank-jb update into the trailing matrix through GEMM
+static int LU_FN(lu_factor_blocked)(LU_T *a, size_t lda, size_t n, size_t *piv) {
+    for (size_t j0 = 0; j0 < n; j0 += LU_NB) {
+        size_t jb = min_size(LU_NB, n - j0);
+        if (LU_FN(lu_factor_panel)(a, lda, n, j0, jb, piv) != 0) {
+            return -1;
+        }
+
+        size_t j1 = j0 + jb;
+        if (j1 == n) {
+            break;
+        }
+
+        // U12 = L11^-1 * A12
+        LU_FN(lu_solve_unit_block)(
+            &a[j0 * lda + j0], lda, jb,
+            &a[j0 * lda + j1], lda, n - j1
+        );
+
+        // A22 -= L21 * U12
+        LU_GEMM(
+            n - j1, n - j1, jb,
+            -1, &a[j1 * lda + j0], lda, 1,
+            &a[j0 * lda + j1], lda, 1,
+            1, &a[j1 * lda + j1], lda, 1
+        );
+    }
+    return 0;
+}
+
+// Solves L * X = B in place for unit lower triangular L
+static void LU_FN(lu_solve_lower)(
+    const LU_T *l, size_t ldl, size_t n,
+    LU_T *x, size_t ldx, size_t nrhs
+) {
+    for (size_t i0 = 0; i0 < n; i0 += LU_NB) {
+        size_t ib = min_size(LU_NB, n - i0);
+        LU_FN(lu_solve_unit_block)(&l[i0 * ldl + i0], ldl, ib, &x[i0 * ldx], ldx, nrhs);
+        if (i0 + ib < n) {
+            LU_GEMM(
+                n - i0 - ib, nrhs, ib,
+                -1, &l[(i0 + ib) * ldl + i0], ldl, 1,
+                &x[i0 * ldx], ldx, 1,
+                1, &x[(i0 + ib) * ldx], ldx, 1
+            );
+        }
+    }
+}
+
+// Solves U * X = B in place for upper triangular U
+static void LU_FN(lu_solve_upper)(
+    const LU_T *u, size_t ldu, size_t n,
+    LU_T *x, size_t ldx, size_t nrhs
+) {
+    size_t nblocks = (n + LU_NB - 1) / LU_NB;
+    for (size_t blk = nblocks; blk-- > 0;) {
+        size_t i0 = blk * LU_NB;
+        size_t ib = min_size(LU_NB, n - i0);
+        // Columns of X are independent: a strip of them per thread
+        #pragma omp parallel for schedule(static) if(ib * nrhs >= LU_PAR_MIN)
+        for (size_t j0 = 0; j0 < nrhs; j0 += LU_PAR_COLS) {
+            size_t w = min_size(LU_PAR_COLS, nrhs - j0);
+            for (size_t i = i0 + ib; i-- > i0;) {
+                LU_T *xrow = &x[i * ldx + j0];
+                for (size_t k = i + 1; k < i0 + ib; k++) {
+                    LU_AXPY(w, -u[i * ldu + k], &x[k * ldx + j0], xrow);
+                }
+                LU_SCALE(w, 1 / u[i * ldu + i], xrow);
+            }
+        }
+        if (i0 > 0) {
+            LU_GEMM(
+                i0, nrhs, ib,
+                -1, &u[i0], ldu, 1,
+                &x[i0 * ldx], ldx, 1,
+                1, x, ldx, 1
+            );
+        }
+    }
+}
+
+// Applies the row exchanges of P to X, then solves L * U * X = P * X in
+// place
+static void LU_FN(lu_solve_piv)(
+    const LU_T *a, size_t lda, size_t n, const size_t *piv,
+    LU_T *x, size_t ldx, size_t nrhs
+) {
+    for (size_t i = 0; i < n; i++) {
+        LU_FN(swap_rows)(x, ldx, nrhs, i, piv[i]);
+    }
+    LU_FN(lu_solve_lower)(a, lda, n, x, ldx, nrhs);
+    LU_FN(lu_solve_upper)(a, lda, n, x, ldx, nrhs);
+}
+
+#undef LU_T
+#undef LU_FN
+#undef LU_GEMM
+#undef LU_FABS
+#undef LU_AXPY
+#undef LU_SCALE
+#undef LU_GER
@@ -0,0 +1,223 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+// The block format ends in at least 5 literals, and the last match
+// starts at least 12 bytes before the end
+#define LZ_LAST_LITERALS 5
+#define LZ_MF_LIMIT 12
+#define LZ_MAX_OFFSET 65535
+// Misses in a row before the scan starts skipping ahead
+#define LZ_SKIP_SHIFT 6
+
+static uint32_t lz_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t lz_read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static size_t lz_match_length(const uint8_t *ip, const uint8_t *ref, const uint8_t *limit) {
+    size_t len = 0;
+    while (ip + len + 8 <= limit) {
+        uint64_t diff = lz_read64(ip + len) ^ lz_read64(ref + len);
+        if (diff != 0) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return len + __builtin_ctzll(diff) / 8;
+#else
+            return len + __builtin_clzll(diff) / 8;
+#endif
+        }
+        len += 8;
+    }
+    while (ip + len < limit && ip[len] == ref[len]) {
+        len++;
+    }
+    return len;
+}
+
+// Lengths of 15 and up continue in bytes of 255 and a remainder
+static uint8_t *lz_put_length(uint8_t *op, size_t len) {
+    for (len -= 15; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// Writes literals [anchor, ip) followed by a match of mlen at offset, or
+// no match when mlen == 0. Returns NULL when the output is full.
+static uint8_t *lz_put_sequence(
+    uint8_t *op, uint8_t *oend,
+    const uint8_t *anchor, const uint8_t *ip,
+    size_t offset, size_t mlen
+) {
+    size_t lit = ip - anchor;
+    size_t worst = 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1;
+    if (worst > (size_t)(oend - op)) {
+        return NULL;
+    }
+
+    uint8_t *token = op++;
+    *token = (uint8_t)((lit < 15 ? lit : 15) << 4);
+    if (lit >= 15) {
+        op = lz_put_length(op, lit);
+    }
+    memcpy(op, anchor, lit);
+    op += lit;
+    if (mlen == 0) {
+        return op;
+    }
+
+    *op++ = (uint8_t)(offset & 0xff);
+    *op++ = (uint8_t)(offset >> 8);
+    size_t ml = mlen - LZ_MIN_MATCH;
+    *token |= (uint8_t)(ml < 15 ? ml : 15);
+    if (ml >= 15) {
+        op = lz_put_length(op, ml);
+    }
+    return op;
+}
+
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap) {
+    const uint8_t *base = src;
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *iend = base + n;
+    uint8_t *op = dst;
+    uint8_t *oend = op + cap;
+
+    if (n > LZ_MF_LIMIT) {
+        uint32_t table[1 << LZ_HASH_BITS] = { 0 };
+        const uint8_t *mflimit = iend - LZ_MF_LIMIT;
+        const uint8_t *matchlimit = iend - LZ_LAST_LITERALS;
+        ip++;
+        while (ip < mflimit) {
+            uint32_t h = lz_hash(lz_read32(ip));
+            const uint8_t *ref = base + table[h];
+            table[h] = (uint32_t)(ip - base);
+            if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != lz_read32(ip)) {
+                ip += 1 + ((ip - anchor) >> LZ_SKIP_SHIFT);
+                continue;
+            }
+
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            size_t mlen = LZ_MIN_MATCH + lz_match_length(
+                ip + LZ_MIN_MATCH, ref + LZ_MIN_MATCH, matchlimit
+            );
+            op = lz_put_sequence(op, oend, anchor, ip, ip - ref, mlen);
+            if (op == NULL) {
+                return 0;
+            }
+            ip += mlen;
+            anchor = ip;
+        }
+    }
+
+    op = lz_put_sequence(op, oend, anchor, iend, 0, 0);
+    if (op == NULL) {
+        return 0;
+    }
+    return op - (uint8_t *)dst;
+}
+
+// Reads the continuation bytes of a length; SIZE_MAX on truncation
+static size_t lz_get_length(const uint8_t **ip, const uint8_t *iend, size_t len) {
+    uint8_t b;
+    do {
+        if (*ip >= iend) {
+            return SIZE_MAX;
+        }
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+int lz_decompress(const void *src, size_t csize, void *dst, size_t n) {
+    const uint8_t *ip = src;
+    const uint8_t *iend = ip + csize;
+    uint8_t *op = dst;
+    uint8_t *oend = op + n;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15 && (lit = lz_get_length(&ip, iend, lit)) == SIZE_MAX) {
+            return -1;
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (uint8_t *)dst)) {
+            return -1;
+        }
+        size_t mlen = token & 15;
+        if (mlen == 15 && (mlen = lz_get_length(&ip, iend, mlen)) == SIZE_MAX) {
+            return -1;
+        }
+        mlen += LZ_MIN_MATCH;
+        if (mlen > (size_t)(oend - op)) {
+            return -1;
+        }
+
+        const uint8_t *ref = op - offset;
+        if (offset >= mlen) {
+            memcpy(op, ref, mlen);
+            op += mlen;
+        } else {
+            // Overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < mlen; i++) {
+                *op++ = ref[i];
+            }
+        }
+    }
+    return op == oend ? 0 : -1;
+}
+
+void lz_shuffle8(const void *src, void *dst, size_t words) {
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+    for (size_t i = 0; i < words; i++) {
+        for (size_t b = 0; b < 8; b++) {
+            out[b * words + i] = in[i * 8 + b];
+        }
+    }
+}
+
+void lz_unshuffle8(const void *src, void *dst, size_t words) {
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+    for (size_t i = 0; i < words; i++) {
+        for (size_t b = 0; b < 8; b++) {
+            out[i * 8 + b] = in[b * words + i];
+        }
+    }
+}
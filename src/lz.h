@@ -0,0 +1,26 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+
+// Byte-oriented LZ77 codec producing the LZ4 block format: greedy
+// matching through a hash of 4-byte sequences, no entropy stage. Fast
+// enough to sit on the I/O path in both directions.
+
+// Compressed size can exceed the input for incompressible data
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+// Returns the compressed size, or 0 if it would not fit in cap
+size_t lz_compress(const void *src, size_t n, void *dst, size_t cap);
+
+// Decodes exactly n bytes; fails on malformed or truncated input
+// without reading or writing out of bounds
+int lz_decompress(const void *src, size_t csize, void *dst, size_t n);
+
+// Groups byte k of every 8-byte word into plane k. Doubles of similar
+// magnitude share sign, exponent and high mantissa bytes, which then
+// form long runs the matcher finds.
+void lz_shuffle8(const void *src, void *dst, size_t words);
+void lz_unshuffle8(const void *src, void *dst, size_t words);
+
+#endif
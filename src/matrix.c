@@ -4,29 +4,208 @@
 #include <string.h>
 #include <math.h>
 
+#include <sys/mman.h>
+
 #include "libmatrix/matrix.h"
 
+#include "arena.h"
+#include "gemm.h"
+#include "kernels.h"
+#include "matrix_internal.h"
+#include "rng.h"
+#include "small.h"
+#include "transpose.h"
+
 #define EPS 1e-6
 #define MAX_MATRIX_SIZE 1000000
 
-struct mat2d {
-    double *data;
-    size_t rows, cols;
-};
+// Elementwise fills and compares below this many elements stay on the
+// calling thread
+#define MAT2D_PAR_MIN (1 << 16)
+// Elements per work item when a dense buffer is split between threads
+#define MAT2D_PAR_CHUNK 8192
 
-struct mat2d* mat2d_create(size_t rows, size_t cols) {
-    struct mat2d* mat = calloc(sizeof(struct mat2d) + sizeof(double) * rows * cols, 1);
+#define MAT2D_ALIGN 64
+#define MAT2D_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+static size_t round_up(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// Rows start on a cache line, and a leading dimension that is a multiple
+// of 512 bytes is bumped by one line so that walking a column does not
+// keep hitting the same few cache sets
+static size_t mat2d_padded_ld(size_t cols) {
+    size_t ld = round_up(cols, MAT2D_ALIGN / sizeof(double));
+    if (ld > 0 && ld % 64 == 0) {
+        ld += MAT2D_ALIGN / sizeof(double);
+    }
+    return ld;
+}
+
+struct mat2d* mat2d_create_ex(size_t rows, size_t cols, size_t ld, unsigned flags) {
+    if (ld == 0) {
+        ld = (flags & MAT2D_ALLOC_PADDED) ? mat2d_padded_ld(cols) : cols;
+    }
+    assert(ld >= cols);
+
+    size_t align = (flags & MAT2D_ALLOC_HUGEPAGE) ? MAT2D_HUGEPAGE_SIZE : MAT2D_ALIGN;
+    size_t bytes = round_up(sizeof(double) * rows * ld, align);
+    if (bytes == 0) {
+        bytes = align;
+    }
+
+    struct mat2d* mat = malloc(sizeof(struct mat2d));
     assert(mat != NULL);
-    mat->data = (double*)(mat + 1);
+    void *storage = NULL;
+    if (posix_memalign(&storage, align, bytes) != 0) {
+        free(mat);
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & MAT2D_ALLOC_HUGEPAGE) {
+        // Advisory only: falls back to regular pages when THP is disabled
+        madvise(storage, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    memset(storage, 0, bytes);
+
+    mat->data = storage;
     mat->rows = rows;
     mat->cols = cols;
+    mat->rs = ld;
+    mat->cs = 1;
+    mat->storage = storage;
+    mat->storage_size = bytes;
+    mat->in_arena = false;
+    mat->mapped = false;
     return mat;
 }
 
+struct mat2d* mat2d_create_in(
+    struct mat2d_arena *arena,
+    size_t rows, size_t cols,
+    unsigned flags
+) {
+    size_t ld = (flags & MAT2D_ALLOC_PADDED) ? mat2d_padded_ld(cols) : cols;
+    struct mat2d *mat = mat2d_arena_alloc(arena, sizeof(struct mat2d));
+    double *data = mat2d_arena_alloc(arena, sizeof(double) * rows * ld);
+    if (mat == NULL || data == NULL) {
+        return NULL;
+    }
+    mat->data = data;
+    mat->rows = rows;
+    mat->cols = cols;
+    mat->rs = ld;
+    mat->cs = 1;
+    mat->storage = NULL;
+    mat->storage_size = 0;
+    mat->in_arena = true;
+    mat->mapped = false;
+    return mat;
+}
+
+struct mat2d* mat2d_create(size_t rows, size_t cols) {
+    struct mat2d* mat = mat2d_create_ex(rows, cols, 0, MAT2D_ALLOC_DENSE);
+    assert(mat != NULL);
+    return mat;
+}
+
+// Header-only matrix aliasing someone else's storage; freed by mat2d_destroy
+static struct mat2d *mat2d_alias(
+    double *data,
+    size_t rows, size_t cols,
+    size_t rs, size_t cs
+) {
+    struct mat2d *view = malloc(sizeof(struct mat2d));
+    assert(view != NULL);
+    view->data = data;
+    view->rows = rows;
+    view->cols = cols;
+    view->rs = rs;
+    view->cs = cs;
+    view->storage = NULL;
+    view->storage_size = 0;
+    view->in_arena = false;
+    view->mapped = false;
+    return view;
+}
+
+struct mat2d* mat2d_view(
+    struct mat2d *mat,
+    size_t row, size_t col,
+    size_t rows, size_t cols
+) {
+    assert(row + rows <= mat->rows);
+    assert(col + cols <= mat->cols);
+    return mat2d_alias(mat2d_at(mat, row, col), rows, cols, mat->rs, mat->cs);
+}
+
+struct mat2d* mat2d_view_rows_step(struct mat2d *mat, size_t first_row, size_t step) {
+    assert(step > 0);
+    assert(first_row <= mat->rows);
+    size_t rows = (mat->rows - first_row + step - 1) / step;
+    double *data = rows > 0 ? mat2d_at(mat, first_row, 0) : mat->data;
+    return mat2d_alias(data, rows, mat->cols, mat->rs * step, mat->cs);
+}
+
+struct mat2d* mat2d_view_row(struct mat2d *mat, size_t row) {
+    return mat2d_view(mat, row, 0, 1, mat->cols);
+}
+
+struct mat2d* mat2d_view_col(struct mat2d *mat, size_t col) {
+    return mat2d_view(mat, 0, col, mat->rows, 1);
+}
+
+struct mat2d* mat2d_view_T(struct mat2d *mat) {
+    return mat2d_alias(mat->data, mat->cols, mat->rows, mat->cs, mat->rs);
+}
+
+bool mat2d_is_contiguous(struct mat2d *mat) {
+    return mat2d_dense(mat);
+}
+
+int mat2d_copy(struct mat2d *dst, struct mat2d *src) {
+    assert(dst->rows == src->rows && dst->cols == src->cols);
+
+    if (mat2d_dense(dst) && mat2d_dense(src)) {
+        memmove(dst->data, src->data, sizeof(double) * src->rows * src->cols);
+        return 0;
+    }
+    if (!mat2d_overlaps(dst, src)) {
+        // Opposite storage orders: one side is the transpose of a
+        // row-major block
+        if (dst->cs == 1 && src->rs == 1 && src->cs != 1) {
+            transpose_d(src->cols, src->rows, src->data, src->cs, dst->data, dst->rs);
+            return 0;
+        }
+        if (src->cs == 1 && dst->rs == 1 && dst->cs != 1) {
+            transpose_d(src->rows, src->cols, src->data, src->rs, dst->data, dst->cs);
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < src->rows; i++) {
+        double *drow = mat2d_at(dst, i, 0);
+        const double *srow = mat2d_at(src, i, 0);
+        if (dst->cs == 1 && src->cs == 1) {
+            memmove(drow, srow, sizeof(double) * src->cols);
+        } else {
+            for (size_t j = 0; j < src->cols; j++) {
+                drow[j * dst->cs] = srow[j * src->cs];
+            }
+        }
+    }
+    return 0;
+}
+
 int mat2d_clone(mat2d **out, mat2d *in) {
     struct mat2d* result = mat2d_create(in->rows, in->cols);
     assert(result != NULL);
-    memcpy(result->data, in->data, sizeof(double) * in->rows * in->cols);
+    mat2d_copy(result, in);
     *out = result;
     return 0;
 }
@@ -37,86 +216,223 @@ struct range2d {
 };
 
 int mat2d_make_submatrix(struct mat2d** outmat, struct mat2d* inmat, struct range2d range) {
-    struct mat2d* out = mat2d_create(range.rows, range.cols);
-    assert(out!= NULL);
-
-    assert(range.start_row + range.rows <= inmat->rows);
-    assert(range.start_col + range.cols <= inmat->cols);
-    for (size_t i = range.start_row, j = 0; j < range.rows; i++, j++) {
-        memcpy(
-            &out->data[j * range.cols], 
-            &inmat->data[i * inmat->cols + range.start_col], 
-            sizeof(double) * range.cols
-        );
-    }
-
-    *outmat = out;
+    *outmat = mat2d_view(
+        inmat,
+        range.start_row, range.start_col,
+        range.rows, range.cols
+    );
     return 0;
 }
 
-bool mat2d_eq(struct mat2d* left, struct mat2d* right) {
-    assert(left != NULL && right != NULL);
-    assert(left->rows == right->rows && right->cols == right->cols);
+// Compares work item s of a pair: a chunk of the flat buffers when both
+// are dense, row s otherwise. With max NULL it stops at the first
+// difference above eps; otherwise it folds the row's largest difference
+// into *max.
+static bool mat2d_span_close(
+    struct mat2d *left, struct mat2d *right,
+    bool dense, size_t s,
+    double eps, double *max
+) {
+    const double *x, *y;
+    size_t n, incx, incy;
+    if (dense) {
+        size_t total = left->rows * left->cols;
+        x = &left->data[s * MAT2D_PAR_CHUNK];
+        y = &right->data[s * MAT2D_PAR_CHUNK];
+        n = min_size(MAT2D_PAR_CHUNK, total - s * MAT2D_PAR_CHUNK);
+        incx = incy = 1;
+    } else {
+        x = mat2d_at(left, s, 0);
+        y = mat2d_at(right, s, 0);
+        n = left->cols;
+        incx = left->cs;
+        incy = right->cs;
+    }
 
-    for (size_t i = 0; i < left->rows; i++) {
-        for (size_t j = 0; j < left->cols; j++) {
-            if (fabs(mat2d_get(left, i, j) - mat2d_get(right, i, j)) > EPS) {
+    if (incx == 1 && incy == 1) {
+        if (max == NULL) {
+            return kern_close(n, x, y, eps);
+        }
+        double d = kern_max_diff(n, x, y);
+        if (d > *max) {
+            *max = d;
+        }
+        return d <= eps;
+    }
+    bool close = true;
+    for (size_t j = 0; j < n; j++) {
+        double d = fabs(x[j * incx] - y[j * incy]);
+        if (d > eps) {
+            if (max == NULL) {
                 return false;
             }
+            close = false;
+        }
+        if (max != NULL && d > *max) {
+            *max = d;
         }
     }
-    return true;
+    return close;
 }
 
-int mat2d_inv(struct mat2d** out, struct mat2d* in) {
-    mat2d* tmp = NULL;
-    mat2d_clone(&tmp, in);
+// |left - right| <= eps elementwise; NaN differences count as close.
+// With max_diff NULL the comparison stops as soon as one element fails,
+// otherwise it scans everything and stores the largest difference.
+bool mat2d_eq_ex(struct mat2d *left, struct mat2d *right, double eps, double *max_diff) {
+    assert(left != NULL && right != NULL);
+    assert(left->rows == right->rows && left->cols == right->cols);
+
+    size_t total = left->rows * left->cols;
+    bool dense = mat2d_dense(left) && mat2d_dense(right);
+    size_t spans = dense ? (total + MAT2D_PAR_CHUNK - 1) / MAT2D_PAR_CHUNK : left->rows;
+
+    bool far = false;
+    double max = 0.0;
+    #pragma omp parallel for schedule(dynamic) reduction(max:max) if(total >= MAT2D_PAR_MIN)
+    for (size_t s = 0; s < spans; s++) {
+        if (max_diff == NULL && __atomic_load_n(&far, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        double span_max = 0.0;
+        if (!mat2d_span_close(left, right, dense, s, eps, max_diff != NULL ? &span_max : NULL)) {
+            __atomic_store_n(&far, true, __ATOMIC_RELAXED);
+        }
+        if (span_max > max) {
+            max = span_max;
+        }
+    }
+
+    if (max_diff != NULL) {
+        *max_diff = max;
+    }
+    return !far;
+}
 
-    mat2d* inverse = mat2d_create(in->rows, in->rows);
-    mat2d_fill_eye(inverse);
+bool mat2d_eq(struct mat2d* left, struct mat2d* right) {
+    return mat2d_eq_ex(left, right, EPS, NULL);
+}
+
+// Conservative: compares the address ranges spanned by both matrices
+bool mat2d_overlaps(struct mat2d *a, struct mat2d *b) {
+    if (a->rows == 0 || a->cols == 0 || b->rows == 0 || b->cols == 0) {
+        return false;
+    }
+    const double *a_last = mat2d_at(a, a->rows - 1, a->cols - 1);
+    const double *b_last = mat2d_at(b, b->rows - 1, b->cols - 1);
+    return a->data <= b_last && b->data <= a_last;
+}
 
-    size_t n = in->rows;
-    for (size_t i = 0; i < n; i++) {
-        double diag = mat2d_get(tmp, i, i);
-        if (diag < EPS && diag > -EPS) {
+static bool mat2d_same_layout(const struct mat2d *a, const struct mat2d *b) {
+    return a->data == b->data && a->rs == b->rs && a->cs == b->cs;
+}
+
+int mat2d_T_into(struct mat2d *out, struct mat2d *in) {
+    assert(out->rows == in->cols && out->cols == in->rows);
+
+    if (in->rows == in->cols && mat2d_same_layout(out, in)) {
+        // Square and in place: swap across the diagonal
+        if (in->cs == 1) {
+            transpose_inplace_d(in->rows, in->data, in->rs);
             return 0;
         }
-        for (size_t j = 0; j < n; j++) {
-            mat2d_set(tmp, i, j, mat2d_get(tmp, i, j) / diag);
-            mat2d_set(inverse, i, j, mat2d_get(inverse, i, j) / diag);
+        if (in->rs == 1) {
+            transpose_inplace_d(in->rows, in->data, in->cs);
+            return 0;
         }
-
-        for (size_t k = 0; k < n; k++) {
-            if (k != i) {
-                double factor = mat2d_get(tmp, k, i);
-                for (size_t j = 0; j < n; j++) {
-                    double tmp1 = mat2d_get(tmp, k, j) - factor * mat2d_get(tmp, i, j);
-                    mat2d_set(tmp, k, j, tmp1);
-                    double tmp2 = mat2d_get(inverse, k, j) - factor * mat2d_get(inverse, i, j);
-                    mat2d_set(inverse, k, j, tmp2);
-                }
+        for (size_t i = 0; i < in->rows; i++) {
+            for (size_t j = i + 1; j < in->cols; j++) {
+                double *upper = mat2d_at(in, i, j);
+                double *lower = mat2d_at(in, j, i);
+                double tmp = *upper;
+                *upper = *lower;
+                *lower = tmp;
             }
         }
+        return 0;
+    }
+    if (mat2d_overlaps(out, in)) {
+        return -1;
     }
 
-    mat2d_destroy(tmp);
-    *out = inverse;
-    return 0;
+    struct mat2d in_t = *in;
+    in_t.rows = in->cols;
+    in_t.cols = in->rows;
+    in_t.rs = in->cs;
+    in_t.cs = in->rs;
+    return mat2d_copy(out, &in_t);
 }
 
 int mat2d_T(struct mat2d** out, struct mat2d* in) {
-    struct mat2d* tmp = mat2d_create(in->rows, in->cols);
+    struct mat2d* tmp = mat2d_create(in->cols, in->rows);
     if (tmp == NULL) {
         return -1;
     }
 
-    for (size_t i = 0; i < in->rows; i++) {
-        for (size_t j = 0; j < in->cols; i++) {
-            mat2d_set(tmp, j, i, mat2d_get(in, i, j));
+    mat2d_T_into(tmp, in);
+
+    *out = tmp;
+    return 0;
+}
+
+// out = alpha * left * right + beta * out. out may alias either operand,
+// in which case the product is staged in scratch memory.
+int mat2d_dot_into(
+    struct mat2d *out,
+    struct mat2d *left, struct mat2d *right,
+    double alpha, double beta
+) {
+    assert(left->cols == right->rows);
+    assert(out->rows == left->rows && out->cols == right->cols);
+
+    // Small square products: unrolled kernel, aliasing is harmless
+    size_t n = left->rows;
+    if (n >= 2 && n <= SMALL_DOT_MAX && left->cols == n && right->cols == n
+        && right->cs == 1 && out->cs == 1) {
+        small_dot(
+            n, alpha, left->data, left->rs, left->cs,
+            right->data, right->rs,
+            beta, out->data, out->rs
+        );
+        return 0;
+    }
+
+    // Matrix-vector with a contiguous vector: one dot product per row,
+    // no packing
+    if (right->cols == 1 && right->rs == 1 && left->cs == 1
+        && !mat2d_overlaps(out, left) && !mat2d_overlaps(out, right)) {
+        for (size_t i = 0; i < left->rows; i++) {
+            double *yi = mat2d_at(out, i, 0);
+            double dot = kern_dot(left->cols, mat2d_at(left, i, 0), right->data);
+            *yi = beta == 0.0 ? alpha * dot : alpha * dot + beta * *yi;
         }
+        return 0;
     }
 
-    *out = tmp;
+    if (!mat2d_overlaps(out, left) && !mat2d_overlaps(out, right)) {
+        gemm_dgemm(
+            left->rows, right->cols, left->cols,
+            alpha, left->data, left->rs, left->cs,
+            right->data, right->rs, right->cs,
+            beta, out->data, out->rs, out->cs
+        );
+        return 0;
+    }
+
+    mat2d_arena *scratch = arena_scratch();
+    mat2d_arena_begin(scratch);
+    struct mat2d *tmp = mat2d_create_in(scratch, out->rows, out->cols, MAT2D_ALLOC_DENSE);
+    assert(tmp != NULL);
+    if (beta != 0.0) {
+        mat2d_copy(tmp, out);
+    }
+    gemm_dgemm(
+        left->rows, right->cols, left->cols,
+        alpha, left->data, left->rs, left->cs,
+        right->data, right->rs, right->cs,
+        beta, tmp->data, tmp->rs, tmp->cs
+    );
+    mat2d_copy(out, tmp);
+    mat2d_arena_end(scratch);
     return 0;
 }
 
@@ -126,22 +442,15 @@ int mat2d_dot(struct mat2d **out, struct mat2d* left, struct mat2d* right) {
     mat2d* result = mat2d_create(left->rows, right->cols);
     assert(result != NULL);
 
-    for (size_t i = 0; i < left->rows; i++) {
-        for (size_t j = 0; j < right->cols; j++) {
-            double acc = 0.0;
-            for (size_t k = 0; k < left->cols; ++k) {
-                acc += mat2d_get(left, i, k) * mat2d_get(right, k, j);
-            }
-            mat2d_set(result, i, j, acc);
-        }
-    }
+    mat2d_dot_into(result, left, right, 1.0, 0.0);
 
     *out = result;
     return 0;
 }
 
+// Bytes owned by the matrix, including row padding and alignment slack
 size_t mat2d_get_size(mat2d *mat) {
-    return sizeof(struct mat2d) + sizeof(double) * mat->rows * mat->cols;
+    return sizeof(struct mat2d) + mat->storage_size;
 }
 
 size_t mat2d_get_cols(mat2d *mat) {
@@ -152,6 +461,11 @@ size_t mat2d_get_rows(mat2d *mat) {
     return mat->rows;
 }
 
+size_t mat2d_get_ld(mat2d *mat) {
+    assert(mat->cs == 1);
+    return mat->rs;
+}
+
 double* mat2d_get_data(mat2d *mat) {
     return mat->data;
 }
@@ -159,30 +473,42 @@ double* mat2d_get_data(mat2d *mat) {
 double mat2d_get(struct mat2d *mat, size_t indx1, size_t indx2) {
     assert(indx1 < mat->rows);
     assert(indx2 < mat->cols);
-    return mat->data[indx1 * mat->cols + indx2];
+    return *mat2d_at(mat, indx1, indx2);
 }
 
 double* mat2d_get_row_ref(mat2d *mat, size_t row) {
     assert(row < mat->rows);
-    return (double*)&mat->data[row * mat->cols];
+    assert(mat->cs == 1);
+    return mat2d_at(mat, row, 0);
 }
 
 double* mat2d_get_row_cloned(mat2d *mat, size_t row) {
     assert(row < mat->rows);
-    size_t row_size = sizeof(double) * mat->cols;
-    double *tmp = malloc(row_size);
-    memcpy(tmp, &mat->data[row * mat->cols], row_size);
+    double *tmp = malloc(sizeof(double) * mat->cols);
+    const double *src = mat2d_at(mat, row, 0);
+    for (size_t j = 0; j < mat->cols; j++) {
+        tmp[j] = src[j * mat->cs];
+    }
     return tmp;
 }
 
 void mat2d_set(struct mat2d *mat, size_t indx1, size_t indx2, double value) {
     assert(indx1 < mat->rows);
     assert(indx2 < mat->cols);
-    mat->data[indx1 * mat->cols + indx2] = value;
+    *mat2d_at(mat, indx1, indx2) = value;
 }
 
-// mat maybe null
+// mat maybe null. For views only the header is released, the parent's
+// storage is untouched.
 void mat2d_destroy(struct mat2d *mat) {
+    if (mat == NULL || mat->in_arena) {
+        return;
+    }
+    if (mat->mapped) {
+        munmap(mat->storage, mat->storage_size);
+    } else {
+        free(mat->storage);
+    }
     free(mat);
 }
 
@@ -200,19 +526,62 @@ void mat2d_debug_console(mat2d *mat) {
     mat2d_debug(mat, stdout);
 }
 
-void mat2d_fill_random(struct mat2d *mat) {
-    for (size_t i = 0; i < mat->rows; i++) {
-        for (size_t j = 0; j < mat->cols; j++) {
-            mat2d_set(mat, i, j, (double)random() / RAND_MAX);
+// Element (i, j) takes value i * cols + j of the seed's stream, so the
+// result depends only on the seed and the shape: not on the storage
+// layout, and not on how many threads share the work
+void mat2d_fill_random_seeded(struct mat2d *mat, uint64_t seed) {
+    size_t total = mat->rows * mat->cols;
+    if (mat2d_dense(mat)) {
+        size_t chunks = (total + MAT2D_PAR_CHUNK - 1) / MAT2D_PAR_CHUNK;
+        #pragma omp parallel for schedule(static) if(total >= MAT2D_PAR_MIN)
+        for (size_t c = 0; c < chunks; c++) {
+            size_t first = c * MAT2D_PAR_CHUNK;
+            rng_uniform(seed, first, min_size(MAT2D_PAR_CHUNK, total - first), &mat->data[first]);
+        }
+        return;
+    }
+
+    #pragma omp parallel if(total >= MAT2D_PAR_MIN)
+    {
+        // Strided rows are generated contiguously, then scattered
+        mat2d_arena *scratch = NULL;
+        double *tmp = NULL;
+        if (mat->cs != 1) {
+            scratch = arena_scratch();
+            mat2d_arena_begin(scratch);
+            tmp = mat2d_arena_alloc(scratch, sizeof(double) * mat->cols);
+            assert(tmp != NULL);
+        }
+
+        #pragma omp for schedule(static)
+        for (size_t i = 0; i < mat->rows; i++) {
+            double *row = mat2d_at(mat, i, 0);
+            if (mat->cs == 1) {
+                rng_uniform(seed, i * mat->cols, mat->cols, row);
+                continue;
+            }
+            rng_uniform(seed, i * mat->cols, mat->cols, tmp);
+            for (size_t j = 0; j < mat->cols; j++) {
+                row[j * mat->cs] = tmp[j];
+            }
+        }
+
+        if (scratch != NULL) {
+            mat2d_arena_end(scratch);
         }
     }
 }
 
+// Seeded from random(), so srandom() still makes runs repeatable
+void mat2d_fill_random(struct mat2d *mat) {
+    uint64_t seed = (uint64_t)random() << 32 ^ (uint64_t)random();
+    mat2d_fill_random_seeded(mat, seed);
+}
+
 void mat2d_fill_eye(struct mat2d *mat) {
-    for (size_t i = 0; i < mat->rows; i++) {
-        for (size_t j = 0; j < mat->cols; j++) {
-            mat2d_set(mat, i, j, i == j ? 1.0 : 0.0);
-        }
+    mat2d_fill_value(mat, 0.0);
+    for (size_t i = 0; i < mat->rows && i < mat->cols; i++) {
+        *mat2d_at(mat, i, i) = 1.0;
     }
 }
 
@@ -225,134 +594,25 @@ void mat2d_fill_one(struct mat2d *mat) {
 }
 
 void mat2d_fill_value(struct mat2d *mat, double value) {
-    for (size_t i = 0; i < mat->rows; i++) {
-        for (size_t j = 0; j < mat->cols; j++) {
-            mat2d_set(mat, i, j, value);
-        }
-    }
-}
-
-int mat2d_read_from_file(mat2d **out, const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        return -1;
-    }
-
-    size_t rows = 0, cols = 0;
-    char line[1024];
-
-    while (fgets(line, sizeof(line), file)) {
-        if (rows == 0) {
-            char *token = strtok(line, ",");
-            while (token) {
-                cols++;
-                token = strtok(NULL, ",");
-            }
-        }
-        rows++;
-    }
-
-    struct mat2d *mat = mat2d_create(rows, cols);
-    if (mat == NULL) {
-        perror("Memory allocation failed");
-        fclose(file);
-        exit(EXIT_FAILURE);
-    }
-
-    rewind(file);
-
-    size_t row_index = 0;
-    double *data = mat->data;
-    while (fgets(line, sizeof(line), file)) {
-        char *token = strtok(line, ",");
-        size_t col_index = 0;
-        while (token) {
-            data[row_index * cols + col_index] = atof(token);
-            token = strtok(NULL, ",");
-            col_index++;
+    size_t total = mat->rows * mat->cols;
+    if (mat2d_dense(mat)) {
+        size_t chunks = (total + MAT2D_PAR_CHUNK - 1) / MAT2D_PAR_CHUNK;
+        #pragma omp parallel for schedule(static) if(total >= MAT2D_PAR_MIN)
+        for (size_t c = 0; c < chunks; c++) {
+            size_t first = c * MAT2D_PAR_CHUNK;
+            kern_fill(min_size(MAT2D_PAR_CHUNK, total - first), value, &mat->data[first]);
         }
-        row_index++;
-    }
-
-    fclose(file);
-
-    *out = mat;
-    return 0;
-}
-
-int mat2d_write_to_text_file(const struct mat2d *mat, const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        perror("Failed to open file");
-        return -1;
+        return;
     }
-
+    #pragma omp parallel for schedule(static) if(total >= MAT2D_PAR_MIN)
     for (size_t i = 0; i < mat->rows; i++) {
+        double *row = mat2d_at(mat, i, 0);
+        if (mat->cs == 1) {
+            kern_fill(mat->cols, value, row);
+            continue;
+        }
         for (size_t j = 0; j < mat->cols; j++) {
-            fprintf(file, "%8.3f", mat->data[i * mat->cols + j]);
-            if (j < mat->cols - 1) {
-                fprintf(file, " ");
-            }
+            row[j * mat->cs] = value;
         }
-        fprintf(file, "\n");
-    }
-
-    fclose(file);
-    return 0;
-}
-
-int mat2d_read_from_binfile(struct mat2d **out, const char *filename) {
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        return -1;
     }
-
-    size_t rows, cols;
-    if (fread(&rows, sizeof(size_t), 1, file) != 1 || 
-        fread(&cols, sizeof(size_t), 1, file) != 1) {
-        fclose(file);
-        return -1;
-    }
-
-    struct mat2d *mat = mat2d_create(rows, cols);
-    if (mat == NULL) {
-        perror("Memory allocation failed");
-        fclose(file);
-        exit(EXIT_FAILURE);
-    }
-
-    size_t elements = rows * cols;
-    if (fread(mat->data, sizeof(double), elements, file) != elements) {
-        free(mat);
-        fclose(file);
-        return -1;
-    }
-
-    fclose(file);
-
-    *out = mat;
-    return 0;
-}
-
-int mat2d_write_to_binfile(const struct mat2d *mat, const char *filename) {
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        perror("Failed to open file");
-        return -1;
-    }
-
-    if (fwrite(&mat->rows, sizeof(size_t), 1, file) != 1 ||
-        fwrite(&mat->cols, sizeof(size_t), 1, file) != 1) {
-        perror("Error writing matrix dimensions");
-        fclose(file);
-        return -1;
-    }
-
-    size_t elements = mat->rows * mat->cols;
-    if (fwrite(mat->data, sizeof(double), elements, file) != elements) {
-        perror("Error writing matrix data");
-    }
-
-    fclose(file);
-    return 0;
 }
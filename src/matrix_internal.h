@@ -0,0 +1,44 @@
+#ifndef MATRIX_INTERNAL_H
+#define MATRIX_INTERNAL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "libmatrix/matrix.h"
+
+struct mat2d {
+    double *data;
+    size_t rows, cols;
+    // Element (i, j) lives at data[i * rs + j * cs]. Owning matrices are
+    // row-major (rs = cols, cs = 1); views carry the parent's strides
+    // and their data pointer is already offset into the parent's buffer.
+    size_t rs, cs;
+    // Owned buffer, NULL for views and arena matrices
+    void *storage;
+    size_t storage_size;
+    // Header and data belong to an arena scope
+    bool in_arena;
+    // storage is a file mapping, released with munmap
+    bool mapped;
+};
+
+// Single precision matrix. Always row-major with unit column stride; ld
+// is the row pitch in elements.
+struct mat2f {
+    float *data;
+    size_t rows, cols;
+    size_t ld;
+    // Owned buffer, NULL for arena matrices
+    void *storage;
+    bool in_arena;
+};
+
+static inline double *mat2d_at(const struct mat2d *mat, size_t i, size_t j) {
+    return &mat->data[i * mat->rs + j * mat->cs];
+}
+
+static inline bool mat2d_dense(const struct mat2d *mat) {
+    return mat->cs == 1 && (mat->rs == mat->cols || mat->rows <= 1);
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include <sys/mman.h>
+
+#include "libmatrix/matrix.h"
+
+#include "gemm.h"
+#include "matrix_internal.h"
+
+#define MAT2F_ALIGN 64
+#define MAT2F_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+static size_t round_up(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+// Same policy as mat2d: cache-line rows, away from 512-byte pitches
+static size_t mat2f_padded_ld(size_t cols) {
+    size_t ld = round_up(cols, MAT2F_ALIGN / sizeof(float));
+    if (ld > 0 && ld % 128 == 0) {
+        ld += MAT2F_ALIGN / sizeof(float);
+    }
+    return ld;
+}
+
+struct mat2f* mat2f_create_ex(size_t rows, size_t cols, size_t ld, unsigned flags) {
+    if (ld == 0) {
+        ld = (flags & MAT2D_ALLOC_PADDED) ? mat2f_padded_ld(cols) : cols;
+    }
+    assert(ld >= cols);
+
+    size_t align = (flags & MAT2D_ALLOC_HUGEPAGE) ? MAT2F_HUGEPAGE_SIZE : MAT2F_ALIGN;
+    size_t bytes = round_up(sizeof(float) * rows * ld, align);
+    if (bytes == 0) {
+        bytes = align;
+    }
+
+    struct mat2f *mat = malloc(sizeof(struct mat2f));
+    assert(mat != NULL);
+    void *storage = NULL;
+    if (posix_memalign(&storage, align, bytes) != 0) {
+        free(mat);
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & MAT2D_ALLOC_HUGEPAGE) {
+        madvise(storage, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    memset(storage, 0, bytes);
+
+    mat->data = storage;
+    mat->rows = rows;
+    mat->cols = cols;
+    mat->ld = ld;
+    mat->storage = storage;
+    mat->in_arena = false;
+    return mat;
+}
+
+struct mat2f* mat2f_create(size_t rows, size_t cols) {
+    struct mat2f *mat = mat2f_create_ex(rows, cols, 0, MAT2D_ALLOC_DENSE);
+    assert(mat != NULL);
+    return mat;
+}
+
+struct mat2f* mat2f_create_in(
+    struct mat2d_arena *arena,
+    size_t rows, size_t cols,
+    unsigned flags
+) {
+    size_t ld = (flags & MAT2D_ALLOC_PADDED) ? mat2f_padded_ld(cols) : cols;
+    struct mat2f *mat = mat2d_arena_alloc(arena, sizeof(struct mat2f));
+    float *data = mat2d_arena_alloc(arena, sizeof(float) * rows * ld);
+    if (mat == NULL || data == NULL) {
+        return NULL;
+    }
+    mat->data = data;
+    mat->rows = rows;
+    mat->cols = cols;
+    mat->ld = ld;
+    mat->storage = NULL;
+    mat->in_arena = true;
+    return mat;
+}
+
+// mat maybe null
+void mat2f_destroy(struct mat2f *mat) {
+    if (mat == NULL || mat->in_arena) {
+        return;
+    }
+    free(mat->storage);
+    free(mat);
+}
+
+size_t mat2f_get_rows(struct mat2f *mat) {
+    return mat->rows;
+}
+
+size_t mat2f_get_cols(struct mat2f *mat) {
+    return mat->cols;
+}
+
+size_t mat2f_get_ld(struct mat2f *mat) {
+    return mat->ld;
+}
+
+float* mat2f_get_data(struct mat2f *mat) {
+    return mat->data;
+}
+
+float mat2f_get(struct mat2f *mat, size_t i, size_t j) {
+    assert(i < mat->rows && j < mat->cols);
+    return mat->data[i * mat->ld + j];
+}
+
+void mat2f_set(struct mat2f *mat, size_t i, size_t j, float value) {
+    assert(i < mat->rows && j < mat->cols);
+    mat->data[i * mat->ld + j] = value;
+}
+
+// On overflow dst is left partially converted
+int mat2f_from_mat2d(struct mat2f *dst, struct mat2d *src) {
+    assert(dst->rows == src->rows && dst->cols == src->cols);
+
+    for (size_t i = 0; i < src->rows; i++) {
+        const double *srow = mat2d_at(src, i, 0);
+        float *drow = &dst->data[i * dst->ld];
+        double amax = 0.0;
+        if (src->cs == 1) {
+            for (size_t j = 0; j < src->cols; j++) {
+                amax = fmax(amax, fabs(srow[j]));
+                drow[j] = (float)srow[j];
+            }
+        } else {
+            for (size_t j = 0; j < src->cols; j++) {
+                double v = srow[j * src->cs];
+                amax = fmax(amax, fabs(v));
+                drow[j] = (float)v;
+            }
+        }
+        if (amax > FLT_MAX) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int mat2d_from_mat2f(struct mat2d *dst, struct mat2f *src) {
+    assert(dst->rows == src->rows && dst->cols == src->cols);
+
+    for (size_t i = 0; i < src->rows; i++) {
+        const float *srow = &src->data[i * src->ld];
+        double *drow = mat2d_at(dst, i, 0);
+        if (dst->cs == 1) {
+            for (size_t j = 0; j < src->cols; j++) {
+                drow[j] = srow[j];
+            }
+        } else {
+            for (size_t j = 0; j < src->cols; j++) {
+                drow[j * dst->cs] = srow[j];
+            }
+        }
+    }
+    return 0;
+}
+
+static bool mat2f_overlaps(const struct mat2f *a, const struct mat2f *b) {
+    if (a->rows == 0 || a->cols == 0 || b->rows == 0 || b->cols == 0) {
+        return false;
+    }
+    const float *a_last = &a->data[(a->rows - 1) * a->ld + a->cols - 1];
+    const float *b_last = &b->data[(b->rows - 1) * b->ld + b->cols - 1];
+    return a->data <= b_last && b->data <= a_last;
+}
+
+// out = alpha * left * right + beta * out; out must not overlap the
+// operands
+int mat2f_dot_into(
+    struct mat2f *out,
+    struct mat2f *left, struct mat2f *right,
+    float alpha, float beta
+) {
+    assert(left->cols == right->rows);
+    assert(out->rows == left->rows && out->cols == right->cols);
+    if (mat2f_overlaps(out, left) || mat2f_overlaps(out, right)) {
+        return -1;
+    }
+
+    gemm_sgemm(
+        left->rows, right->cols, left->cols,
+        alpha, left->data, left->ld, 1,
+        right->data, right->ld, 1,
+        beta, out->data, out->ld, 1
+    );
+    return 0;
+}
+
+int mat2f_dot(struct mat2f **out, struct mat2f *left, struct mat2f *right) {
+    struct mat2f *result = mat2f_create(left->rows, right->cols);
+    mat2f_dot_into(result, left, right, 1.0f, 0.0f);
+    *out = result;
+    return 0;
+}
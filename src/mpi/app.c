@@ -28,11 +28,6 @@ int mat2d_app_init(int argc, char **argv) {
     app.global_indx = global_indx;
     app.root_indx = 0;
 
-    if (global_size < 2) {
-        printf("Not enough global size\n");
-        return -1;
-    }
-
     printf("Hello from host %s[%d] %d of %d\n", name, nlen, global_indx, global_size);
 
     return 0;
@@ -1,18 +1,261 @@
-#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <mpi.h>
 
 #include "libmatrix/app.h"
 #include "libmatrix/matrix.h"
 #include "libmatrix/task.h"
 
-int mat2d_dot_mpi(struct mat2d **out, struct mat2d* left, struct mat2d* right) {
-    assert(mat2d_get_cols(left) == mat2d_get_rows(right));
-    assert((mat2d_app_get_size() - 1) % 4 == 0);
+#include "../gemm.h"
+#include "grid.h"
+
+#define DOT_DEFAULT_NB 64
+// Rows of C between polls of the broadcasts in flight
+#define SUMMA_CHUNK_ROWS 64
+
+struct mat2d_dot_task {
+    // Operands stay the caller's and are read on the root only; the
+    // product lands there on collect
+    struct mat2d *left, *right;
+    struct mat2d *result;
+    mat2d_grid *grid;
+    mat2d_dist *dleft, *dright, *dresult;
+};
+
+// Packs block column kb of left on its grid column and block row kb of
+// right on its grid row, and starts broadcasting both
+static void summa_start(
+    struct mat2d_dist *left,
+    struct mat2d_dist *right,
+    size_t kb,
+    double *apanel, double *bpanel,
+    MPI_Request *reqs
+) {
+    struct mat2d_grid *grid = left->grid;
+    size_t nb = left->nb;
+    size_t k0 = kb * nb;
+    size_t jb = left->cols - k0 < nb ? left->cols - k0 : nb;
+    size_t pc = grid_owner(k0, nb, grid->npcol);
+    size_t pr = grid_owner(k0, nb, grid->nprow);
+    size_t arows = mat2d_get_rows(left->local);
+    size_t bcols = mat2d_get_cols(right->local);
+
+    if (grid->mycol == pc) {
+        size_t c0 = grid_numroc(k0, nb, grid->mycol, grid->npcol);
+        for (size_t i = 0; i < arows; i++) {
+            const double *src = mat2d_get_row_ref(left->local, i) + c0;
+            for (size_t t = 0; t < jb; t++) {
+                apanel[i * jb + t] = src[t];
+            }
+        }
+    }
+    if (grid->myrow == pr) {
+        size_t r0 = grid_numroc(k0, nb, grid->myrow, grid->nprow);
+        for (size_t t = 0; t < jb; t++) {
+            const double *src = mat2d_get_row_ref(right->local, r0 + t);
+            for (size_t j = 0; j < bcols; j++) {
+                bpanel[t * bcols + j] = src[j];
+            }
+        }
+    }
+    MPI_Ibcast(apanel, arows * jb, MPI_DOUBLE, pc, grid->row_comm, &reqs[0]);
+    MPI_Ibcast(bpanel, jb * bcols, MPI_DOUBLE, pr, grid->col_comm, &reqs[1]);
+}
+
+// SUMMA: C = A B walking the inner dimension one block at a time. The
+// grid column holding block column kb of A sends it along the grid rows,
+// the grid row holding block row kb of B sends it along the grid
+// columns, and every process adds their product into its part of C.
+// Block kb + 1 is on the wire while block kb is multiplied.
+int mat2d_dist_dot(struct mat2d_dist *out, struct mat2d_dist *left, struct mat2d_dist *right) {
+    struct mat2d_grid *grid = left->grid;
+    size_t nb = left->nb;
+    if (right->grid != grid || out->grid != grid
+        || right->nb != nb || out->nb != nb
+        || left->cols != right->rows
+        || out->rows != left->rows || out->cols != right->cols
+        || out == left || out == right) {
+        return -1;
+    }
 
-    mat2d* result = mat2d_create(
-        mat2d_get_rows(left), 
-        mat2d_get_cols(right)
-    );
-    assert(result != NULL);
+    size_t arows = mat2d_get_rows(left->local);
+    size_t bcols = mat2d_get_cols(right->local);
+    double *apanel[2], *bpanel[2];
+    int rc = 0;
+    for (int i = 0; i < 2; i++) {
+        apanel[i] = malloc(sizeof(double) * (arows * nb + 1));
+        bpanel[i] = malloc(sizeof(double) * (nb * bcols + 1));
+        if (apanel[i] == NULL || bpanel[i] == NULL) {
+            rc = -1;
+        }
+    }
+    if (grid_agree(grid, rc) != 0) {
+        for (int i = 0; i < 2; i++) {
+            free(apanel[i]);
+            free(bpanel[i]);
+        }
+        return -1;
+    }
 
+    struct mat2d *c = out->local;
+    size_t ldc = mat2d_get_ld(c);
+    mat2d_fill_zero(c);
+
+    size_t kblocks = (left->cols + nb - 1) / nb;
+    MPI_Request reqs[2][2];
+    if (kblocks > 0) {
+        summa_start(left, right, 0, apanel[0], bpanel[0], reqs[0]);
+    }
+    for (size_t kb = 0; kb < kblocks; kb++) {
+        size_t cur = kb % 2;
+        size_t next = (kb + 1) % 2;
+        bool ahead = kb + 1 < kblocks;
+        if (ahead) {
+            summa_start(left, right, kb + 1, apanel[next], bpanel[next], reqs[next]);
+        }
+        MPI_Waitall(2, reqs[cur], MPI_STATUSES_IGNORE);
+
+        size_t jb = left->cols - kb * nb < nb ? left->cols - kb * nb : nb;
+        for (size_t i0 = 0; i0 < arows && bcols > 0; i0 += SUMMA_CHUNK_ROWS) {
+            size_t rows = arows - i0 < SUMMA_CHUNK_ROWS ? arows - i0 : SUMMA_CHUNK_ROWS;
+            gemm_dgemm(
+                rows, bcols, jb,
+                1.0, &apanel[cur][i0 * jb], jb, 1,
+                bpanel[cur], bcols, 1,
+                1.0, mat2d_get_data(c) + i0 * ldc, ldc, 1
+            );
+            if (ahead) {
+                int done;
+                MPI_Testall(2, reqs[next], &done, MPI_STATUSES_IGNORE);
+            }
+        }
+    }
+
+    for (int i = 0; i < 2; i++) {
+        free(apanel[i]);
+        free(bpanel[i]);
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+struct mat2d_dot_task* mat2d_app_create_dot_task() {
+    return calloc(1, sizeof(struct mat2d_dot_task));
+}
+
+static void dot_task_release(struct mat2d_dot_task *task) {
+    mat2d_dist_destroy(task->dresult);
+    mat2d_dist_destroy(task->dright);
+    mat2d_dist_destroy(task->dleft);
+    mat2d_grid_destroy(task->grid);
+    task->dresult = NULL;
+    task->dright = NULL;
+    task->dleft = NULL;
+    task->grid = NULL;
+}
+
+void mat2d_app_destroy_dot_task(struct mat2d_dot_task *task) {
+    if (task == NULL) {
+        return;
+    }
+    dot_task_release(task);
+    mat2d_destroy(task->result);
+    free(task);
+}
+
+void mat2d_app_set_dot_operands(
+    struct mat2d_dot_task *task,
+    struct mat2d *left,
+    struct mat2d *right
+) {
+    task->left = left;
+    task->right = right;
+}
+
+struct mat2d* mat2d_app_get_dot_result(struct mat2d_dot_task *task) {
+    return task->result;
+}
+
+// The root broadcasts both shapes, every rank joins the squarest grid
+// and receives its blocks of both operands
+int mad2d_app_distribute_dot(struct mat2d_dot_task *task, size_t nb) {
+    bool is_root = mat2d_app_get_rank() == mat2d_app_get_root_indx();
+    nb = nb > 0 ? nb : DOT_DEFAULT_NB;
+
+    // Rows and cols of left, then of right; zero when the root has none
+    uint64_t shape[4] = { 0, 0, 0, 0 };
+    if (is_root && task->left != NULL && task->right != NULL) {
+        shape[0] = mat2d_get_rows(task->left);
+        shape[1] = mat2d_get_cols(task->left);
+        shape[2] = mat2d_get_rows(task->right);
+        shape[3] = mat2d_get_cols(task->right);
+    }
+    MPI_Bcast(shape, 4, MPI_UINT64_T, mat2d_app_get_root_indx(), MPI_COMM_WORLD);
+    if (shape[0] == 0 || shape[1] == 0 || shape[3] == 0 || shape[1] != shape[2]) {
+        return -1;
+    }
+
+    dot_task_release(task);
+    task->grid = mat2d_grid_create(0, 0);
+    if (task->grid == NULL) {
+        return -1;
+    }
+    task->dleft = mat2d_dist_create(task->grid, shape[0], shape[1], nb);
+    task->dright = task->dleft != NULL
+        ? mat2d_dist_create(task->grid, shape[2], shape[3], nb) : NULL;
+    task->dresult = task->dright != NULL
+        ? mat2d_dist_create(task->grid, shape[0], shape[3], nb) : NULL;
+    if (task->dresult == NULL
+        || mat2d_dist_scatter(task->dleft, task->left) != 0
+        || mat2d_dist_scatter(task->dright, task->right) != 0) {
+        dot_task_release(task);
+        return -1;
+    }
+    return 0;
+}
+
+int mat2d_dot_MPI_summa(struct mat2d_dot_task *task) {
+    if (task->grid == NULL) {
+        return -1;
+    }
+    return mat2d_dist_dot(task->dresult, task->dleft, task->dright);
+}
+
+int mad2d_app_collect_dot(struct mat2d_dot_task *task) {
+    if (task->grid == NULL) {
+        return -1;
+    }
+    struct mat2d *result = NULL;
+    if (mat2d_dist_gather(&result, task->dresult) != 0) {
+        return -1;
+    }
+    mat2d_destroy(task->result);
+    task->result = result;
+    return 0;
+}
+
+int mat2d_dot_mpi(struct mat2d **out, struct mat2d *left, struct mat2d *right) {
+    struct mat2d_dot_task *task = mat2d_app_create_dot_task();
+    int ok = task != NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        free(task);
+        return -1;
+    }
+
+    mat2d_app_set_dot_operands(task, left, right);
+    int rc = mad2d_app_distribute_dot(task, 0);
+    if (rc == 0) {
+        rc = mat2d_dot_MPI_summa(task);
+    }
+    if (rc == 0) {
+        rc = mad2d_app_collect_dot(task);
+    }
+    if (rc == 0 && mat2d_app_get_rank() == mat2d_app_get_root_indx()) {
+        *out = task->result;
+        task->result = NULL;
+    }
+    mat2d_app_destroy_dot_task(task);
+    return rc;
+}
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include <mpi.h>
+
+#include "libmatrix/app.h"
+#include "libmatrix/matrix.h"
+#include "libmatrix/task.h"
+
+#include "grid.h"
+
+size_t grid_numroc(size_t n, size_t nb, size_t iproc, size_t nprocs) {
+    size_t blocks = n / nb;
+    size_t count = blocks / nprocs * nb;
+    size_t extra = blocks % nprocs;
+    if (iproc < extra) {
+        count += nb;
+    } else if (iproc == extra) {
+        count += n % nb;
+    }
+    return count;
+}
+
+int grid_agree(const struct mat2d_grid *grid, int rc) {
+    int all = 0;
+    MPI_Allreduce(&rc, &all, 1, MPI_INT, MPI_MIN, grid->comm);
+    return all;
+}
+
+// Sides of 0 are derived from the rank count; with both 0 the grid is
+// as square as the count allows, with P <= Q
+struct mat2d_grid* mat2d_grid_create(size_t nprow, size_t npcol) {
+    size_t size = mat2d_app_get_size();
+    size_t rank = mat2d_app_get_rank();
+    if (nprow == 0 && npcol == 0) {
+        int dims[2] = { 0, 0 };
+        MPI_Dims_create(size, 2, dims);
+        nprow = dims[1];
+        npcol = dims[0];
+    } else if (nprow == 0) {
+        nprow = size / npcol;
+    } else if (npcol == 0) {
+        npcol = size / nprow;
+    }
+    if (nprow * npcol != size) {
+        return NULL;
+    }
+
+    struct mat2d_grid *grid = calloc(1, sizeof(struct mat2d_grid));
+    int ok = grid != NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        free(grid);
+        return NULL;
+    }
+
+    grid->nprow = nprow;
+    grid->npcol = npcol;
+    grid->myrow = rank / npcol;
+    grid->mycol = rank % npcol;
+    MPI_Comm_dup(MPI_COMM_WORLD, &grid->comm);
+    MPI_Comm_split(grid->comm, grid->myrow, grid->mycol, &grid->row_comm);
+    MPI_Comm_split(grid->comm, grid->mycol, grid->myrow, &grid->col_comm);
+    return grid;
+}
+
+void mat2d_grid_destroy(struct mat2d_grid *grid) {
+    if (grid == NULL) {
+        return;
+    }
+    MPI_Comm_free(&grid->col_comm);
+    MPI_Comm_free(&grid->row_comm);
+    MPI_Comm_free(&grid->comm);
+    free(grid);
+}
+
+size_t mat2d_grid_get_nprow(struct mat2d_grid *grid) {
+    return grid->nprow;
+}
+
+size_t mat2d_grid_get_npcol(struct mat2d_grid *grid) {
+    return grid->npcol;
+}
+
+size_t mat2d_grid_get_myrow(struct mat2d_grid *grid) {
+    return grid->myrow;
+}
+
+size_t mat2d_grid_get_mycol(struct mat2d_grid *grid) {
+    return grid->mycol;
+}
+
+struct mat2d_dist* mat2d_dist_create(
+    struct mat2d_grid *grid,
+    size_t rows, size_t cols,
+    size_t nb
+) {
+    if (nb == 0 || rows > INT_MAX || cols > INT_MAX || nb > INT_MAX) {
+        return NULL;
+    }
+    struct mat2d_dist *dist = calloc(1, sizeof(struct mat2d_dist));
+    if (dist != NULL) {
+        dist->local = mat2d_create_ex(
+            grid_numroc(rows, nb, grid->myrow, grid->nprow),
+            grid_numroc(cols, nb, grid->mycol, grid->npcol),
+            0, MAT2D_ALLOC_PADDED
+        );
+    }
+    int rc = dist != NULL && dist->local != NULL ? 0 : -1;
+    if (grid_agree(grid, rc) != 0) {
+        mat2d_dist_destroy(dist);
+        return NULL;
+    }
+    dist->grid = grid;
+    dist->rows = rows;
+    dist->cols = cols;
+    dist->nb = nb;
+    return dist;
+}
+
+void mat2d_dist_destroy(struct mat2d_dist *dist) {
+    if (dist == NULL) {
+        return;
+    }
+    mat2d_destroy(dist->local);
+    free(dist);
+}
+
+size_t mat2d_dist_get_rows(struct mat2d_dist *dist) {
+    return dist->rows;
+}
+
+size_t mat2d_dist_get_cols(struct mat2d_dist *dist) {
+    return dist->cols;
+}
+
+size_t mat2d_dist_get_nb(struct mat2d_dist *dist) {
+    return dist->nb;
+}
+
+struct mat2d* mat2d_dist_get_local(struct mat2d_dist *dist) {
+    return dist->local;
+}
+
+// The part of a whole rows x cols matrix with pitch ld that process
+// (p, q) owns, in local order: the columns of q within one row, resized
+// to the pitch, then the rows of p out of those
+static MPI_Datatype dist_part_type(
+    const struct mat2d_dist *dist,
+    size_t ld,
+    size_t p, size_t q
+) {
+    int distrib = MPI_DISTRIBUTE_CYCLIC;
+    int darg = dist->nb;
+    int gsize = dist->cols;
+    int psize = dist->grid->npcol;
+    MPI_Datatype cols_type, row_type, part_type;
+    MPI_Type_create_darray(
+        psize, q, 1, &gsize, &distrib, &darg, &psize,
+        MPI_ORDER_C, MPI_DOUBLE, &cols_type
+    );
+    MPI_Type_create_resized(cols_type, 0, sizeof(double) * ld, &row_type);
+
+    gsize = dist->rows;
+    psize = dist->grid->nprow;
+    MPI_Type_create_darray(
+        psize, p, 1, &gsize, &distrib, &darg, &psize,
+        MPI_ORDER_C, row_type, &part_type
+    );
+    MPI_Type_commit(&part_type);
+    MPI_Type_free(&row_type);
+    MPI_Type_free(&cols_type);
+    return part_type;
+}
+
+// One row of the local matrix, resized to its pitch
+static MPI_Datatype dist_local_row_type(const struct mat2d_dist *dist) {
+    MPI_Datatype row, row_type;
+    MPI_Type_contiguous(mat2d_get_cols(dist->local), MPI_DOUBLE, &row);
+    MPI_Type_create_resized(
+        row, 0, sizeof(double) * mat2d_get_ld(dist->local), &row_type
+    );
+    MPI_Type_commit(&row_type);
+    MPI_Type_free(&row);
+    return row_type;
+}
+
+// Moves the parts of every process between the root's whole matrix and
+// the local matrices, each part straight from or into place through a
+// derived datatype
+static int dist_move(struct mat2d_dist *dist, struct mat2d *full, bool gather) {
+    struct mat2d_grid *grid = dist->grid;
+    int size = grid->nprow * grid->npcol;
+    int root = mat2d_app_get_root_indx();
+    bool is_root = mat2d_app_get_rank() == root;
+
+    MPI_Request *reqs = NULL;
+    int rc = 0;
+    if (is_root) {
+        reqs = malloc(sizeof(MPI_Request) * size);
+        if (reqs == NULL || full == NULL
+            || mat2d_get_rows(full) != dist->rows
+            || mat2d_get_cols(full) != dist->cols) {
+            rc = -1;
+        }
+    }
+    if (grid_agree(grid, rc) != 0) {
+        free(reqs);
+        return -1;
+    }
+
+    MPI_Datatype row_type = dist_local_row_type(dist);
+    int local_rows = mat2d_get_rows(dist->local);
+    MPI_Request local_req;
+    if (gather) {
+        MPI_Isend(
+            mat2d_get_data(dist->local), local_rows, row_type,
+            root, 0, grid->comm, &local_req
+        );
+    } else {
+        MPI_Irecv(
+            mat2d_get_data(dist->local), local_rows, row_type,
+            root, 0, grid->comm, &local_req
+        );
+    }
+
+    if (is_root) {
+        for (int r = 0; r < size; r++) {
+            MPI_Datatype part = dist_part_type(
+                dist, mat2d_get_ld(full), r / grid->npcol, r % grid->npcol
+            );
+            if (gather) {
+                MPI_Irecv(mat2d_get_data(full), 1, part, r, 0, grid->comm, &reqs[r]);
+            } else {
+                MPI_Isend(mat2d_get_data(full), 1, part, r, 0, grid->comm, &reqs[r]);
+            }
+            // Freed types live on until their transfers complete
+            MPI_Type_free(&part);
+        }
+        MPI_Waitall(size, reqs, MPI_STATUSES_IGNORE);
+    }
+    MPI_Wait(&local_req, MPI_STATUS_IGNORE);
+
+    MPI_Type_free(&row_type);
+    free(reqs);
+    return 0;
+}
+
+int mat2d_dist_scatter(struct mat2d_dist *dist, struct mat2d *full) {
+    return dist_move(dist, full, false);
+}
+
+int mat2d_dist_gather(struct mat2d **out, struct mat2d_dist *dist) {
+    bool is_root = mat2d_app_get_rank() == mat2d_app_get_root_indx();
+    struct mat2d *full = NULL;
+    if (is_root) {
+        full = mat2d_create(dist->rows, dist->cols);
+    }
+    // A failed allocation on the root surfaces in dist_move's agreement
+    if (dist_move(dist, full, true) != 0) {
+        mat2d_destroy(full);
+        return -1;
+    }
+    if (is_root) {
+        *out = full;
+    }
+    return 0;
+}
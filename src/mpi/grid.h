@@ -0,0 +1,49 @@
+#ifndef MPI_GRID_H
+#define MPI_GRID_H
+
+#include <stddef.h>
+
+#include <mpi.h>
+
+#include "libmatrix/matrix.h"
+#include "libmatrix/task.h"
+
+// P x Q grid over the ranks of MPI_COMM_WORLD, numbered row by row.
+// row_comm joins the Q processes of one grid row, ranked by column, and
+// col_comm the P processes of one grid column, ranked by row.
+struct mat2d_grid {
+    MPI_Comm comm, row_comm, col_comm;
+    size_t nprow, npcol;
+    size_t myrow, mycol;
+};
+
+// Matrix cut into nb x nb blocks dealt out cyclically over the grid as
+// in ScaLAPACK: block (I, J) lives on process (I mod P, J mod Q), which
+// keeps its blocks in their global order in one local matrix
+struct mat2d_dist {
+    struct mat2d_grid *grid;
+    size_t rows, cols, nb;
+    struct mat2d *local;
+};
+
+// Indices below n that process iproc of nprocs owns. For a global index
+// n this is also the first local index whose global index is >= n.
+size_t grid_numroc(size_t n, size_t nb, size_t iproc, size_t nprocs);
+
+static inline size_t grid_owner(size_t g, size_t nb, size_t nprocs) {
+    return g / nb % nprocs;
+}
+
+static inline size_t grid_local(size_t g, size_t nb, size_t nprocs) {
+    return g / (nb * nprocs) * nb + g % nb;
+}
+
+static inline size_t grid_global(size_t l, size_t nb, size_t iproc, size_t nprocs) {
+    return (l / nb * nprocs + iproc) * nb + l % nb;
+}
+
+// MIN of rc over the grid, so a failure on one process fails the call
+// on all of them
+int grid_agree(const struct mat2d_grid *grid, int rc);
+
+#endif
@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include <mpi.h>
+
+#include "libmatrix/matrix.h"
+#include "libmatrix/task.h"
+
+#include "../gemm.h"
+#include "../kernels.h"
+#include "grid.h"
+
+// Blocked right-looking LU with partial pivoting in the style of
+// ScaLAPACK's pdgetrf. Per block column of width nb:
+//
+//   1. the grid column owning it factors the panel, one Allreduce over
+//      col_comm per column to find the pivot;
+//   2. the pivots go along row_comm and rows are swapped outside the
+//      panel, each swap between two processes of a grid column;
+//   3. the L panel goes along row_comm, the grid row owning the block
+//      row solves for its U block and sends it along col_comm;
+//   4. every process updates its part of the trailing matrix with one
+//      GEMM.
+//
+// Steps 3 and 4 move only local rows and columns, so traffic per process
+// shrinks with both sides of the grid instead of staying at full rows.
+
+static double *dist_row(struct mat2d_dist *dist, size_t l) {
+    return mat2d_get_row_ref(dist->local, l);
+}
+
+// Swaps local columns [lo, hi) of global rows r1 and r2, within the
+// calling grid column
+static void dist_swap_rows(
+    struct mat2d_dist *dist,
+    size_t r1, size_t r2,
+    size_t lo, size_t hi
+) {
+    struct mat2d_grid *grid = dist->grid;
+    size_t p1 = grid_owner(r1, dist->nb, grid->nprow);
+    size_t p2 = grid_owner(r2, dist->nb, grid->nprow);
+    if (r1 == r2 || lo >= hi || (p1 != grid->myrow && p2 != grid->myrow)) {
+        return;
+    }
+
+    if (p1 == p2) {
+        double *row1 = dist_row(dist, grid_local(r1, dist->nb, grid->nprow));
+        double *row2 = dist_row(dist, grid_local(r2, dist->nb, grid->nprow));
+        for (size_t j = lo; j < hi; j++) {
+            double tmp = row1[j];
+            row1[j] = row2[j];
+            row2[j] = tmp;
+        }
+        return;
+    }
+
+    size_t mine = p1 == grid->myrow ? r1 : r2;
+    size_t other = p1 == grid->myrow ? p2 : p1;
+    double *row = dist_row(dist, grid_local(mine, dist->nb, grid->nprow));
+    MPI_Sendrecv_replace(
+        row + lo, hi - lo, MPI_DOUBLE,
+        other, 0, other, 0,
+        grid->col_comm, MPI_STATUS_IGNORE
+    );
+}
+
+// Unblocked factorization of global columns [j0, j0 + jb) on the grid
+// column that owns them. Returns -1 on a zero pivot, leaving the column
+// unscaled like LAPACK.
+static int dist_factor_panel(
+    struct mat2d_dist *mat,
+    size_t j0, size_t jb,
+    size_t *piv,
+    double *prow
+) {
+    struct mat2d_grid *grid = mat->grid;
+    size_t nb = mat->nb;
+    size_t local_rows = mat2d_get_rows(mat->local);
+    size_t c0 = grid_numroc(j0, nb, grid->mycol, grid->npcol);
+    int rc = 0;
+
+    for (size_t c = j0; c < j0 + jb; c++) {
+        size_t t = c - j0;
+        struct {
+            double val;
+            int idx;
+        } best = { -1.0, INT_MAX };
+        for (size_t l = grid_numroc(c, nb, grid->myrow, grid->nprow); l < local_rows; l++) {
+            double val = fabs(dist_row(mat, l)[c0 + t]);
+            if (val > best.val) {
+                best.val = val;
+                best.idx = grid_global(l, nb, grid->myrow, grid->nprow);
+            }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &best, 1, MPI_DOUBLE_INT, MPI_MAXLOC, grid->col_comm);
+        piv[c] = best.idx;
+        dist_swap_rows(mat, c, piv[c], c0, c0 + jb);
+
+        size_t owner = grid_owner(c, nb, grid->nprow);
+        if (owner == grid->myrow) {
+            memcpy(
+                prow, dist_row(mat, grid_local(c, nb, grid->nprow)) + c0,
+                sizeof(double) * jb
+            );
+        }
+        MPI_Bcast(prow, jb, MPI_DOUBLE, owner, grid->col_comm);
+        if (prow[t] == 0.0) {
+            rc = -1;
+            continue;
+        }
+
+        double rdiag = 1.0 / prow[t];
+        for (size_t l = grid_numroc(c + 1, nb, grid->myrow, grid->nprow); l < local_rows; l++) {
+            double *row = dist_row(mat, l) + c0;
+            row[t] *= rdiag;
+            kern_axpy(jb - t - 1, -row[t], prow + t + 1, row + t + 1);
+        }
+    }
+    return rc;
+}
+
+// Packs local columns [c0, c0 + jb) of local rows [lo, hi) on the grid
+// column pc and broadcasts them along the grid row
+static void dist_bcast_panel(
+    struct mat2d_dist *mat,
+    size_t pc,
+    size_t c0, size_t jb,
+    size_t lo, size_t hi,
+    double *buf
+) {
+    struct mat2d_grid *grid = mat->grid;
+    if (grid->mycol == pc) {
+        for (size_t l = lo; l < hi; l++) {
+            memcpy(&buf[(l - lo) * jb], dist_row(mat, l) + c0, sizeof(double) * jb);
+        }
+    }
+    MPI_Bcast(buf, (hi - lo) * jb, MPI_DOUBLE, pc, grid->row_comm);
+}
+
+// Same for local rows [r0, r0 + jb), local columns [lo, hi), on the
+// grid row pr along the grid column
+static void dist_bcast_block_row(
+    struct mat2d_dist *mat,
+    size_t pr,
+    size_t r0, size_t jb,
+    size_t lo, size_t hi,
+    double *buf
+) {
+    struct mat2d_grid *grid = mat->grid;
+    if (grid->myrow == pr) {
+        for (size_t i = 0; i < jb; i++) {
+            memcpy(&buf[i * (hi - lo)], dist_row(mat, r0 + i) + lo, sizeof(double) * (hi - lo));
+        }
+    }
+    MPI_Bcast(buf, jb * (hi - lo), MPI_DOUBLE, pr, grid->col_comm);
+}
+
+// B -= L * Y over local rows [lo, hi) of mat, local columns [c0, lc)
+static void dist_update(
+    struct mat2d_dist *mat,
+    size_t lo, size_t hi,
+    size_t c0,
+    const double *l, size_t jb,
+    const double *y
+) {
+    struct mat2d *local = mat->local;
+    size_t n = mat2d_get_cols(local) - c0;
+    if (hi <= lo || n == 0) {
+        return;
+    }
+    size_t ld = mat2d_get_ld(local);
+    gemm_dgemm(
+        hi - lo, n, jb,
+        -1.0, l, jb, 1,
+        y, n, 1,
+        1.0, mat2d_get_data(local) + lo * ld + c0, ld, 1
+    );
+}
+
+int mat2d_dist_lu_factor(struct mat2d_dist *mat, size_t *piv) {
+    struct mat2d_grid *grid = mat->grid;
+    size_t n = mat->rows;
+    size_t nb = mat->nb;
+    size_t local_rows = mat2d_get_rows(mat->local);
+    size_t local_cols = mat2d_get_cols(mat->local);
+    if (mat->cols != n) {
+        return -1;
+    }
+
+    double *prow = malloc(sizeof(double) * nb);
+    double *lpanel = malloc(sizeof(double) * (local_rows * nb + 1));
+    double *ublock = malloc(sizeof(double) * (nb * local_cols + 1));
+    int rc = prow != NULL && lpanel != NULL && ublock != NULL ? 0 : -1;
+    if (grid_agree(grid, rc) != 0) {
+        free(ublock);
+        free(lpanel);
+        free(prow);
+        return -1;
+    }
+
+    for (size_t j0 = 0; j0 < n; j0 += nb) {
+        size_t jb = n - j0 < nb ? n - j0 : nb;
+        size_t pr = grid_owner(j0, nb, grid->nprow);
+        size_t pc = grid_owner(j0, nb, grid->npcol);
+        size_t c0 = grid_numroc(j0, nb, grid->mycol, grid->npcol);
+
+        if (grid->mycol == pc && dist_factor_panel(mat, j0, jb, piv, prow) != 0) {
+            rc = -1;
+        }
+        MPI_Bcast(piv + j0, jb, MPI_UNSIGNED_LONG, pc, grid->row_comm);
+        for (size_t c = j0; c < j0 + jb; c++) {
+            if (grid->mycol == pc) {
+                dist_swap_rows(mat, c, piv[c], 0, c0);
+                dist_swap_rows(mat, c, piv[c], c0 + jb, local_cols);
+            } else {
+                dist_swap_rows(mat, c, piv[c], 0, local_cols);
+            }
+        }
+        if (j0 + jb == n) {
+            break;
+        }
+
+        size_t r1 = grid_numroc(j0, nb, grid->myrow, grid->nprow);
+        size_t r2 = grid_numroc(j0 + jb, nb, grid->myrow, grid->nprow);
+        size_t cr = grid_numroc(j0 + jb, nb, grid->mycol, grid->npcol);
+        size_t nr = local_cols - cr;
+        dist_bcast_panel(mat, pc, c0, jb, r1, local_rows, lpanel);
+
+        // U12 = L11^-1 A12 on the grid row holding the block row
+        if (grid->myrow == pr) {
+            for (size_t i = 1; i < jb; i++) {
+                double *dst = dist_row(mat, r1 + i) + cr;
+                for (size_t t = 0; t < i; t++) {
+                    kern_axpy(nr, -lpanel[i * jb + t], dist_row(mat, r1 + t) + cr, dst);
+                }
+            }
+        }
+        dist_bcast_block_row(mat, pr, r1, jb, cr, local_cols, ublock);
+        dist_update(mat, r2, local_rows, cr, &lpanel[(r2 - r1) * jb], jb, ublock);
+    }
+
+    free(ublock);
+    free(lpanel);
+    free(prow);
+    return grid_agree(grid, rc);
+}
+
+// Solves L X = B (unit lower) or U X = B in place in rhs, block row by
+// block row: the grid column holding the diagonal block sends its panel
+// along the grid rows, the grid row holding the block row solves and
+// sends the result along the grid columns, and everyone updates the
+// block rows still to come
+static int dist_trsm(struct mat2d_dist *lu, struct mat2d_dist *rhs, bool upper) {
+    struct mat2d_grid *grid = lu->grid;
+    size_t n = lu->rows;
+    size_t nb = lu->nb;
+    size_t local_rows = mat2d_get_rows(lu->local);
+    size_t rhs_cols = mat2d_get_cols(rhs->local);
+
+    double *panel = malloc(sizeof(double) * (local_rows * nb + 1));
+    double *yblock = malloc(sizeof(double) * (nb * rhs_cols + 1));
+    int rc = panel != NULL && yblock != NULL ? 0 : -1;
+    if (grid_agree(grid, rc) != 0) {
+        free(yblock);
+        free(panel);
+        return -1;
+    }
+
+    size_t blocks = (n + nb - 1) / nb;
+    for (size_t s = 0; s < blocks; s++) {
+        size_t kb = upper ? blocks - 1 - s : s;
+        size_t j0 = kb * nb;
+        size_t jb = n - j0 < nb ? n - j0 : nb;
+        size_t pr = grid_owner(j0, nb, grid->nprow);
+        size_t pc = grid_owner(j0, nb, grid->npcol);
+        size_t c0 = grid_numroc(j0, nb, grid->mycol, grid->npcol);
+        size_t d0 = grid_numroc(j0, nb, grid->myrow, grid->nprow);
+        size_t d1 = grid_numroc(j0 + jb, nb, grid->myrow, grid->nprow);
+
+        // Rows of the block column taking part: the diagonal block and
+        // the side still to be solved
+        size_t lo = upper ? 0 : d0;
+        size_t hi = upper ? d1 : local_rows;
+        dist_bcast_panel(lu, pc, c0, jb, lo, hi, panel);
+
+        if (grid->myrow == pr) {
+            const double *diag = &panel[(d0 - lo) * jb];
+            if (upper) {
+                for (size_t i = jb; i-- > 0;) {
+                    double *dst = dist_row(rhs, d0 + i);
+                    for (size_t t = i + 1; t < jb; t++) {
+                        kern_axpy(rhs_cols, -diag[i * jb + t], dist_row(rhs, d0 + t), dst);
+                    }
+                    kern_scale(rhs_cols, 1.0 / diag[i * jb + i], dst);
+                }
+            } else {
+                for (size_t i = 1; i < jb; i++) {
+                    double *dst = dist_row(rhs, d0 + i);
+                    for (size_t t = 0; t < i; t++) {
+                        kern_axpy(rhs_cols, -diag[i * jb + t], dist_row(rhs, d0 + t), dst);
+                    }
+                }
+            }
+        }
+        dist_bcast_block_row(rhs, pr, d0, jb, 0, rhs_cols, yblock);
+
+        if (upper) {
+            dist_update(rhs, 0, d0, 0, panel, jb, yblock);
+        } else {
+            dist_update(rhs, d1, local_rows, 0, &panel[(d1 - lo) * jb], jb, yblock);
+        }
+    }
+
+    free(yblock);
+    free(panel);
+    return 0;
+}
+
+static bool dist_same_rows(struct mat2d_dist *a, struct mat2d_dist *b) {
+    return a->grid == b->grid && a->rows == b->rows && a->nb == b->nb;
+}
+
+int mat2d_dist_lu_solve(struct mat2d_dist *lu, const size_t *piv, struct mat2d_dist *rhs) {
+    if (lu->rows != lu->cols || !dist_same_rows(lu, rhs)) {
+        return -1;
+    }
+    for (size_t c = 0; c < lu->rows; c++) {
+        dist_swap_rows(rhs, c, piv[c], 0, mat2d_get_cols(rhs->local));
+    }
+    if (dist_trsm(lu, rhs, false) != 0) {
+        return -1;
+    }
+    return dist_trsm(lu, rhs, true);
+}
+
+// Solves A X = I with the factors of a copy of in. The swaps are folded
+// into the right-hand side up front: row i of P I is e_perm[i].
+int mat2d_dist_inv(struct mat2d_dist *out, struct mat2d_dist *in) {
+    struct mat2d_grid *grid = in->grid;
+    size_t n = in->rows;
+    if (in->cols != n || out->cols != n || !dist_same_rows(in, out)) {
+        return -1;
+    }
+
+    struct mat2d_dist *lu = mat2d_dist_create(grid, n, n, in->nb);
+    if (lu == NULL) {
+        return -1;
+    }
+    size_t *piv = malloc(sizeof(size_t) * (n + 1));
+    size_t *perm = malloc(sizeof(size_t) * (n + 1));
+    int rc = piv != NULL && perm != NULL ? 0 : -1;
+    if (grid_agree(grid, rc) != 0) {
+        free(perm);
+        free(piv);
+        mat2d_dist_destroy(lu);
+        return -1;
+    }
+    mat2d_copy(lu->local, in->local);
+
+    rc = mat2d_dist_lu_factor(lu, piv);
+    if (rc == 0) {
+        for (size_t i = 0; i < n; i++) {
+            perm[i] = i;
+        }
+        for (size_t c = 0; c < n; c++) {
+            size_t tmp = perm[c];
+            perm[c] = perm[piv[c]];
+            perm[piv[c]] = tmp;
+        }
+
+        size_t nb = in->nb;
+        mat2d_fill_zero(out->local);
+        for (size_t l = 0; l < mat2d_get_rows(out->local); l++) {
+            size_t j = perm[grid_global(l, nb, grid->myrow, grid->nprow)];
+            if (grid_owner(j, nb, grid->npcol) == grid->mycol) {
+                dist_row(out, l)[grid_local(j, nb, grid->npcol)] = 1.0;
+            }
+        }
+        rc = dist_trsm(lu, out, false);
+    }
+    if (rc == 0) {
+        rc = dist_trsm(lu, out, true);
+    }
+
+    free(perm);
+    free(piv);
+    mat2d_dist_destroy(lu);
+    return rc;
+}
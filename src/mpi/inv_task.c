@@ -1,5 +1,8 @@
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
 
 #include <mpi.h>
 
@@ -7,22 +10,21 @@
 #include "libmatrix/task.h"
 #include "libmatrix/matrix.h"
 
-#define MAX_NODE_CNT 100
-#define MAX_SHARDES_CNT 100
+#include "../arena.h"
+#include "../kernels.h"
+#include "io.h"
 
 struct mat2d_inv_task {
     size_t sent_rows;
+    // Rows of the whole matrix, which the root alone holds before
+    // redistribution and after unite
+    size_t global_rows;
     struct mat2d *forward_mat;
     struct mat2d *reverse_mat;
 };
 
-static size_t get_sent_rows(struct mat2d *mat, size_t i) {
-    return mat2d_get_cols(mat) / mat2d_app_get_size()
-        + (mat2d_app_get_size() - i + (mat2d_get_cols(mat) % mat2d_app_get_size()) - 1)
-        / mat2d_app_get_size();
-}
-
-// Возвращает через аргументы размер партиции
+// Возвращает через аргументы размер партиции. The root broadcasts the
+// shape once and every rank derives its own shard from it.
 int mad2d_app_redistribute_matrix_size(
     struct mat2d_inv_task *task,
     size_t *rows,
@@ -31,202 +33,256 @@ int mad2d_app_redistribute_matrix_size(
     size_t global_indx = mat2d_app_get_rank();
     size_t global_size = mat2d_app_get_size();
     size_t root_indx = mat2d_app_get_root_indx();
-    if (global_indx == root_indx) {
-        struct mat2d *mat = task->forward_mat;
-        size_t shard_rows = (mat2d_get_rows(mat) + global_size - 1) / global_size;
-        size_t shard_cols = mat2d_get_cols(mat);
-        for (size_t i = 0; i < global_size; ++i) {
-            if (i != root_indx) {
-                size_t sent_rows = get_sent_rows(mat, i);
-
-                MPI_Send(&shard_rows, 1, MPI_UNSIGNED_LONG, i, 0, MPI_COMM_WORLD);
-                MPI_Send(&shard_cols, 1, MPI_UNSIGNED_LONG, i, 0, MPI_COMM_WORLD);
-                MPI_Send(&sent_rows,  1, MPI_UNSIGNED_LONG, i, 0, MPI_COMM_WORLD);
-            }
-        }
-        *rows = shard_rows;
-        *cols = shard_cols;
-        task->sent_rows = get_sent_rows(mat, root_indx);
-    } else {
-        MPI_Status status;
-        size_t tmp_rows, tmp_cols;
-        size_t tmp_sent_rows;
-
-        MPI_Recv(
-            &tmp_rows, 1, MPI_UNSIGNED_LONG, 
-            root_indx, 0, MPI_COMM_WORLD, &status
-        );
-        MPI_Recv(
-            &tmp_cols, 1, MPI_UNSIGNED_LONG, 
-            root_indx, 0, MPI_COMM_WORLD, &status
-        );
-        MPI_Recv(
-            &tmp_sent_rows, 1, MPI_UNSIGNED_LONG, 
-            root_indx, 0, MPI_COMM_WORLD, &status
-        );
-        *rows = tmp_rows;
-        *cols = tmp_cols;
-        task->sent_rows = tmp_sent_rows;
-    }
-
-    MPI_Barrier(MPI_COMM_WORLD);
-}
 
-static struct mat2d *mad2d_get_shard(
-    struct mat2d *mat,
-    size_t shard_indx,
-    size_t shardes_cnt
-) {
-    size_t shard_rows = (mat2d_get_rows(mat) + shardes_cnt - 1) / shardes_cnt;
-    struct mat2d *shard = mat2d_create(shard_rows, mat2d_get_cols(mat));
-    if (shard == NULL) {
-        return NULL;
+    // Rows, columns, and 0 rows when the root has nothing to send
+    uint64_t shape[2] = { 0, 0 };
+    if (global_indx == root_indx && task->forward_mat != NULL) {
+        shape[0] = mat2d_get_rows(task->forward_mat);
+        shape[1] = mat2d_get_cols(task->forward_mat);
     }
-    for (size_t i = shard_indx; i < mat2d_get_rows(mat); i += shardes_cnt) {
-        size_t row_in_shard_indx = i / shardes_cnt;
+    MPI_Bcast(shape, 2, MPI_UINT64_T, root_indx, MPI_COMM_WORLD);
 
-        double *src_row_ref = mat2d_get_row_ref(mat, i);
-        double *dest_row_ref = mat2d_get_row_ref(shard, row_in_shard_indx);
-        memcpy(dest_row_ref, src_row_ref, sizeof(double) * mat2d_get_cols(mat));
+    size_t shard_rows = (shape[0] + global_size - 1) / global_size;
+    if (shape[0] == 0 || shape[1] == 0
+        || shape[1] > INT_MAX || shard_rows > INT_MAX) {
+        return -1;
     }
-    return shard;
+    *rows = shard_rows;
+    *cols = shape[1];
+    task->global_rows = shape[0];
+    task->sent_rows = mpi_io_owned_rows(shape[0], global_indx, global_size);
+    return 0;
 }
 
-static void mad2d_place_shard(
-    struct mat2d *mat,
+// Moves cyclic row shards between the root's whole matrix and the shard
+// of every rank, root included, without packing. Rows go in full rounds,
+// one row per rank each, as one strided vector per rank, then the last
+// partial round as single rows. Both root types span one row, so rank i
+// starts at displacement i. ready is this rank's verdict on its own
+// buffers; the call fails on every rank if any is not ready.
+static int mad2d_move_cyclic(
+    struct mat2d *full,
     struct mat2d *shard,
-    size_t shard_indx,
-    size_t shardes_cnt
+    size_t global_rows,
+    bool gather,
+    bool ready
 ) {
-    size_t shard_rows = (mat2d_get_rows(mat) + shardes_cnt - 1) / shardes_cnt;
-    for (size_t i = 0; i < mat2d_get_rows(shard); i += 1) {
-        size_t row_in_mat_indx = shard_indx + shardes_cnt * i;
-
-        double *src_row_ref = mat2d_get_row_ref(shard, i);
-        double *dest_row_ref = mat2d_get_row_ref(mat, row_in_mat_indx);
-        memcpy(dest_row_ref, src_row_ref, sizeof(double) * mat2d_get_cols(mat));
-    }
-}
-
-static int mad2d_app_redistribute_matrix_data(struct mat2d** mat_inout) {
     size_t global_size = mat2d_app_get_size();
     size_t global_indx = mat2d_app_get_rank();
     size_t root_indx = mat2d_app_get_root_indx();
-    MPI_Request requests[MAX_SHARDES_CNT];
-    struct mat2d* mat = *mat_inout;
-    struct mat2d **shards = malloc(sizeof(struct mat2d *) * (global_size - 1));
-
-    if (global_indx == root_indx) {
-        size_t pending_indx = 0;
-        for (size_t i = 0; i < global_size; ++i) {
-            if (i != root_indx) {
-                struct mat2d *shard = mad2d_get_shard(mat, i, global_size);
-                if (shard == NULL) {
-                    return -1;
-                }
-                shards[pending_indx] = shard;
-                size_t shard_size = mat2d_get_cols(shard) * mat2d_get_rows(shard);
-                MPI_Isend(
-                    mat2d_get_data(shard), shard_size, MPI_DOUBLE, 
-                    i, 0, MPI_COMM_WORLD, &requests[pending_indx]
-                );
-                pending_indx++;
-            }
+    bool is_root = global_indx == root_indx;
+
+    int *counts = is_root ? malloc(sizeof(int) * 3 * global_size) : NULL;
+    int ok = ready && (!is_root || counts != NULL);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        free(counts);
+        return -1;
+    }
+
+    int cols = mat2d_get_cols(shard);
+    int rounds = global_rows / global_size;
+    int tail = global_rows % global_size;
+    int own_tail = global_indx < (size_t)tail ? 1 : 0;
+
+    MPI_Datatype row, shard_row;
+    MPI_Type_contiguous(cols, MPI_DOUBLE, &row);
+    MPI_Type_create_resized(row, 0, sizeof(double) * mat2d_get_ld(shard), &shard_row);
+    MPI_Type_commit(&shard_row);
+
+    // Non-root ranks never touch the root arguments, but still pass
+    // valid ones
+    MPI_Datatype round_type = shard_row, row_type = shard_row;
+    int *round_counts = NULL, *tail_counts = NULL, *displs = NULL;
+    double *full_data = NULL, *full_tail = NULL;
+    if (is_root) {
+        size_t ld = mat2d_get_ld(full);
+        MPI_Datatype round;
+        MPI_Type_vector(rounds, cols, global_size * ld, MPI_DOUBLE, &round);
+        MPI_Type_create_resized(round, 0, sizeof(double) * ld, &round_type);
+        MPI_Type_create_resized(row, 0, sizeof(double) * ld, &row_type);
+        MPI_Type_commit(&round_type);
+        MPI_Type_commit(&row_type);
+        MPI_Type_free(&round);
+
+        round_counts = counts;
+        tail_counts = counts + global_size;
+        displs = counts + 2 * global_size;
+        for (size_t i = 0; i < global_size; i++) {
+            round_counts[i] = 1;
+            tail_counts[i] = i < (size_t)tail ? 1 : 0;
+            displs[i] = i;
         }
-        MPI_Waitall(pending_indx, requests, MPI_STATUSES_IGNORE);
-        for (size_t i = 0; i < pending_indx; ++i) {
-            mat2d_destroy(shards[i]);
+        full_data = mat2d_get_data(full);
+        full_tail = full_data + (size_t)rounds * global_size * ld;
+    }
+    MPI_Type_free(&row);
+
+    double *shard_data = mat2d_get_data(shard);
+    double *shard_tail = shard_data + (size_t)rounds * mat2d_get_ld(shard);
+    if (gather) {
+        if (rounds > 0) {
+            MPI_Gatherv(
+                shard_data, rounds, shard_row,
+                full_data, round_counts, displs, round_type,
+                root_indx, MPI_COMM_WORLD
+            );
+        }
+        if (tail > 0) {
+            MPI_Gatherv(
+                shard_tail, own_tail, shard_row,
+                full_tail, tail_counts, displs, row_type,
+                root_indx, MPI_COMM_WORLD
+            );
         }
-
-        struct mat2d *shard = mad2d_get_shard(mat, root_indx, global_size);
-        mat2d_destroy(*mat_inout);
-        *mat_inout = shard;
     } else {
-        size_t shard_size = mat2d_get_cols(mat) * mat2d_get_rows(mat);
-        MPI_Irecv(
-            mat2d_get_data(mat), shard_size, MPI_DOUBLE, 
-            root_indx, 0, MPI_COMM_WORLD, &requests[0]
-        );
-        MPI_Waitall(1, requests, MPI_STATUSES_IGNORE);
+        if (rounds > 0) {
+            MPI_Scatterv(
+                full_data, round_counts, displs, round_type,
+                shard_data, rounds, shard_row,
+                root_indx, MPI_COMM_WORLD
+            );
+        }
+        if (tail > 0) {
+            MPI_Scatterv(
+                full_tail, tail_counts, displs, row_type,
+                shard_tail, own_tail, shard_row,
+                root_indx, MPI_COMM_WORLD
+            );
+        }
     }
 
-    free(shards);
+    if (is_root) {
+        MPI_Type_free(&round_type);
+        MPI_Type_free(&row_type);
+    }
+    MPI_Type_free(&shard_row);
+    free(counts);
+    return 0;
+}
 
-    MPI_Barrier(MPI_COMM_WORLD);
+// Replaces the root's whole matrix and whatever the other ranks held
+// with each rank's shard. The padding row of a short shard stays zero.
+static int mad2d_app_redistribute_matrix_data(
+    struct mat2d_inv_task *task,
+    struct mat2d **mat_inout,
+    size_t rows,
+    size_t cols
+) {
+    bool is_root = mat2d_app_get_rank() == mat2d_app_get_root_indx();
+    struct mat2d *shard = mat2d_create(rows, cols);
+    bool ready = shard != NULL && (!is_root || (*mat_inout != NULL
+        && mat2d_get_rows(*mat_inout) == task->global_rows
+        && mat2d_get_cols(*mat_inout) == cols));
+    if (mad2d_move_cyclic(*mat_inout, shard, task->global_rows, false, ready) != 0) {
+        mat2d_destroy(shard);
+        return -1;
+    }
+    mat2d_destroy(*mat_inout);
+    *mat_inout = shard;
+    return 0;
 }
 
 int mad2d_app_redistribute_matrix(struct mat2d_inv_task *task) {
     size_t rows, cols;
-    int rc = mad2d_app_redistribute_matrix_size(task, &rows, &cols);
-    if (rc == -1) {
+    if (mad2d_app_redistribute_matrix_size(task, &rows, &cols) != 0) {
         return -1;
     }
-    size_t global_indx = mat2d_app_get_rank();
-    size_t root_indx = mat2d_app_get_root_indx();
-    if (global_indx != root_indx) {
-        struct mat2d* mat = mat2d_create(rows, cols);
-        if (mat == NULL) {
-            return -1;
-        }
-        task->forward_mat = mat;
+    if (mad2d_app_redistribute_matrix_data(task, &task->forward_mat, rows, cols) != 0) {
+        return -1;
     }
-    mad2d_app_redistribute_matrix_data(&task->forward_mat);
+    return mad2d_app_redistribute_matrix_data(task, &task->reverse_mat, rows, cols);
+}
 
-    if (global_indx != root_indx) {
-        struct mat2d* inv = mat2d_create(rows, cols);
-        if (inv == NULL) {
-            return -1;
-        }
-        task->reverse_mat = inv;
+int mad2d_app_unite_matrix(struct mat2d_inv_task *task) {
+    struct mat2d *shard = task->reverse_mat;
+    bool is_root = mat2d_app_get_rank() == mat2d_app_get_root_indx();
+
+    struct mat2d *result = NULL;
+    if (is_root) {
+        result = mat2d_create(task->global_rows, mat2d_get_cols(shard));
+    }
+    if (mad2d_move_cyclic(
+            result, shard, task->global_rows, true, !is_root || result != NULL
+        ) != 0) {
+        mat2d_destroy(result);
+        return -1;
     }
-    mad2d_app_redistribute_matrix_data(&task->reverse_mat);
+    if (is_root) {
+        mat2d_destroy(task->reverse_mat);
+        task->reverse_mat = result;
+    }
+    return 0;
 }
 
-int mad2d_app_unite_matrix(struct mat2d_inv_task *task) {
-    struct mat2d *mat = task->reverse_mat;
+// Every rank loads its own cyclic shard from disk and builds the matching
+// shard of the identity, leaving the task as mad2d_app_redistribute_matrix
+// would without routing the matrix through the root
+int mad2d_app_read_matrix(struct mat2d_inv_task *task, const char *filename) {
     size_t global_size = mat2d_app_get_size();
     size_t global_indx = mat2d_app_get_rank();
-    size_t root_indx = mat2d_app_get_root_indx();
 
-    if (global_indx == root_indx) {
-        struct mat2d *result = mat2d_create(
-            mat2d_get_cols(mat),
-            mat2d_get_cols(mat)
-        );
-        if (result == NULL) {
-            return -1;
-        }
-        for (size_t i = 0; i < global_size; ++i) {
-            size_t sent_rows = get_sent_rows(mat, i);
-            struct mat2d *tmp = mat2d_create(sent_rows, mat2d_get_cols(mat));
-            if (tmp == NULL) {
-                return -1;
-            }
-            if (i != root_indx) {
-                MPI_Status status;
-                MPI_Recv(
-                    mat2d_get_data(tmp), sent_rows * mat2d_get_cols(mat), MPI_DOUBLE,
-                    i, 0, MPI_COMM_WORLD, &status
-                );
-                
-            } else {
-                memcpy(
-                    mat2d_get_data(tmp), 
-                    mat2d_get_data(mat), 
-                    sizeof(double) * sent_rows * mat2d_get_cols(mat)
-                );
-            }
-            mad2d_place_shard(result, tmp, i, global_size);
-            mat2d_destroy(tmp);
+    struct mat2d *mat = NULL;
+    size_t rows = 0;
+    if (mat2d_read_cyclic_mpi(&mat, &rows, filename) != 0) {
+        return -1;
+    }
+    if (rows != mat2d_get_cols(mat)) {
+        mat2d_destroy(mat);
+        return -1;
+    }
+
+    struct mat2d *inv = mat2d_create(mat2d_get_rows(mat), mat2d_get_cols(mat));
+    int ok = inv != NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        mat2d_destroy(inv);
+        mat2d_destroy(mat);
+        return -1;
+    }
+
+    size_t sent_rows = mpi_io_owned_rows(rows, global_indx, global_size);
+    for (size_t i = 0; i < sent_rows; i++) {
+        mat2d_set(inv, i, global_indx + i * global_size, 1.0);
+    }
+
+    mat2d_destroy(task->forward_mat);
+    mat2d_destroy(task->reverse_mat);
+    task->forward_mat = mat;
+    task->reverse_mat = inv;
+    task->sent_rows = sent_rows;
+    task->global_rows = rows;
+    return 0;
+}
+
+// Collective counterpart of mad2d_app_unite_matrix: the shards of the
+// inverse go straight to the file
+int mad2d_app_write_matrix(struct mat2d_inv_task *task, const char *filename) {
+    return mat2d_write_cyclic_mpi(
+        task->reverse_mat, mat2d_get_cols(task->reverse_mat), filename
+    );
+}
+
+// Clears column row from every shard row but skip with the scaled pivot
+// row; the owner of the pivot row has to clear its other rows as well
+static void eliminate_rows(
+    struct mat2d *mat,
+    struct mat2d *inv,
+    size_t row,
+    size_t skip,
+    const double *pivot,
+    const double *inv_pivot
+) {
+    for (size_t i = 0; i < mat2d_get_rows(mat); i++) {
+        double *mat_row = mat2d_get_row_ref(mat, i);
+        double factor = mat_row[row];
+        if (i != skip && factor != 0.0) {
+            kern_axpy2(
+                mat2d_get_cols(mat), -factor,
+                pivot, mat_row,
+                inv_pivot, mat2d_get_row_ref(inv, i)
+            );
         }
-        mat2d_destroy(task->reverse_mat);
-        task->reverse_mat = result;
-    } else {
-        MPI_Status status;
-        MPI_Send(
-            mat2d_get_data(mat), task->sent_rows * mat2d_get_cols(mat), MPI_DOUBLE,
-            root_indx, 0, MPI_COMM_WORLD
-        );
     }
 }
 
@@ -238,39 +294,31 @@ int mat2d_inv_MPI_v1(struct mat2d_inv_task *task) {
     size_t master_indx = row % mat2d_app_get_size();
     bool is_master = master_indx == mat2d_app_get_rank();
 
-    double *row_data = malloc(sizeof(double) * mat2d_get_cols(mat));
-    if (row_data == NULL) {
-        return -1;
-    }
-    double *inv_row_data = malloc(sizeof(double) * mat2d_get_cols(mat));
-    if (inv_row_data == NULL) {
+    mat2d_arena *scratch = arena_scratch();
+    mat2d_arena_begin(scratch);
+    double *row_data = mat2d_arena_alloc(scratch, sizeof(double) * mat2d_get_cols(mat));
+    double *inv_row_data = mat2d_arena_alloc(scratch, sizeof(double) * mat2d_get_cols(mat));
+    if (row_data == NULL || inv_row_data == NULL) {
+        mat2d_arena_end(scratch);
         return -1;
     }
     while (row < mat2d_get_cols(mat)) {
         if (is_master) {
-            double diag = mat2d_get(mat, row_in_shard, row);
-            for (size_t j = 0; j < mat2d_get_cols(mat); j++) {
-                mat2d_set(mat, row_in_shard, j, mat2d_get(mat, row_in_shard, j) / diag);
-                mat2d_set(inv, row_in_shard, j, mat2d_get(inv, row_in_shard, j) / diag);
-            }
-            double *row_data = mat2d_get_row_ref(mat, row_in_shard);
-            MPI_Bcast(row_data, mat2d_get_cols(mat), MPI_DOUBLE, master_indx, MPI_COMM_WORLD);
-            double *inv_row_data = mat2d_get_row_ref(inv, row_in_shard);
-            MPI_Bcast(inv_row_data, mat2d_get_cols(mat), MPI_DOUBLE, master_indx, MPI_COMM_WORLD);
+            size_t cols = mat2d_get_cols(mat);
+            double *mat_row = mat2d_get_row_ref(mat, row_in_shard);
+            double *inv_row = mat2d_get_row_ref(inv, row_in_shard);
+            double rdiag = 1.0 / mat_row[row];
+            kern_scale(cols, rdiag, mat_row);
+            kern_scale(cols, rdiag, inv_row);
+            MPI_Bcast(mat_row, cols, MPI_DOUBLE, master_indx, MPI_COMM_WORLD);
+            MPI_Bcast(inv_row, cols, MPI_DOUBLE, master_indx, MPI_COMM_WORLD);
+            eliminate_rows(mat, inv, row, row_in_shard, mat_row, inv_row);
             row_in_shard += 1;
         } else {
             MPI_Bcast(row_data, mat2d_get_cols(mat), MPI_DOUBLE, master_indx, MPI_COMM_WORLD);
             MPI_Bcast(inv_row_data, mat2d_get_cols(mat), MPI_DOUBLE, master_indx, MPI_COMM_WORLD);
 
-            for (size_t i = 0; i < mat2d_get_rows(mat); i++) {
-                double factor = mat2d_get(mat, i, row) / row_data[row];
-                for (size_t j = 0; j < mat2d_get_cols(mat); j++) {
-                    double tmp1 = mat2d_get(mat, i, j) - factor * row_data[j];
-                    mat2d_set(mat, i, j, tmp1);
-                    double tmp2 = mat2d_get(inv, i, j) - factor * inv_row_data[j];
-                    mat2d_set(inv, i, j, tmp2);
-                }
-            }
+            eliminate_rows(mat, inv, row, SIZE_MAX, row_data, inv_row_data);
         }
 
         row += 1;
@@ -278,12 +326,126 @@ int mat2d_inv_MPI_v1(struct mat2d_inv_task *task) {
         is_master = master_indx == mat2d_app_get_rank();
     }
 
-    free(row_data);
-    free(inv_row_data);
+    mat2d_arena_end(scratch);
+
+    return 0;
+}
+
+// Ranks drive the broadcast in flight every this many rows of an update
+#define PIVOT_PROGRESS_ROWS 8
+
+// Normalizes pivot row k on its owner and starts broadcasting it from
+// there into buf on every rank. The forward part of row k is zero left
+// of column k, so buf holds columns k.. of it followed by the whole
+// inverse row, 2n - k doubles.
+static void pivot_start(
+    struct mat2d *mat,
+    struct mat2d *inv,
+    size_t k,
+    double *buf,
+    MPI_Request *req
+) {
+    size_t n = mat2d_get_cols(mat);
+    size_t owner = k % mat2d_app_get_size();
+    if (owner == (size_t)mat2d_app_get_rank()) {
+        size_t local = k / mat2d_app_get_size();
+        double *mat_row = mat2d_get_row_ref(mat, local);
+        double *inv_row = mat2d_get_row_ref(inv, local);
+        double rdiag = 1.0 / mat_row[k];
+        kern_scale(n - k, rdiag, mat_row + k);
+        kern_scale(n, rdiag, inv_row);
+        memcpy(buf, mat_row + k, sizeof(double) * (n - k));
+        memcpy(buf + n - k, inv_row, sizeof(double) * n);
+    }
+    MPI_Ibcast(buf, 2 * n - k, MPI_DOUBLE, owner, MPI_COMM_WORLD, req);
+}
+
+// Applies step k with a pivot row laid out by pivot_start to shard row i
+static void eliminate_row(
+    struct mat2d *mat,
+    struct mat2d *inv,
+    size_t i,
+    size_t k,
+    const double *pivot
+) {
+    size_t n = mat2d_get_cols(mat);
+    double *mat_row = mat2d_get_row_ref(mat, i);
+    double factor = mat_row[k];
+    if (factor != 0.0) {
+        kern_axpy(n - k, -factor, pivot, mat_row + k);
+        kern_axpy(n, -factor, pivot + n - k, mat2d_get_row_ref(inv, i));
+    }
+}
+
+// Pipelined v1: at step k the owner of row k + 1 updates and normalizes
+// that row first and starts its broadcast, which travels while every
+// rank applies step k to the rest of its rows. Only the first broadcast
+// is exposed; after it each step waits for a row sent one update ago.
+int mat2d_inv_MPI_v2(struct mat2d_inv_task *task) {
+    struct mat2d *mat = task->forward_mat;
+    struct mat2d *inv = task->reverse_mat;
+    size_t n = mat2d_get_cols(mat);
+    size_t global_size = mat2d_app_get_size();
+    size_t global_indx = mat2d_app_get_rank();
+
+    mat2d_arena *scratch = arena_scratch();
+    mat2d_arena_begin(scratch);
+    double *bufs[2];
+    bufs[0] = mat2d_arena_alloc(scratch, sizeof(double) * 2 * n);
+    bufs[1] = mat2d_arena_alloc(scratch, sizeof(double) * 2 * n);
+    if (bufs[0] == NULL || bufs[1] == NULL) {
+        mat2d_arena_end(scratch);
+        return -1;
+    }
 
+    MPI_Request reqs[2];
+    pivot_start(mat, inv, 0, bufs[0], &reqs[0]);
+    for (size_t k = 0; k < n; k++) {
+        const double *pivot = bufs[k % 2];
+        MPI_Request *next = &reqs[(k + 1) % 2];
+        MPI_Wait(&reqs[k % 2], MPI_STATUS_IGNORE);
+
+        // The pivot row is final; the lookahead row is already done
+        size_t skip = k % global_size == global_indx ? k / global_size : SIZE_MAX;
+        size_t ahead = SIZE_MAX;
+        if (k + 1 < n) {
+            if ((k + 1) % global_size == global_indx) {
+                ahead = (k + 1) / global_size;
+                eliminate_row(mat, inv, ahead, k, pivot);
+            }
+            pivot_start(mat, inv, k + 1, bufs[(k + 1) % 2], next);
+        } else {
+            *next = MPI_REQUEST_NULL;
+        }
+
+        for (size_t i = 0; i < mat2d_get_rows(mat); i++) {
+            if (i != skip && i != ahead) {
+                eliminate_row(mat, inv, i, k, pivot);
+            }
+            if (i % PIVOT_PROGRESS_ROWS == PIVOT_PROGRESS_ROWS - 1) {
+                int done;
+                MPI_Test(next, &done, MPI_STATUS_IGNORE);
+            }
+        }
+    }
+
+    mat2d_arena_end(scratch);
     return 0;
 }
 
+struct mat2d_inv_task* mat2d_app_create_task() {
+    return calloc(1, sizeof(struct mat2d_inv_task));
+}
+
+void mat2d_app_destroy_task(struct mat2d_inv_task *task) {
+    if (task == NULL) {
+        return;
+    }
+    mat2d_destroy(task->forward_mat);
+    mat2d_destroy(task->reverse_mat);
+    free(task);
+}
+
 struct mat2d* mat2d_app_get_forward_matrix(struct mat2d_inv_task *task) {
     return task->forward_mat;
 }
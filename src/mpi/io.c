@@ -0,0 +1,239 @@
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include <mpi.h>
+
+#include "libmatrix/app.h"
+#include "libmatrix/matrix.h"
+
+#include "../binfile.h"
+#include "io.h"
+
+struct io_layout {
+    size_t rows, cols;
+    size_t ld;
+    MPI_Offset data_offset;
+    // Versioned files are little-endian, legacy ones native
+    bool swap;
+};
+
+size_t mpi_io_owned_rows(size_t rows, size_t indx, size_t size) {
+    return rows / size + (indx < rows % size ? 1 : 0);
+}
+
+// Every rank reads the same header bytes, so every rank reaches the same
+// verdict without a broadcast
+static int io_read_layout(MPI_File fh, struct io_layout *lay) {
+    unsigned char buf[BINFILE_HEADER_SIZE] = { 0 };
+    MPI_Offset file_size;
+    MPI_Status status;
+    int got = 0;
+    if (MPI_File_get_size(fh, &file_size) != MPI_SUCCESS
+        || MPI_File_read_at_all(fh, 0, buf, sizeof(buf), MPI_BYTE, &status) != MPI_SUCCESS) {
+        return -1;
+    }
+    MPI_Get_count(&status, MPI_BYTE, &got);
+
+    struct binfile_header hdr;
+    if (got == sizeof(buf) && binfile_decode_header(&hdr, buf) == 0) {
+        size_t payload;
+        if (binfile_check_header(&hdr, file_size, &payload) != 0
+            || hdr.dtype != BINFILE_F64) {
+            return -1;
+        }
+        lay->rows = hdr.rows;
+        lay->cols = hdr.cols;
+        lay->ld = hdr.ld;
+        lay->data_offset = hdr.data_offset;
+        lay->swap = true;
+        return 0;
+    }
+
+    // Pre-versioned files: native size_t rows and cols, then the dense payload
+    size_t dims[2];
+    if (got < (int)sizeof(dims)) {
+        return -1;
+    }
+    memcpy(dims, buf, sizeof(dims));
+    size_t capacity = (file_size - sizeof(dims)) / sizeof(double);
+    if (dims[1] != 0 && dims[0] > capacity / dims[1]) {
+        return -1;
+    }
+    lay->rows = dims[0];
+    lay->cols = dims[1];
+    lay->ld = dims[1];
+    lay->data_offset = sizeof(dims);
+    lay->swap = false;
+    return 0;
+}
+
+// A failure on any rank fails the call on all of them, so no rank is
+// left waiting in a collective the others skipped
+static int io_agree(int rc) {
+    int all = 0;
+    MPI_Allreduce(&rc, &all, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    return all;
+}
+
+// The file type is one row padded to size rows, so the view of rank indx
+// tiles over rows indx, indx + size, ... of the payload. Returns the
+// memory type of one shard row for a shard with pitch ld.
+static MPI_Datatype io_set_cyclic_view(
+    MPI_File fh,
+    const struct io_layout *lay,
+    size_t ld,
+    size_t indx,
+    size_t size
+) {
+    MPI_Datatype row, file_type, mem_type;
+    MPI_Type_contiguous(lay->cols, MPI_DOUBLE, &row);
+    MPI_Type_create_resized(row, 0, sizeof(double) * lay->ld * size, &file_type);
+    MPI_Type_create_resized(row, 0, sizeof(double) * ld, &mem_type);
+    MPI_Type_commit(&file_type);
+    MPI_Type_commit(&mem_type);
+    MPI_Type_free(&row);
+
+    MPI_File_set_view(
+        fh, lay->data_offset + sizeof(double) * lay->ld * indx,
+        MPI_DOUBLE, file_type, "native", MPI_INFO_NULL
+    );
+    MPI_Type_free(&file_type);
+    return mem_type;
+}
+
+static void io_swap_rows(struct mat2d *shard, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        binfile_swap_words(mat2d_get_row_ref(shard, i), mat2d_get_cols(shard));
+    }
+}
+
+int mat2d_read_cyclic_mpi(
+    struct mat2d **out,
+    size_t *global_rows,
+    const char *filename
+) {
+    size_t size = mat2d_app_get_size();
+    size_t indx = mat2d_app_get_rank();
+
+    MPI_File fh;
+    if (MPI_File_open(
+            MPI_COMM_WORLD, (char *)filename,
+            MPI_MODE_RDONLY, MPI_INFO_NULL, &fh
+        ) != MPI_SUCCESS) {
+        return -1;
+    }
+
+    struct io_layout lay;
+    int rc = io_read_layout(fh, &lay);
+    size_t shard_rows = 0;
+    if (rc == 0) {
+        shard_rows = (lay.rows + size - 1) / size;
+        if (lay.rows == 0 || lay.cols == 0
+            || lay.cols > INT_MAX || shard_rows > INT_MAX) {
+            rc = -1;
+        }
+    }
+
+    struct mat2d *shard = NULL;
+    if (rc == 0) {
+        shard = mat2d_create(shard_rows, lay.cols);
+        rc = shard != NULL ? 0 : -1;
+    }
+    if (io_agree(rc) != 0) {
+        mat2d_destroy(shard);
+        MPI_File_close(&fh);
+        return -1;
+    }
+
+    size_t owned = mpi_io_owned_rows(lay.rows, indx, size);
+    MPI_Datatype mem_type = io_set_cyclic_view(fh, &lay, mat2d_get_ld(shard), indx, size);
+    MPI_Status status;
+    rc = MPI_File_read_all(
+        fh, mat2d_get_data(shard), owned, mem_type, &status
+    ) == MPI_SUCCESS ? 0 : -1;
+    MPI_Type_free(&mem_type);
+    MPI_File_close(&fh);
+
+    if (rc == 0 && lay.swap) {
+        io_swap_rows(shard, owned);
+    }
+    if (io_agree(rc) != 0) {
+        mat2d_destroy(shard);
+        return -1;
+    }
+
+    *out = shard;
+    *global_rows = lay.rows;
+    return 0;
+}
+
+int mat2d_write_cyclic_mpi(
+    struct mat2d *shard,
+    size_t global_rows,
+    const char *filename
+) {
+    size_t size = mat2d_app_get_size();
+    size_t indx = mat2d_app_get_rank();
+    size_t owned = mpi_io_owned_rows(global_rows, indx, size);
+    assert(owned <= mat2d_get_rows(shard));
+
+    struct io_layout lay = {
+        .rows = global_rows,
+        .cols = mat2d_get_cols(shard),
+        .ld = mat2d_get_cols(shard),
+        .data_offset = BINFILE_HEADER_SIZE,
+        .swap = true,
+    };
+
+    MPI_File fh;
+    if (MPI_File_open(
+            MPI_COMM_WORLD, (char *)filename,
+            MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh
+        ) != MPI_SUCCESS) {
+        return -1;
+    }
+
+    // Sizing the file up front drops the tail of an older, larger file
+    int rc = MPI_File_set_size(
+        fh, lay.data_offset + sizeof(double) * lay.rows * lay.ld
+    ) == MPI_SUCCESS ? 0 : -1;
+    if (rc == 0 && indx == (size_t)mat2d_app_get_root_indx()) {
+        struct binfile_header hdr = {
+            .version = BINFILE_VERSION,
+            .dtype = BINFILE_F64,
+            .flags = 0,
+            .rows = lay.rows,
+            .cols = lay.cols,
+            .ld = lay.ld,
+            .data_offset = lay.data_offset,
+            .checksum = 0,
+        };
+        unsigned char buf[BINFILE_HEADER_SIZE];
+        binfile_encode_header(&hdr, buf);
+        MPI_Status status;
+        rc = MPI_File_write_at(
+            fh, 0, buf, sizeof(buf), MPI_BYTE, &status
+        ) == MPI_SUCCESS ? 0 : -1;
+    }
+    if (io_agree(rc) != 0) {
+        MPI_File_close(&fh);
+        return -1;
+    }
+
+    // The shard is written in file byte order and restored afterwards
+    io_swap_rows(shard, owned);
+    MPI_Datatype mem_type = io_set_cyclic_view(fh, &lay, mat2d_get_ld(shard), indx, size);
+    MPI_Status status;
+    rc = MPI_File_write_all(
+        fh, mat2d_get_data(shard), owned, mem_type, &status
+    ) == MPI_SUCCESS ? 0 : -1;
+    MPI_Type_free(&mem_type);
+    io_swap_rows(shard, owned);
+
+    if (MPI_File_close(&fh) != MPI_SUCCESS) {
+        rc = -1;
+    }
+    return io_agree(rc);
+}
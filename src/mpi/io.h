@@ -0,0 +1,35 @@
+#ifndef MPI_IO_H
+#define MPI_IO_H
+
+#include <stddef.h>
+
+#include "libmatrix/matrix.h"
+
+// Cyclic row shards read and written straight from a binary matrix file
+// with MPI-IO. Rank r owns global rows r, r + size, r + 2 * size, ...;
+// a shard has ceil(rows / size) rows, the missing last row zeroed, as
+// produced by mad2d_app_redistribute_matrix. All calls are collective
+// over MPI_COMM_WORLD and fail on every rank or on none.
+
+// Rows of the global matrix owned by rank indx
+size_t mpi_io_owned_rows(size_t rows, size_t indx, size_t size);
+
+// Reads this rank's shard of a versioned or legacy binary file and
+// stores the global row count. The root never holds more than its own
+// shard. The checksum of a versioned file is not verified: it runs over
+// the whole payload in order.
+int mat2d_read_cyclic_mpi(
+    struct mat2d **out,
+    size_t *global_rows,
+    const char *filename
+);
+
+// Writes the shards of a global_rows x cols matrix as one versioned
+// file without checksum, each rank filling its own rows
+int mat2d_write_cyclic_mpi(
+    struct mat2d *shard,
+    size_t global_rows,
+    const char *filename
+);
+
+#endif
@@ -0,0 +1,661 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <locale.h>
+#include <pthread.h>
+
+#include "numfmt.h"
+
+// Longest token handed to the strtod fallback
+#define NUMFMT_TOKEN_MAX 128
+
+// Significant decimal digits that fit a uint64_t
+#define NUMFMT_MAX_DIGITS 19
+
+// Decimal exponents of the Eisel-Lemire table. Inside this range the
+// 128-bit power of five is exact (q >= 0) or precise enough (q < 0) that
+// the algorithm never has to give up.
+#define NUMFMT_POW5_MIN (-27)
+#define NUMFMT_POW5_MAX 55
+
+static const double numfmt_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+typedef unsigned __int128 u128;
+
+// 5^q normalized so that bit 127 is set: truncated for q >= 0, and
+// floor(2^b / 5^-q) + 1 for q < 0
+static u128 numfmt_pow5[NUMFMT_POW5_MAX - NUMFMT_POW5_MIN + 1];
+static locale_t numfmt_c_locale;
+static pthread_once_t numfmt_once = PTHREAD_ONCE_INIT;
+
+static int clz128(u128 x) {
+    uint64_t hi = (uint64_t)(x >> 64);
+    return hi != 0 ? __builtin_clzll(hi) : 64 + __builtin_clzll((uint64_t)x);
+}
+
+static void numfmt_init(void) {
+    numfmt_c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+
+    u128 p = 1;
+    for (int q = 0; q <= NUMFMT_POW5_MAX; q++) {
+        numfmt_pow5[q - NUMFMT_POW5_MIN] = p << clz128(p);
+        p *= 5;
+    }
+
+    uint64_t d = 1;
+    for (int q = -1; q >= NUMFMT_POW5_MIN; q--) {
+        d *= 5;
+        int z = 0;
+        while ((UINT64_C(1) << z) < d) {
+            z++;
+        }
+        // Long division of 2^(z + 127) by d, one quotient bit at a time
+        u128 quot = 0;
+        uint64_t rem = 0;
+        for (int bit = z + 127; bit >= 0; bit--) {
+            rem = 2 * rem + (bit == z + 127);
+            quot <<= 1;
+            if (rem >= d) {
+                rem -= d;
+                quot |= 1;
+            }
+        }
+        numfmt_pow5[q - NUMFMT_POW5_MIN] = quot + 1;
+    }
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Eight ASCII digits at once (SWAR), little-endian byte order
+static bool is_8digits(uint64_t v) {
+    return (((v & UINT64_C(0xF0F0F0F0F0F0F0F0))
+        | (((v + UINT64_C(0x0606060606060606)) & UINT64_C(0xF0F0F0F0F0F0F0F0)) >> 4))
+        == UINT64_C(0x3333333333333333));
+}
+
+static uint64_t parse_8digits(uint64_t v) {
+    v -= UINT64_C(0x3030303030303030);
+    v = v * 10 + (v >> 8);
+    v = ((v & UINT64_C(0x000000FF000000FF)) * (100 + (UINT64_C(1000000) << 32))
+        + ((v >> 16) & UINT64_C(0x000000FF000000FF)) * (1 + (UINT64_C(10000) << 32))) >> 32;
+    return v;
+}
+
+// Eisel-Lemire: w * 10^q rounded to nearest-even, for w != 0 and q in
+// the table range. Returns false when the result would be subnormal or
+// infinite, which the caller leaves to strtod.
+static bool numfmt_eisel_lemire(uint64_t w, int q, double *out) {
+    u128 t = numfmt_pow5[q - NUMFMT_POW5_MIN];
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+
+    u128 first = (u128)w * (uint64_t)(t >> 64);
+    uint64_t hi = (uint64_t)(first >> 64);
+    uint64_t lo = (uint64_t)first;
+    if ((hi & 0x1FF) == 0x1FF) {
+        u128 second = (u128)w * (uint64_t)t;
+        uint64_t carry_in = (uint64_t)(second >> 64);
+        lo += carry_in;
+        if (lo < carry_in) {
+            hi++;
+        }
+    }
+
+    int upperbit = (int)(hi >> 63);
+    uint64_t mantissa = hi >> (upperbit + 9);
+    int power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz + 1023;
+    if (power2 <= 0) {
+        return false;
+    }
+
+    // Exactly halfway: round to even instead of up
+    if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1
+        && (mantissa << (upperbit + 9)) == hi) {
+        mantissa &= ~UINT64_C(1);
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (UINT64_C(2) << 52)) {
+        mantissa = UINT64_C(1) << 52;
+        power2++;
+    }
+    mantissa &= ~(UINT64_C(1) << 52);
+    if (power2 >= 0x7FF) {
+        return false;
+    }
+
+    uint64_t bits = mantissa | (uint64_t)power2 << 52;
+    memcpy(out, &bits, sizeof(*out));
+    return true;
+}
+
+// Everything else (more than 19 digits, far exponents, subnormals,
+// nan, inf) goes through strtod, pinned to the C locale
+static const char *numfmt_parse_slow(const char *p, const char *end, double *out) {
+    size_t len = 0;
+    while (p + len < end && len < NUMFMT_TOKEN_MAX - 1
+           && (is_digit(p[len]) || strchr("+-.eEnNaAiIfFtTyY", p[len]) != NULL)) {
+        len++;
+    }
+    if (len == 0) {
+        return NULL;
+    }
+    char buf[NUMFMT_TOKEN_MAX];
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+
+    char *stop;
+    *out = strtod_l(buf, &stop, numfmt_c_locale);
+    if (stop == buf) {
+        return NULL;
+    }
+    return p + (stop - buf);
+}
+
+const char *numfmt_parse(const char *p, const char *end, double *out) {
+    pthread_once(&numfmt_once, numfmt_init);
+
+    const char *start = p;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        p++;
+    }
+
+    uint64_t mant = 0;
+    int digits = 0;
+    int exp10 = 0;
+    bool any = false;
+    bool truncated = false;
+    for (; p < end && is_digit(*p); p++) {
+        any = true;
+        if (digits < NUMFMT_MAX_DIGITS) {
+            mant = mant * 10 + (*p - '0');
+            digits += mant != 0;
+        } else {
+            truncated |= *p != '0';
+            exp10++;
+        }
+    }
+    if (p < end && *p == '.') {
+        p++;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // Past the leading zeros, whole groups of eight digits while they
+        // still fit the mantissa
+        while (mant != 0 && digits + 8 <= NUMFMT_MAX_DIGITS && end - p >= 8) {
+            uint64_t chunk;
+            memcpy(&chunk, p, sizeof(chunk));
+            if (!is_8digits(chunk)) {
+                break;
+            }
+            mant = mant * 100000000 + parse_8digits(chunk);
+            digits += 8;
+            exp10 -= 8;
+            p += 8;
+        }
+#endif
+        for (; p < end && is_digit(*p); p++) {
+            any = true;
+            if (digits < NUMFMT_MAX_DIGITS) {
+                mant = mant * 10 + (*p - '0');
+                digits += mant != 0;
+                exp10--;
+            } else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if (!any) {
+        return numfmt_parse_slow(start, end, out);
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *e_start = p;
+        p++;
+        bool eneg = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            eneg = *p == '-';
+            p++;
+        }
+        if (p == end || !is_digit(*p)) {
+            // Not an exponent after all
+            p = e_start;
+        } else {
+            int e = 0;
+            for (; p < end && is_digit(*p); p++) {
+                if (e < 100000) {
+                    e = e * 10 + (*p - '0');
+                }
+            }
+            exp10 += eneg ? -e : e;
+        }
+    }
+
+    double v;
+    if (mant == 0) {
+        v = 0.0;
+    } else if (truncated) {
+        return numfmt_parse_slow(start, end, out);
+    } else if (mant <= (UINT64_C(1) << 53) && exp10 >= -22 && exp10 <= 22) {
+        // Clinger: both operands exact, so one rounding
+        v = (double)mant;
+        v = exp10 >= 0 ? v * numfmt_pow10[exp10] : v / numfmt_pow10[-exp10];
+    } else if (exp10 < NUMFMT_POW5_MIN || exp10 > NUMFMT_POW5_MAX
+               || !numfmt_eisel_lemire(mant, exp10, &v)) {
+        return numfmt_parse_slow(start, end, out);
+    }
+    *out = neg ? -v : v;
+    return p;
+}
+
+// Shortest round-trip formatting after Ulf Adams' Ryu (PLDI 2018). The
+// two 125-bit power-of-five tables are computed once at first use with a
+// small bignum instead of being shipped as constants.
+
+#define RYU_POW5_BITCOUNT 125
+#define RYU_POW5_INV_BITCOUNT 125
+#define RYU_POW5_TABLE_SIZE 326
+#define RYU_POW5_INV_TABLE_SIZE 342
+
+// 32-bit limbs, enough for 5^341 (under 800 bits)
+#define BIG_LIMBS 26
+
+struct big {
+    uint32_t limb[BIG_LIMBS];
+};
+
+static u128 ryu_pow5[RYU_POW5_TABLE_SIZE];
+static u128 ryu_pow5_inv[RYU_POW5_INV_TABLE_SIZE];
+static pthread_once_t ryu_once = PTHREAD_ONCE_INIT;
+
+static int big_bitlength(const struct big *b) {
+    for (int i = BIG_LIMBS - 1; i >= 0; i--) {
+        if (b->limb[i] != 0) {
+            return 32 * i + 32 - __builtin_clz(b->limb[i]);
+        }
+    }
+    return 0;
+}
+
+static int big_bit(const struct big *b, int pos) {
+    return pos >= 0 && pos < 32 * BIG_LIMBS ? (b->limb[pos / 32] >> (pos % 32)) & 1 : 0;
+}
+
+static void big_mul_small(struct big *b, uint32_t m) {
+    uint64_t carry = 0;
+    for (int i = 0; i < BIG_LIMBS; i++) {
+        uint64_t v = (uint64_t)b->limb[i] * m + carry;
+        b->limb[i] = (uint32_t)v;
+        carry = v >> 32;
+    }
+}
+
+static void big_shl1(struct big *b) {
+    for (int i = BIG_LIMBS - 1; i > 0; i--) {
+        b->limb[i] = b->limb[i] << 1 | b->limb[i - 1] >> 31;
+    }
+    b->limb[0] <<= 1;
+}
+
+static int big_cmp(const struct big *a, const struct big *b) {
+    for (int i = BIG_LIMBS - 1; i >= 0; i--) {
+        if (a->limb[i] != b->limb[i]) {
+            return a->limb[i] < b->limb[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static void big_sub(struct big *a, const struct big *b) {
+    int64_t borrow = 0;
+    for (int i = 0; i < BIG_LIMBS; i++) {
+        int64_t v = (int64_t)a->limb[i] - b->limb[i] - borrow;
+        borrow = v < 0;
+        a->limb[i] = (uint32_t)v;
+    }
+}
+
+static void ryu_init(void) {
+    struct big pow = { { 1 } };
+    for (int i = 0; i < RYU_POW5_INV_TABLE_SIZE; i++) {
+        int len = big_bitlength(&pow);
+
+        // Top RYU_POW5_BITCOUNT bits of 5^i, truncated
+        if (i < RYU_POW5_TABLE_SIZE) {
+            u128 v = 0;
+            int low = len - RYU_POW5_BITCOUNT;
+            for (int pos = len - 1; pos >= low; pos--) {
+                v = v << 1 | big_bit(&pow, pos);
+            }
+            ryu_pow5[i] = v;
+        }
+
+        // floor(2^(len - 1 + RYU_POW5_INV_BITCOUNT) / 5^i) + 1. The first
+        // len - 1 quotient bits are zero since 2^(len - 1) <= 5^i.
+        struct big rem = { { 0 } };
+        rem.limb[(len - 1) / 32] = UINT32_C(1) << ((len - 1) % 32);
+        u128 q = 0;
+        for (int step = 0; step <= RYU_POW5_INV_BITCOUNT; step++) {
+            if (step > 0) {
+                big_shl1(&rem);
+            }
+            q <<= 1;
+            if (big_cmp(&rem, &pow) >= 0) {
+                big_sub(&rem, &pow);
+                q |= 1;
+            }
+        }
+        ryu_pow5_inv[i] = q + 1;
+
+        big_mul_small(&pow, 5);
+    }
+}
+
+// ceil(log2(5^e)), and 1 for e == 0
+static int pow5bits(int e) {
+    return (int)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+static uint32_t log10_pow2(int e) {
+    return ((uint32_t)e * 78913) >> 18;
+}
+
+static uint32_t log10_pow5(int e) {
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+static uint32_t pow5_factor(uint64_t value) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count;
+}
+
+static bool multiple_of_pow5(uint64_t value, uint32_t p) {
+    return pow5_factor(value) >= p;
+}
+
+static bool multiple_of_pow2(uint64_t value, uint32_t p) {
+    return (value & ((UINT64_C(1) << p) - 1)) == 0;
+}
+
+static uint64_t mul_shift64(uint64_t m, u128 mul, int j) {
+    u128 b0 = (u128)m * (uint64_t)mul;
+    u128 b2 = (u128)m * (uint64_t)(mul >> 64);
+    return (uint64_t)(((b0 >> 64) + b2) >> (j - 64));
+}
+
+// Shortest decimal m * 10^e that reads back as the double with the given
+// IEEE fields; the nearest one when there are several
+static void ryu_d2d(uint64_t ieee_mantissa, uint32_t ieee_exponent, uint64_t *m, int *e) {
+    int e2;
+    uint64_t m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - 1023 - 52 - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (int)ieee_exponent - 1023 - 52 - 2;
+        m2 = (UINT64_C(1) << 52) | ieee_mantissa;
+    }
+    bool accept_bounds = (m2 & 1) == 0;
+
+    // The halfway points to the neighbours are mv + 2 and mv - 1 - mm_shift
+    uint64_t mv = 4 * m2;
+    uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    uint64_t vr, vp, vm;
+    int e10;
+    bool vm_trailing_zeros = false;
+    bool vr_trailing_zeros = false;
+    if (e2 >= 0) {
+        uint32_t q = log10_pow2(e2) - (e2 > 3);
+        e10 = (int)q;
+        int k = RYU_POW5_INV_BITCOUNT + pow5bits(q) - 1;
+        int i = -e2 + (int)q + k;
+        vr = mul_shift64(4 * m2, ryu_pow5_inv[q], i);
+        vp = mul_shift64(4 * m2 + 2, ryu_pow5_inv[q], i);
+        vm = mul_shift64(4 * m2 - 1 - mm_shift, ryu_pow5_inv[q], i);
+        if (q <= 21) {
+            // At most one of mp, mv and mm is a multiple of 5
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        uint32_t q = log10_pow5(-e2) - (-e2 > 1);
+        e10 = (int)q + e2;
+        int i = -e2 - (int)q;
+        int k = pow5bits(i) - RYU_POW5_BITCOUNT;
+        int j = (int)q - k;
+        vr = mul_shift64(4 * m2, ryu_pow5[i], j);
+        vp = mul_shift64(4 * m2 + 2, ryu_pow5[i], j);
+        vm = mul_shift64(4 * m2 - 1 - mm_shift, ryu_pow5[i], j);
+        if (q <= 1) {
+            // mv = 4 * m2 always has two trailing zero bits
+            vr_trailing_zeros = true;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vr_trailing_zeros = multiple_of_pow2(mv, q);
+        }
+    }
+
+    // Drop digits while the interval still holds a shorter number
+    int removed = 0;
+    uint64_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        uint32_t last_removed = 0;
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0) {
+            // Exactly halfway: round to even
+            last_removed = 4;
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed >= 5);
+    } else {
+        // Common case: no exact trailing zeros to track
+        bool round_up = false;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    *m = output;
+    *e = e10 + removed;
+}
+
+static int decimal_length(uint64_t v) {
+    int n = 1;
+    while (v >= 10) {
+        v /= 10;
+        n++;
+    }
+    return n;
+}
+
+// digits[0..n) with the decimal point after digit point_pos + 1, in the
+// style of Python's repr: positional for exponents -4..15, otherwise
+// d.ddde+XX
+static size_t numfmt_layout(bool neg, const char *digits, int n, int exp10, char *buf) {
+    char *p = buf;
+    if (neg) {
+        *p++ = '-';
+    }
+    if (exp10 >= -4 && exp10 < 16) {
+        if (exp10 < 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int i = 0; i < -exp10 - 1; i++) {
+                *p++ = '0';
+            }
+            memcpy(p, digits, n);
+            p += n;
+        } else if (exp10 + 1 >= n) {
+            memcpy(p, digits, n);
+            p += n;
+            for (int i = n; i <= exp10; i++) {
+                *p++ = '0';
+            }
+        } else {
+            memcpy(p, digits, exp10 + 1);
+            p += exp10 + 1;
+            *p++ = '.';
+            memcpy(p, digits + exp10 + 1, n - exp10 - 1);
+            p += n - exp10 - 1;
+        }
+    } else {
+        *p++ = digits[0];
+        if (n > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, n - 1);
+            p += n - 1;
+        }
+        *p++ = 'e';
+        *p++ = exp10 < 0 ? '-' : '+';
+        int ae = exp10 < 0 ? -exp10 : exp10;
+        if (ae >= 100) {
+            *p++ = '0' + ae / 100;
+        }
+        *p++ = '0' + ae / 10 % 10;
+        *p++ = '0' + ae % 10;
+    }
+    return p - buf;
+}
+
+// Correctly rounded text through snprintf pinned to the C locale
+static size_t numfmt_format_slow(double v, int precision, char *buf) {
+    pthread_once(&numfmt_once, numfmt_init);
+    char tmp[64];
+    locale_t old = uselocale(numfmt_c_locale);
+    int len = snprintf(tmp, sizeof(tmp), "%.*e", precision - 1, v);
+    uselocale(old);
+
+    // Back to digits and exponent, so the layout matches the fast path
+    char digits[NUMFMT_MAX_CHARS];
+    int n = 0;
+    const char *p = tmp;
+    bool neg = *p == '-';
+    p += neg;
+    for (; *p != 'e' && p < tmp + len; p++) {
+        if (is_digit(*p)) {
+            digits[n++] = *p;
+        }
+    }
+    int exp10 = atoi(p + 1);
+    while (n > 1 && digits[n - 1] == '0') {
+        n--;
+    }
+    return numfmt_layout(neg, digits, n, exp10, buf);
+}
+
+size_t numfmt_format(double v, int precision, char *buf) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    bool neg = bits >> 63;
+    uint64_t ieee_mantissa = bits & ((UINT64_C(1) << 52) - 1);
+    uint32_t ieee_exponent = (uint32_t)(bits >> 52) & 0x7FF;
+
+    if (ieee_exponent == 0x7FF) {
+        const char *text = ieee_mantissa != 0 ? "nan" : neg ? "-inf" : "inf";
+        size_t len = strlen(text);
+        memcpy(buf, text, len);
+        return len;
+    }
+    if (ieee_exponent == 0 && ieee_mantissa == 0) {
+        return numfmt_layout(neg, "0", 1, 0, buf);
+    }
+
+    pthread_once(&ryu_once, ryu_init);
+    uint64_t m;
+    int e;
+    ryu_d2d(ieee_mantissa, ieee_exponent, &m, &e);
+
+    char digits[NUMFMT_MAX_CHARS];
+    int n = decimal_length(m);
+    for (int i = n - 1; i >= 0; i--) {
+        digits[i] = '0' + m % 10;
+        m /= 10;
+    }
+    int exp10 = e + n - 1;
+    while (n > 1 && digits[n - 1] == '0') {
+        n--;
+    }
+
+    // Up to 15 digits the shortest text rounds the same way as the exact
+    // value. Padding beyond that, and exact ties on the first dropped
+    // digit, need the exact value.
+    if (precision > 15 && n < precision) {
+        return numfmt_format_slow(v, precision, buf);
+    }
+    if (precision > 0 && n > precision) {
+        bool tie = digits[precision] == '5';
+        for (int i = precision + 1; i < n && tie; i++) {
+            tie = digits[i] == '0';
+        }
+        if (tie) {
+            return numfmt_format_slow(v, precision, buf);
+        }
+        n = precision;
+        if (digits[precision] >= '5') {
+            int i = n - 1;
+            while (i >= 0 && digits[i] == '9') {
+                digits[i--] = '0';
+            }
+            if (i < 0) {
+                digits[0] = '1';
+                exp10++;
+            } else {
+                digits[i]++;
+            }
+        }
+        while (n > 1 && digits[n - 1] == '0') {
+            n--;
+        }
+    }
+    return numfmt_layout(neg, digits, n, exp10, buf);
+}
@@ -0,0 +1,23 @@
+#ifndef NUMFMT_H
+#define NUMFMT_H
+
+#include <stddef.h>
+
+// Locale-independent conversion between doubles and decimal text
+
+// Parses the number at the start of [p, end): optional sign, digits with
+// an optional '.', optional exponent, or nan/inf. Correctly rounded.
+// Returns the first character after the number, or NULL if p does not
+// start with one.
+const char *numfmt_parse(const char *p, const char *end, double *out);
+
+// Longest text numfmt_format produces, e.g. -2.2250738585072014e-308
+#define NUMFMT_MAX_CHARS 24
+
+// Writes v to buf without a terminator and returns the length. Precision
+// 0 gives the shortest text that numfmt_parse (or strtod) reads back as
+// exactly v; otherwise at most that many significant digits, correctly
+// rounded. Positional notation for exponents -4..15, scientific beyond.
+size_t numfmt_format(double v, int precision, char *buf);
+
+#endif
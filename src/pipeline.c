@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "libmatrix/matrix.h"
+
+// One matrix on its way through the stages. A NULL mat is a job whose
+// read or compute failed; it still flows on so the writer sees every
+// index in order.
+struct pipe_job {
+    size_t index;
+    struct mat2d *mat;
+};
+
+// Bounded FIFO of jobs between two stages
+struct pipe_queue {
+    struct pipe_job *items;
+    size_t cap, head, count;
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+};
+
+struct pipe_ctx {
+    const char *const *inputs;
+    const char *const *outputs;
+    size_t count;
+    unsigned flags;
+    mat2d_pipeline_fn compute;
+    void *arg;
+    struct pipe_queue read_q, write_q;
+    struct mat2d_pipeline_stats *stats;
+};
+
+static double pipe_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t pipe_file_size(const char *filename) {
+    struct stat st;
+    return stat(filename, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static int pipe_queue_init(struct pipe_queue *q, size_t cap) {
+    q->items = malloc(sizeof(struct pipe_job) * cap);
+    if (q->items == NULL) {
+        return -1;
+    }
+    q->cap = cap;
+    q->head = 0;
+    q->count = 0;
+    q->closed = false;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return 0;
+}
+
+static void pipe_queue_destroy(struct pipe_queue *q) {
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+}
+
+static void pipe_queue_push(struct pipe_queue *q, struct pipe_job job) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->cap) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    q->items[(q->head + q->count) % q->cap] = job;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// No more pushes; pops drain what is left and then fail
+static void pipe_queue_close(struct pipe_queue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static bool pipe_queue_pop(struct pipe_queue *q, struct pipe_job *job) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    bool ok = q->count > 0;
+    if (ok) {
+        *job = q->items[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static void *pipe_reader(void *arg) {
+    struct pipe_ctx *ctx = arg;
+    struct mat2d_pipeline_stage *st = &ctx->stats->read;
+    for (size_t i = 0; i < ctx->count; i++) {
+        double start = pipe_now();
+        struct pipe_job job = { i, NULL };
+        int rc = (ctx->flags & MAT2D_PIPE_TEXT_IN)
+            ? mat2d_read_from_file(&job.mat, ctx->inputs[i])
+            : mat2d_read_from_binfile(&job.mat, ctx->inputs[i]);
+        if (rc != 0) {
+            job.mat = NULL;
+        } else {
+            st->jobs++;
+            st->bytes += pipe_file_size(ctx->inputs[i]);
+        }
+        st->seconds += pipe_now() - start;
+        pipe_queue_push(&ctx->read_q, job);
+    }
+    pipe_queue_close(&ctx->read_q);
+    return NULL;
+}
+
+static void *pipe_writer(void *arg) {
+    struct pipe_ctx *ctx = arg;
+    struct mat2d_pipeline_stage *st = &ctx->stats->write;
+    struct pipe_job job;
+    while (pipe_queue_pop(&ctx->write_q, &job)) {
+        if (job.mat == NULL) {
+            continue;
+        }
+        double start = pipe_now();
+        const char *filename = ctx->outputs[job.index];
+        int rc = (ctx->flags & MAT2D_PIPE_TEXT_OUT)
+            ? mat2d_write_to_text_file(job.mat, filename)
+            : mat2d_write_to_binfile(job.mat, filename);
+        mat2d_destroy(job.mat);
+        if (rc == 0) {
+            st->jobs++;
+            st->bytes += pipe_file_size(filename);
+        }
+        st->seconds += pipe_now() - start;
+    }
+    return NULL;
+}
+
+static int pipe_inv(struct mat2d **out, struct mat2d *in, void *arg) {
+    (void)arg;
+    return mat2d_inv(out, in);
+}
+
+// Runs the compute stage on the calling thread, between a reader and a
+// writer thread; the queues bound the matrices alive at once to about
+// twice the depth plus one per stage
+int mat2d_pipeline_run(
+    const char *const *inputs,
+    const char *const *outputs,
+    size_t count,
+    mat2d_pipeline_fn compute, void *arg,
+    size_t depth,
+    unsigned flags,
+    struct mat2d_pipeline_stats *stats
+) {
+    struct mat2d_pipeline_stats local;
+    struct pipe_ctx ctx = {
+        .inputs = inputs,
+        .outputs = outputs,
+        .count = count,
+        .flags = flags,
+        .compute = compute != NULL ? compute : pipe_inv,
+        .arg = arg,
+        .stats = stats != NULL ? stats : &local,
+    };
+    *ctx.stats = (struct mat2d_pipeline_stats){ 0 };
+    depth = depth > 0 ? depth : 1;
+
+    if (pipe_queue_init(&ctx.read_q, depth) != 0) {
+        return -1;
+    }
+    if (pipe_queue_init(&ctx.write_q, depth) != 0) {
+        pipe_queue_destroy(&ctx.read_q);
+        return -1;
+    }
+
+    double start = pipe_now();
+    pthread_t reader, writer;
+    int rc = 0;
+    if (pthread_create(&writer, NULL, pipe_writer, &ctx) != 0) {
+        rc = -1;
+    } else if (pthread_create(&reader, NULL, pipe_reader, &ctx) != 0) {
+        pipe_queue_close(&ctx.write_q);
+        pthread_join(writer, NULL);
+        rc = -1;
+    }
+    if (rc != 0) {
+        pipe_queue_destroy(&ctx.write_q);
+        pipe_queue_destroy(&ctx.read_q);
+        return -1;
+    }
+
+    struct mat2d_pipeline_stage *st = &ctx.stats->compute;
+    struct pipe_job job;
+    while (pipe_queue_pop(&ctx.read_q, &job)) {
+        if (job.mat != NULL) {
+            double t0 = pipe_now();
+            struct mat2d *result = NULL;
+            if (ctx.compute(&result, job.mat, ctx.arg) != 0) {
+                result = NULL;
+            } else {
+                st->jobs++;
+            }
+            mat2d_destroy(job.mat);
+            job.mat = result;
+            st->seconds += pipe_now() - t0;
+        }
+        pipe_queue_push(&ctx.write_q, job);
+    }
+    pipe_queue_close(&ctx.write_q);
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+    ctx.stats->wall_seconds = pipe_now() - start;
+
+    pipe_queue_destroy(&ctx.write_q);
+    pipe_queue_destroy(&ctx.read_q);
+    return ctx.stats->write.jobs == count ? 0 : -1;
+}
+
+static void pipe_print_stage(
+    FILE *file,
+    const char *name,
+    const struct mat2d_pipeline_stage *st
+) {
+    double rate = st->seconds > 0 ? st->jobs / st->seconds : 0;
+    double mbps = st->seconds > 0 ? st->bytes / st->seconds / 1e6 : 0;
+    fprintf(
+        file, "%-8s %6zu jobs %9.3f s busy %9.2f jobs/s",
+        name, st->jobs, st->seconds, rate
+    );
+    if (st->bytes > 0) {
+        fprintf(file, " %9.1f MB/s", mbps);
+    }
+    fprintf(file, "\n");
+}
+
+void mat2d_pipeline_print_stats(const struct mat2d_pipeline_stats *stats, FILE *file) {
+    pipe_print_stage(file, "read", &stats->read);
+    pipe_print_stage(file, "compute", &stats->compute);
+    pipe_print_stage(file, "write", &stats->write);
+
+    // Stage times add up to the serial run; the shorter the wall time
+    // against that sum, the more I/O the pipeline hid
+    double busy = stats->read.seconds + stats->compute.seconds + stats->write.seconds;
+    fprintf(
+        file, "wall     %9.3f s for %.3f s of stage work\n",
+        stats->wall_seconds, busy
+    );
+}
@@ -0,0 +1,153 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <immintrin.h>
+
+#include "cpu.h"
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+// Each 128-bit Philox block yields two doubles
+#define RNG_PER_BLOCK 2
+
+typedef void (*rng_blocks_fn)(uint64_t seed, uint64_t block, size_t nblocks, double *out);
+
+// Puts the top 52 bits of u into the mantissa of a double in [1, 2) and
+// shifts it down to [0, 1). Exact and identical in the scalar and vector
+// paths, unlike an integer to double conversion followed by a scale.
+static double rng_to_unit(uint64_t u) {
+    uint64_t bits = (u >> 12) | UINT64_C(0x3FF0000000000000);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d - 1.0;
+}
+
+static void philox_block(uint64_t seed, uint64_t block, uint32_t x[4]) {
+    uint32_t k0 = (uint32_t)seed;
+    uint32_t k1 = (uint32_t)(seed >> 32);
+    uint32_t c0 = (uint32_t)block;
+    uint32_t c1 = (uint32_t)(block >> 32);
+    uint32_t c2 = 0;
+    uint32_t c3 = 0;
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    x[0] = c0;
+    x[1] = c1;
+    x[2] = c2;
+    x[3] = c3;
+}
+
+static void rng_blocks_scalar(uint64_t seed, uint64_t block, size_t nblocks, double *out) {
+    for (size_t b = 0; b < nblocks; b++) {
+        uint32_t x[4];
+        philox_block(seed, block + b, x);
+        out[2 * b] = rng_to_unit((uint64_t)x[1] << 32 | x[0]);
+        out[2 * b + 1] = rng_to_unit((uint64_t)x[3] << 32 | x[2]);
+    }
+}
+
+// Four blocks at a time, one per 64-bit lane. Every word lives in the low
+// half of its lane, which is what _mm256_mul_epu32 multiplies.
+__attribute__((target("avx2")))
+static void rng_blocks_avx2(uint64_t seed, uint64_t block, size_t nblocks, double *out) {
+    const __m256i lo32 = _mm256_set1_epi64x(0xFFFFFFFF);
+    const __m256i m0 = _mm256_set1_epi64x(PHILOX_M0);
+    const __m256i m1 = _mm256_set1_epi64x(PHILOX_M1);
+    const __m256i one = _mm256_set1_epi64x(0x3FF0000000000000);
+    const __m256d unit = _mm256_set1_pd(1.0);
+
+    size_t b = 0;
+    for (; b + 4 <= nblocks; b += 4) {
+        uint64_t first = block + b;
+        __m256i ctr = _mm256_add_epi64(
+            _mm256_set1_epi64x((long long)first),
+            _mm256_set_epi64x(3, 2, 1, 0)
+        );
+        __m256i c0 = _mm256_and_si256(ctr, lo32);
+        __m256i c1 = _mm256_srli_epi64(ctr, 32);
+        __m256i c2 = _mm256_setzero_si256();
+        __m256i c3 = _mm256_setzero_si256();
+        uint32_t k0 = (uint32_t)seed;
+        uint32_t k1 = (uint32_t)(seed >> 32);
+        for (int r = 0; r < PHILOX_ROUNDS; r++) {
+            __m256i p0 = _mm256_mul_epu32(c0, m0);
+            __m256i p1 = _mm256_mul_epu32(c2, m1);
+            __m256i n0 = _mm256_xor_si256(
+                _mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1),
+                _mm256_set1_epi64x(k0)
+            );
+            __m256i n2 = _mm256_xor_si256(
+                _mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3),
+                _mm256_set1_epi64x(k1)
+            );
+            c1 = _mm256_and_si256(p1, lo32);
+            c3 = _mm256_and_si256(p0, lo32);
+            c0 = n0;
+            c2 = n2;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+
+        // (x1:x0) and (x3:x2) as 64-bit words, mantissa trick as in
+        // rng_to_unit
+        __m256i u0 = _mm256_or_si256(_mm256_slli_epi64(c1, 32), c0);
+        __m256i u1 = _mm256_or_si256(_mm256_slli_epi64(c3, 32), c2);
+        __m256d a = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(u0, 12), one)), unit
+        );
+        __m256d d = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(u1, 12), one)), unit
+        );
+
+        // a0 d0 a2 d2 / a1 d1 a3 d3 -> stream order a0 d0 a1 d1 a2 d2 a3 d3
+        __m256d lo = _mm256_unpacklo_pd(a, d);
+        __m256d hi = _mm256_unpackhi_pd(a, d);
+        _mm256_storeu_pd(&out[2 * b], _mm256_permute2f128_pd(lo, hi, 0x20));
+        _mm256_storeu_pd(&out[2 * b + 4], _mm256_permute2f128_pd(lo, hi, 0x31));
+    }
+    rng_blocks_scalar(seed, block + b, nblocks - b, &out[2 * b]);
+}
+
+static rng_blocks_fn rng_get_blocks(void) {
+    if (cpu_get_level() >= CPU_LEVEL_AVX2) {
+        return rng_blocks_avx2;
+    }
+    return rng_blocks_scalar;
+}
+
+void rng_uniform(uint64_t seed, uint64_t offset, size_t n, double *out) {
+    if (n == 0) {
+        return;
+    }
+    // A range starting or ending mid-block takes that half separately
+    if (offset % RNG_PER_BLOCK != 0) {
+        double pair[RNG_PER_BLOCK];
+        rng_blocks_scalar(seed, offset / RNG_PER_BLOCK, 1, pair);
+        *out++ = pair[1];
+        offset++;
+        n--;
+    }
+    size_t nblocks = n / RNG_PER_BLOCK;
+    rng_get_blocks()(seed, offset / RNG_PER_BLOCK, nblocks, out);
+    if (n % RNG_PER_BLOCK != 0) {
+        double pair[RNG_PER_BLOCK];
+        rng_blocks_scalar(seed, offset / RNG_PER_BLOCK + nblocks, 1, pair);
+        out[n - 1] = pair[0];
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Philox4x32-10 counter-based generator. Value k of the stream for a seed
+// is a pure function of (seed, k), so any range of the stream can be
+// produced directly: jumping ahead is just choosing the offset, and
+// splitting a fill between threads does not change the result.
+
+// out[i] = value offset + i of the stream, uniform in [0, 1) with 52
+// random mantissa bits
+void rng_uniform(uint64_t seed, uint64_t offset, size_t n, double *out);
+
+#endif
@@ -0,0 +1,198 @@
+#include <assert.h>
+#include <math.h>
+
+#include "small.h"
+
+#define A(i, j) a[(i) * rsa + (j) * csa]
+#define OUT(i, j) out[(i) * rso + (j) * cso]
+
+// Rejects zero, subnormal, infinite and NaN determinants
+static bool small_det_ok(double det) {
+    return isnormal(det);
+}
+
+static int small_inv_2(
+    const double *a, size_t rsa, size_t csa,
+    double *out, size_t rso, size_t cso
+) {
+    double a00 = A(0, 0), a01 = A(0, 1);
+    double a10 = A(1, 0), a11 = A(1, 1);
+
+    double det = a00 * a11 - a01 * a10;
+    if (!small_det_ok(det)) {
+        return -1;
+    }
+    double r = 1.0 / det;
+    OUT(0, 0) = a11 * r;
+    OUT(0, 1) = -a01 * r;
+    OUT(1, 0) = -a10 * r;
+    OUT(1, 1) = a00 * r;
+    return 0;
+}
+
+static int small_inv_3(
+    const double *a, size_t rsa, size_t csa,
+    double *out, size_t rso, size_t cso
+) {
+    double a00 = A(0, 0), a01 = A(0, 1), a02 = A(0, 2);
+    double a10 = A(1, 0), a11 = A(1, 1), a12 = A(1, 2);
+    double a20 = A(2, 0), a21 = A(2, 1), a22 = A(2, 2);
+
+    // Cofactors of the first column, reused by the determinant
+    double c00 = a11 * a22 - a12 * a21;
+    double c10 = a12 * a20 - a10 * a22;
+    double c20 = a10 * a21 - a11 * a20;
+
+    double det = a00 * c00 + a01 * c10 + a02 * c20;
+    if (!small_det_ok(det)) {
+        return -1;
+    }
+    double r = 1.0 / det;
+    OUT(0, 0) = c00 * r;
+    OUT(0, 1) = (a02 * a21 - a01 * a22) * r;
+    OUT(0, 2) = (a01 * a12 - a02 * a11) * r;
+    OUT(1, 0) = c10 * r;
+    OUT(1, 1) = (a00 * a22 - a02 * a20) * r;
+    OUT(1, 2) = (a02 * a10 - a00 * a12) * r;
+    OUT(2, 0) = c20 * r;
+    OUT(2, 1) = (a01 * a20 - a00 * a21) * r;
+    OUT(2, 2) = (a00 * a11 - a01 * a10) * r;
+    return 0;
+}
+
+// Laplace expansion over the 2x2 minors of the top two rows (s) and the
+// bottom two rows (c)
+static int small_inv_4(
+    const double *a, size_t rsa, size_t csa,
+    double *out, size_t rso, size_t cso
+) {
+    double a00 = A(0, 0), a01 = A(0, 1), a02 = A(0, 2), a03 = A(0, 3);
+    double a10 = A(1, 0), a11 = A(1, 1), a12 = A(1, 2), a13 = A(1, 3);
+    double a20 = A(2, 0), a21 = A(2, 1), a22 = A(2, 2), a23 = A(2, 3);
+    double a30 = A(3, 0), a31 = A(3, 1), a32 = A(3, 2), a33 = A(3, 3);
+
+    double s0 = a00 * a11 - a10 * a01;
+    double s1 = a00 * a12 - a10 * a02;
+    double s2 = a00 * a13 - a10 * a03;
+    double s3 = a01 * a12 - a11 * a02;
+    double s4 = a01 * a13 - a11 * a03;
+    double s5 = a02 * a13 - a12 * a03;
+
+    double c5 = a22 * a33 - a32 * a23;
+    double c4 = a21 * a33 - a31 * a23;
+    double c3 = a21 * a32 - a31 * a22;
+    double c2 = a20 * a33 - a30 * a23;
+    double c1 = a20 * a32 - a30 * a22;
+    double c0 = a20 * a31 - a30 * a21;
+
+    double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (!small_det_ok(det)) {
+        return -1;
+    }
+    double r = 1.0 / det;
+    OUT(0, 0) = ( a11 * c5 - a12 * c4 + a13 * c3) * r;
+    OUT(0, 1) = (-a01 * c5 + a02 * c4 - a03 * c3) * r;
+    OUT(0, 2) = ( a31 * s5 - a32 * s4 + a33 * s3) * r;
+    OUT(0, 3) = (-a21 * s5 + a22 * s4 - a23 * s3) * r;
+    OUT(1, 0) = (-a10 * c5 + a12 * c2 - a13 * c1) * r;
+    OUT(1, 1) = ( a00 * c5 - a02 * c2 + a03 * c1) * r;
+    OUT(1, 2) = (-a30 * s5 + a32 * s2 - a33 * s1) * r;
+    OUT(1, 3) = ( a20 * s5 - a22 * s2 + a23 * s1) * r;
+    OUT(2, 0) = ( a10 * c4 - a11 * c2 + a13 * c0) * r;
+    OUT(2, 1) = (-a00 * c4 + a01 * c2 - a03 * c0) * r;
+    OUT(2, 2) = ( a30 * s4 - a31 * s2 + a33 * s0) * r;
+    OUT(2, 3) = (-a20 * s4 + a21 * s2 - a23 * s0) * r;
+    OUT(3, 0) = (-a10 * c3 + a11 * c1 - a12 * c0) * r;
+    OUT(3, 1) = ( a00 * c3 - a01 * c1 + a02 * c0) * r;
+    OUT(3, 2) = (-a30 * s3 + a31 * s1 - a32 * s0) * r;
+    OUT(3, 3) = ( a20 * s3 - a21 * s1 + a22 * s0) * r;
+    return 0;
+}
+
+int small_inv(
+    size_t n,
+    const double *a, size_t rsa, size_t csa,
+    double *out, size_t rso, size_t cso
+) {
+    switch (n) {
+    case 2:
+        return small_inv_2(a, rsa, csa, out, rso, cso);
+    case 3:
+        return small_inv_3(a, rsa, csa, out, rso, cso);
+    case 4:
+        return small_inv_4(a, rsa, csa, out, rso, cso);
+    default:
+        assert(0 && "no closed-form inverse for this size");
+        return -1;
+    }
+}
+
+#undef A
+#undef OUT
+
+// One fully unrolled kernel per size; the accumulator tile stays in
+// registers and C is written only once the product is complete
+#define SMALL_DOT_KERNEL(N)                                                  \
+    static void small_dot_##N(                                               \
+        double alpha,                                                        \
+        const double *a, size_t rsa, size_t csa,                             \
+        const double *b, size_t ldb,                                         \
+        double beta,                                                         \
+        double *c, size_t ldc                                                \
+    ) {                                                                      \
+        double acc[N * N] = { 0.0 };                                         \
+        _Pragma("GCC unroll 8")                                              \
+        for (size_t i = 0; i < N; i++) {                                     \
+            _Pragma("GCC unroll 8")                                          \
+            for (size_t p = 0; p < N; p++) {                                 \
+                double aip = a[i * rsa + p * csa];                           \
+                _Pragma("GCC unroll 8")                                      \
+                for (size_t j = 0; j < N; j++) {                             \
+                    acc[i * N + j] += aip * b[p * ldb + j];                  \
+                }                                                            \
+            }                                                                \
+        }                                                                    \
+        _Pragma("GCC unroll 8")                                              \
+        for (size_t i = 0; i < N; i++) {                                     \
+            _Pragma("GCC unroll 8")                                          \
+            for (size_t j = 0; j < N; j++) {                                 \
+                c[i * ldc + j] = beta == 0.0                                 \
+                    ? alpha * acc[i * N + j]                                 \
+                    : alpha * acc[i * N + j] + beta * c[i * ldc + j];        \
+            }                                                                \
+        }                                                                    \
+    }
+
+SMALL_DOT_KERNEL(2)
+SMALL_DOT_KERNEL(3)
+SMALL_DOT_KERNEL(4)
+SMALL_DOT_KERNEL(5)
+SMALL_DOT_KERNEL(6)
+SMALL_DOT_KERNEL(7)
+SMALL_DOT_KERNEL(8)
+
+typedef void (*small_dot_fn)(
+    double alpha,
+    const double *a, size_t rsa, size_t csa,
+    const double *b, size_t ldb,
+    double beta,
+    double *c, size_t ldc
+);
+
+static const small_dot_fn small_dot_kernels[SMALL_DOT_MAX + 1] = {
+    NULL, NULL,
+    small_dot_2, small_dot_3, small_dot_4,
+    small_dot_5, small_dot_6, small_dot_7, small_dot_8,
+};
+
+void small_dot(
+    size_t n,
+    double alpha,
+    const double *a, size_t rsa, size_t csa,
+    const double *b, size_t ldb,
+    double beta,
+    double *c, size_t ldc
+) {
+    assert(n >= 2 && n <= SMALL_DOT_MAX);
+    small_dot_kernels[n](alpha, a, rsa, csa, b, ldb, beta, c, ldc);
+}
@@ -0,0 +1,33 @@
+#ifndef SMALL_H
+#define SMALL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Largest sizes with a dedicated kernel
+#define SMALL_INV_MAX 4
+#define SMALL_DOT_MAX 8
+
+// Closed-form (adjugate) inverse of an n x n matrix, 2 <= n <=
+// SMALL_INV_MAX, with element (i, j) at x[i * rsx + j * csx]. out may
+// alias a. Returns -1 without touching out when the determinant is not a
+// normal number; the caller then takes the pivoted path.
+int small_inv(
+    size_t n,
+    const double *a, size_t rsa, size_t csa,
+    double *out, size_t rso, size_t cso
+);
+
+// C = alpha * A * B + beta * C for n x n operands, 2 <= n <=
+// SMALL_DOT_MAX, with unit column strides on B and C. The whole product
+// is formed before C is written, so C may alias A or B.
+void small_dot(
+    size_t n,
+    double alpha,
+    const double *a, size_t rsa, size_t csa,
+    const double *b, size_t ldb,
+    double beta,
+    double *c, size_t ldc
+);
+
+#endif
@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libmatrix/matrix.h"
+
+#include "matrix_internal.h"
+#include "numfmt.h"
+
+// Bytes of text per parallel work item; chunks end on a line boundary
+#define CSV_CHUNK_BYTES (1 << 20)
+
+// Upper bound on the text of one block of rows formatted by one thread
+#define TEXT_BLOCK_BYTES (1 << 20)
+
+static bool csv_is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parses one line at p. Fields are separated by a comma or by blanks,
+// blanks around a comma are ignored. With dst NULL the fields are only
+// counted. Returns the start of the next line, or NULL on a malformed
+// line or one with a field count other than *cols.
+static const char *csv_parse_line(
+    const char *p, const char *end,
+    double *dst, size_t *cols
+) {
+    size_t col = 0;
+    while (p < end && csv_is_blank(*p)) {
+        p++;
+    }
+    while (p < end && *p != '\n') {
+        double v;
+        const char *q = numfmt_parse(p, end, &v);
+        if (q == NULL || (dst != NULL && col >= *cols)) {
+            return NULL;
+        }
+        if (dst != NULL) {
+            dst[col] = v;
+        }
+        col++;
+
+        p = q;
+        bool sep = false;
+        while (p < end && csv_is_blank(*p)) {
+            p++;
+            sep = true;
+        }
+        if (p < end && *p == ',') {
+            p++;
+            while (p < end && csv_is_blank(*p)) {
+                p++;
+            }
+            if (p == end || *p == '\n') {
+                // Trailing comma: an empty last field
+                return NULL;
+            }
+        } else if (!sep && p < end && *p != '\n') {
+            return NULL;
+        }
+    }
+
+    if (dst == NULL) {
+        *cols = col;
+    } else if (col != *cols) {
+        return NULL;
+    }
+    return p < end ? p + 1 : p;
+}
+
+static size_t csv_count_lines(const char *p, const char *end) {
+    size_t lines = 0;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        lines++;
+        p++;
+    }
+    return lines;
+}
+
+static int csv_parse(struct mat2d **out, const char *text, size_t size) {
+    // Trailing blank lines are not rows
+    while (size > 0 && (csv_is_blank(text[size - 1]) || text[size - 1] == '\n')) {
+        size--;
+    }
+    const char *end = text + size;
+
+    size_t cols = 0;
+    if (size > 0 && csv_parse_line(text, end, NULL, &cols) == NULL) {
+        return -1;
+    }
+
+    // Cut the text into chunks at the first line break after every
+    // CSV_CHUNK_BYTES, then give each chunk its first row
+    size_t nchunks = size / CSV_CHUNK_BYTES + 1;
+    const char **bounds = malloc(sizeof(char *) * (nchunks + 1));
+    size_t *first_row = malloc(sizeof(size_t) * (nchunks + 1));
+    assert(bounds != NULL && first_row != NULL);
+    bounds[0] = text;
+    for (size_t c = 1; c < nchunks; c++) {
+        const char *p = text + c * CSV_CHUNK_BYTES;
+        if (p < bounds[c - 1]) {
+            p = bounds[c - 1];
+        }
+        const char *nl = memchr(p, '\n', end - p);
+        bounds[c] = nl != NULL ? nl + 1 : end;
+    }
+    bounds[nchunks] = end;
+
+    first_row[0] = 0;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < nchunks; c++) {
+        first_row[c + 1] = csv_count_lines(bounds[c], bounds[c + 1]);
+    }
+    for (size_t c = 0; c < nchunks; c++) {
+        first_row[c + 1] += first_row[c];
+    }
+    // The last line has no line break after trimming
+    size_t rows = size > 0 ? first_row[nchunks] + 1 : 0;
+
+    struct mat2d *mat = mat2d_create_ex(rows, cols, 0, MAT2D_ALLOC_DENSE);
+    if (mat == NULL) {
+        free(bounds);
+        free(first_row);
+        return -1;
+    }
+
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(|:failed)
+    for (size_t c = 0; c < nchunks; c++) {
+        const char *p = bounds[c];
+        size_t row = first_row[c];
+        while (p < bounds[c + 1] && !failed) {
+            p = csv_parse_line(p, bounds[c + 1], mat2d_at(mat, row, 0), &cols);
+            if (p == NULL) {
+                failed = 1;
+                break;
+            }
+            row++;
+        }
+    }
+
+    free(bounds);
+    free(first_row);
+    if (failed) {
+        mat2d_destroy(mat);
+        return -1;
+    }
+    *out = mat;
+    return 0;
+}
+
+// Comma- or blank-separated text, one row per line. The file is mapped
+// and parsed in line-aligned chunks on all threads, straight into the
+// rows of the result. Returns -1 on malformed numbers or ragged rows.
+int mat2d_read_from_file(struct mat2d **out, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = st.st_size;
+    if (size == 0) {
+        close(fd);
+        return csv_parse(out, "", 0);
+    }
+    void *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        return -1;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(text, size, MADV_SEQUENTIAL);
+#endif
+
+    int rc = csv_parse(out, text, size);
+    munmap(text, size);
+    return rc;
+}
+
+static size_t text_format_rows(
+    const struct mat2d *mat,
+    size_t first, size_t last,
+    int precision, char sep,
+    char *buf
+) {
+    char *p = buf;
+    for (size_t i = first; i < last; i++) {
+        const double *row = mat2d_at(mat, i, 0);
+        for (size_t j = 0; j < mat->cols; j++) {
+            if (j > 0) {
+                *p++ = sep;
+            }
+            p += numfmt_format(row[j * mat->cs], precision, p);
+        }
+        *p++ = '\n';
+    }
+    return p - buf;
+}
+
+int mat2d_write_to_text_file(const struct mat2d *mat, const char *filename) {
+    return mat2d_write_to_text_file_ex(mat, filename, 0, ',');
+}
+
+// Blocks of rows are formatted on all threads into per-thread buffers
+// and written in row order
+int mat2d_write_to_text_file_ex(
+    const struct mat2d *mat,
+    const char *filename,
+    int precision, char sep
+) {
+    assert(precision >= 0 && precision <= 17);
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        perror("Failed to open file");
+        return -1;
+    }
+
+    size_t row_max = mat->cols * (NUMFMT_MAX_CHARS + 1) + 1;
+    size_t block_rows = TEXT_BLOCK_BYTES / row_max > 0 ? TEXT_BLOCK_BYTES / row_max : 1;
+    size_t nblocks = (mat->rows + block_rows - 1) / block_rows;
+
+    int failed = 0;
+    #pragma omp parallel
+    {
+        char *buf = malloc(block_rows * row_max);
+        assert(buf != NULL);
+
+        #pragma omp for ordered schedule(static, 1)
+        for (size_t b = 0; b < nblocks; b++) {
+            size_t first = b * block_rows;
+            size_t last = first + block_rows < mat->rows ? first + block_rows : mat->rows;
+            size_t len = text_format_rows(mat, first, last, precision, sep, buf);
+            #pragma omp ordered
+            {
+                if (!failed && fwrite(buf, 1, len, file) != len) {
+                    failed = 1;
+                }
+            }
+        }
+
+        free(buf);
+    }
+
+    if (fclose(file) != 0 || failed) {
+        perror("Error writing matrix data");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,888 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "libmatrix/matrix.h"
+
+#include "binfile.h"
+#include "gemm.h"
+#include "kernels.h"
+#include "matrix_internal.h"
+#include "tileio.h"
+
+// On-disk layout of a tiled matrix; header fields are little-endian:
+//
+//    0  magic        "MAT2DTIL"
+//    8  version      u32, TILED_VERSION
+//   12  order        u32, TILED_ORDER_LE or TILED_ORDER_BE
+//   16  rows         u64
+//   24  cols         u64
+//   32  tile         u64
+//   40  data_offset  u64, TILED_DATA_OFFSET
+//
+// Tiles are tile x tile row-major blocks, edge tiles zero-padded to full
+// size, stored tile column by tile column. The tiles of one tile column
+// from a given tile row down are thus a single extent on disk, and in
+// memory a row-major block with row pitch tile: a slab.
+//
+// The payload is streamed straight between disk and the compute
+// buffers, so it keeps the byte order of the host that wrote it, as
+// recorded in order. A host of the other order refuses to open it.
+
+#define TILED_MAGIC "MAT2DTIL"
+#define TILED_MAGIC_SIZE 8
+#define TILED_VERSION 2
+#define TILED_ORDER_LE 1
+#define TILED_ORDER_BE 2
+#define TILED_ORDER (BINFILE_NATIVE_LE ? TILED_ORDER_LE : TILED_ORDER_BE)
+#define TILED_HEADER_SIZE 48
+#define TILED_DATA_OFFSET 4096
+
+// Column block of the panel factorization
+#define TILED_PANEL_NB 32
+// Slabs a stream keeps in flight; beyond two there is nothing to overlap
+#define TILED_STREAM_BUFS 2
+
+struct mat2d_tiled {
+    int fd;
+    size_t rows, cols;
+    size_t tile;
+    // Tile counts
+    size_t tile_rows, tile_cols;
+};
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static size_t tiled_tile_bytes(const struct mat2d_tiled *mat) {
+    return sizeof(double) * mat->tile * mat->tile;
+}
+
+static off_t tiled_offset(const struct mat2d_tiled *mat, size_t ti, size_t tj) {
+    return TILED_DATA_OFFSET
+        + (off_t)(tj * mat->tile_rows + ti) * tiled_tile_bytes(mat);
+}
+
+static double *tiled_alloc(size_t bytes) {
+    void *buf = NULL;
+    if (posix_memalign(&buf, 64, bytes > 0 ? bytes : 64) != 0) {
+        return NULL;
+    }
+    return buf;
+}
+
+static struct mat2d_tiled *tiled_new(int fd, size_t rows, size_t cols, size_t tile) {
+    struct mat2d_tiled *mat = malloc(sizeof(struct mat2d_tiled));
+    if (mat == NULL) {
+        return NULL;
+    }
+    mat->fd = fd;
+    mat->rows = rows;
+    mat->cols = cols;
+    mat->tile = tile;
+    mat->tile_rows = (rows + tile - 1) / tile;
+    mat->tile_cols = (cols + tile - 1) / tile;
+    return mat;
+}
+
+struct mat2d_tiled *mat2d_tiled_create(
+    const char *filename,
+    size_t rows, size_t cols,
+    size_t tile
+) {
+    if (tile == 0) {
+        return NULL;
+    }
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct mat2d_tiled *mat = tiled_new(fd, rows, cols, tile);
+    if (mat == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    unsigned char buf[TILED_HEADER_SIZE] = { 0 };
+    memcpy(buf, TILED_MAGIC, TILED_MAGIC_SIZE);
+    binfile_store_le32(&buf[8], TILED_VERSION);
+    binfile_store_le32(&buf[12], TILED_ORDER);
+    binfile_store_le64(&buf[16], rows);
+    binfile_store_le64(&buf[24], cols);
+    binfile_store_le64(&buf[32], tile);
+    binfile_store_le64(&buf[40], TILED_DATA_OFFSET);
+
+    // The payload starts as a hole, so every tile reads back as zeros
+    off_t size = tiled_offset(mat, 0, mat->tile_cols);
+    if (tileio_write_full(fd, buf, sizeof(buf), 0) != 0
+        || ftruncate(fd, size) != 0) {
+        mat2d_tiled_close(mat);
+        return NULL;
+    }
+    return mat;
+}
+
+struct mat2d_tiled *mat2d_tiled_open(const char *filename) {
+    int fd = open(filename, O_RDWR);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    unsigned char buf[TILED_HEADER_SIZE];
+    struct stat st;
+    if (tileio_read_full(fd, buf, sizeof(buf), 0) != 0
+        || memcmp(buf, TILED_MAGIC, TILED_MAGIC_SIZE) != 0
+        || fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    uint64_t rows = binfile_load_le64(&buf[16]);
+    uint64_t cols = binfile_load_le64(&buf[24]);
+    uint64_t tile = binfile_load_le64(&buf[32]);
+    if (binfile_load_le32(&buf[8]) != TILED_VERSION
+        || binfile_load_le32(&buf[12]) != TILED_ORDER
+        || tile == 0 || binfile_load_le64(&buf[40]) != TILED_DATA_OFFSET) {
+        close(fd);
+        return NULL;
+    }
+
+    struct mat2d_tiled *mat = tiled_new(fd, rows, cols, tile);
+    if (mat == NULL) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size < tiled_offset(mat, 0, mat->tile_cols)) {
+        mat2d_tiled_close(mat);
+        return NULL;
+    }
+    return mat;
+}
+
+void mat2d_tiled_close(struct mat2d_tiled *mat) {
+    if (mat == NULL) {
+        return;
+    }
+    close(mat->fd);
+    free(mat);
+}
+
+size_t mat2d_tiled_get_rows(struct mat2d_tiled *mat) {
+    return mat->rows;
+}
+
+size_t mat2d_tiled_get_cols(struct mat2d_tiled *mat) {
+    return mat->cols;
+}
+
+size_t mat2d_tiled_get_tile(struct mat2d_tiled *mat) {
+    return mat->tile;
+}
+
+// Visits every tile overlapping the block at (row, col) of dst's shape.
+// Writing reads the tile first, so the rest of a partly covered tile and
+// its zero padding survive.
+static int tiled_block_io(
+    struct mat2d_tiled *mat,
+    size_t row, size_t col,
+    struct mat2d *block,
+    bool write
+) {
+    if (row + block->rows > mat->rows || col + block->cols > mat->cols) {
+        return -1;
+    }
+    if (block->rows == 0 || block->cols == 0) {
+        return 0;
+    }
+
+    size_t tile = mat->tile;
+    double *buf = tiled_alloc(tiled_tile_bytes(mat));
+    if (buf == NULL) {
+        return -1;
+    }
+
+    int rc = 0;
+    size_t tj_end = (col + block->cols - 1) / tile;
+    size_t ti_end = (row + block->rows - 1) / tile;
+    for (size_t tj = col / tile; tj <= tj_end && rc == 0; tj++) {
+        for (size_t ti = row / tile; ti <= ti_end && rc == 0; ti++) {
+            // Overlap of the tile and the block, in matrix coordinates
+            size_t i0 = ti * tile > row ? ti * tile : row;
+            size_t j0 = tj * tile > col ? tj * tile : col;
+            size_t i1 = min_size((ti + 1) * tile, row + block->rows);
+            size_t j1 = min_size((tj + 1) * tile, col + block->cols);
+
+            off_t offset = tiled_offset(mat, ti, tj);
+            rc = tileio_read_full(mat->fd, buf, tiled_tile_bytes(mat), offset);
+            for (size_t i = i0; i < i1 && rc == 0; i++) {
+                double *trow = &buf[(i - ti * tile) * tile];
+                for (size_t j = j0; j < j1; j++) {
+                    double *elem = mat2d_at(block, i - row, j - col);
+                    if (write) {
+                        trow[j - tj * tile] = *elem;
+                    } else {
+                        *elem = trow[j - tj * tile];
+                    }
+                }
+            }
+            if (rc == 0 && write) {
+                rc = tileio_write_full(mat->fd, buf, tiled_tile_bytes(mat), offset);
+            }
+        }
+    }
+
+    free(buf);
+    return rc;
+}
+
+int mat2d_tiled_read_block(
+    struct mat2d_tiled *mat,
+    size_t row, size_t col,
+    struct mat2d *dst
+) {
+    return tiled_block_io(mat, row, col, dst, false);
+}
+
+int mat2d_tiled_write_block(
+    struct mat2d_tiled *mat,
+    size_t row, size_t col,
+    struct mat2d *src
+) {
+    return tiled_block_io(mat, row, col, src, true);
+}
+
+// One tile row at a time: the band is read tile by tile and written out
+// as whole file rows, so the file is produced front to back and its
+// checksum is computed on the way
+int mat2d_tiled_write_to_binfile(struct mat2d_tiled *mat, const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        return -1;
+    }
+
+    struct binfile_header hdr = {
+        .version = BINFILE_VERSION,
+        .dtype = BINFILE_F64,
+        .flags = BINFILE_HAS_CHECKSUM,
+        .rows = mat->rows,
+        .cols = mat->cols,
+        .ld = mat->cols,
+        .data_offset = BINFILE_HEADER_SIZE,
+        .checksum = 0,
+    };
+    unsigned char buf[BINFILE_HEADER_SIZE];
+    binfile_encode_header(&hdr, buf);
+
+    size_t tile = mat->tile;
+    double *band = tiled_alloc(tiled_tile_bytes(mat) * mat->tile_cols);
+    double *row = tiled_alloc(sizeof(double) * mat->cols);
+    int rc = band != NULL && row != NULL ? 0 : -1;
+    if (rc == 0 && fwrite(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+        rc = -1;
+    }
+
+    struct binfile_sum sum;
+    binfile_sum_init(&sum);
+    for (size_t ti = 0; ti < mat->tile_rows && rc == 0; ti++) {
+        for (size_t tj = 0; tj < mat->tile_cols && rc == 0; tj++) {
+            rc = tileio_read_full(
+                mat->fd, &band[tj * tile * tile],
+                tiled_tile_bytes(mat), tiled_offset(mat, ti, tj)
+            );
+        }
+        size_t rows = min_size(tile, mat->rows - ti * tile);
+        for (size_t i = 0; i < rows && rc == 0; i++) {
+            for (size_t tj = 0; tj < mat->tile_cols; tj++) {
+                size_t cols = min_size(tile, mat->cols - tj * tile);
+                memcpy(
+                    &row[tj * tile], &band[(tj * tile + i) * tile],
+                    sizeof(double) * cols
+                );
+            }
+            binfile_swap_words(row, mat->cols);
+            binfile_sum_update(&sum, row, sizeof(double) * mat->cols);
+            if (fwrite(row, sizeof(double), mat->cols, file) != mat->cols) {
+                rc = -1;
+            }
+        }
+    }
+
+    if (rc == 0) {
+        hdr.checksum = binfile_sum_final(&sum);
+        binfile_encode_header(&hdr, buf);
+        if (fseek(file, 0, SEEK_SET) != 0
+            || fwrite(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+            rc = -1;
+        }
+    }
+    if (fclose(file) != 0) {
+        rc = -1;
+    }
+    free(band);
+    free(row);
+    return rc;
+}
+
+// Slabs of one tile column: tiles row0 .. row0 + tiles - 1 of column col
+struct slab_ref {
+    size_t row0, col;
+    size_t tiles;
+};
+
+// Walks a list of slabs through a ring of buffers. While the caller
+// works on one slab the worker prefetches the next ones and, for
+// writeback streams, writes finished slabs behind it.
+struct slab_stream {
+    struct tileio *io;
+    struct mat2d_tiled *mat;
+    const struct slab_ref *refs;
+    size_t count;
+    size_t next;
+    bool writeback;
+    size_t nbuf;
+    double *buf[TILED_STREAM_BUFS];
+    struct tileio_req rd[TILED_STREAM_BUFS];
+    struct tileio_req wr[TILED_STREAM_BUFS];
+};
+
+static void stream_fetch(struct slab_stream *s, size_t idx) {
+    if (idx >= s->count) {
+        return;
+    }
+    const struct slab_ref *ref = &s->refs[idx];
+    size_t b = idx % s->nbuf;
+    tileio_submit(
+        s->io, &s->rd[b], s->mat->fd, false, s->buf[b],
+        ref->tiles * tiled_tile_bytes(s->mat),
+        tiled_offset(s->mat, ref->row0, ref->col)
+    );
+}
+
+static void stream_open(
+    struct slab_stream *s,
+    struct tileio *io,
+    struct mat2d_tiled *mat,
+    const struct slab_ref *refs, size_t count,
+    double **bufs, size_t nbuf,
+    bool writeback
+) {
+    s->io = io;
+    s->mat = mat;
+    s->refs = refs;
+    s->count = count;
+    s->next = 0;
+    s->writeback = writeback;
+    s->nbuf = nbuf;
+    for (size_t b = 0; b < nbuf; b++) {
+        s->buf[b] = bufs[b];
+        tileio_req_init(&s->rd[b]);
+        tileio_req_init(&s->wr[b]);
+    }
+    for (size_t idx = 0; idx < nbuf; idx++) {
+        stream_fetch(s, idx);
+    }
+}
+
+// Returns the next slab, or NULL once the list is done or a read failed
+static double *stream_next(struct slab_stream *s) {
+    if (s->next >= s->count) {
+        return NULL;
+    }
+    size_t b = s->next % s->nbuf;
+    if (tileio_wait(s->io, &s->rd[b]) != 0) {
+        return NULL;
+    }
+    return s->buf[b];
+}
+
+// Hands back the slab from stream_next: queues its write, then the read
+// of the slab that takes over its buffer
+static void stream_release(struct slab_stream *s) {
+    const struct slab_ref *ref = &s->refs[s->next];
+    size_t b = s->next % s->nbuf;
+    if (s->writeback) {
+        tileio_submit(
+            s->io, &s->wr[b], s->mat->fd, true, s->buf[b],
+            ref->tiles * tiled_tile_bytes(s->mat),
+            tiled_offset(s->mat, ref->row0, ref->col)
+        );
+    }
+    stream_fetch(s, s->next + s->nbuf);
+    s->next++;
+}
+
+// Waits for everything in flight; the buffers are free afterwards
+static int stream_close(struct slab_stream *s) {
+    int rc = s->next == s->count ? 0 : -1;
+    for (size_t b = 0; b < s->nbuf; b++) {
+        tileio_wait(s->io, &s->rd[b]);
+        if (tileio_wait(s->io, &s->wr[b]) != 0) {
+            rc = -1;
+        }
+    }
+    return rc;
+}
+
+static void swap_rows(double *a, size_t lda, size_t n, size_t r1, size_t r2) {
+    if (r1 == r2) {
+        return;
+    }
+    double *row1 = &a[r1 * lda];
+    double *row2 = &a[r2 * lda];
+    for (size_t j = 0; j < n; j++) {
+        double tmp = row1[j];
+        row1[j] = row2[j];
+        row2[j] = tmp;
+    }
+}
+
+// Blocked LU with partial pivoting of the m x w panel a, m >= w. Row
+// exchanges cover the whole panel width; piv is panel-local.
+static int tiled_factor_panel(double *a, size_t lda, size_t m, size_t w, size_t *piv) {
+    for (size_t j0 = 0; j0 < w; j0 += TILED_PANEL_NB) {
+        size_t j1 = min_size(j0 + TILED_PANEL_NB, w);
+        for (size_t j = j0; j < j1; j++) {
+            size_t p = j;
+            double pmax = fabs(a[j * lda + j]);
+            for (size_t i = j + 1; i < m; i++) {
+                double v = fabs(a[i * lda + j]);
+                if (v > pmax) {
+                    pmax = v;
+                    p = i;
+                }
+            }
+            if (pmax == 0) {
+                return -1;
+            }
+
+            piv[j] = p;
+            swap_rows(a, lda, w, j, p);
+
+            double rdiag = 1 / a[j * lda + j];
+            for (size_t i = j + 1; i < m; i++) {
+                a[i * lda + j] *= rdiag;
+            }
+            if (j + 1 < j1) {
+                kern_ger(
+                    m - j - 1, j1 - j - 1, -1,
+                    &a[(j + 1) * lda + j], lda,
+                    &a[j * lda + j + 1],
+                    &a[(j + 1) * lda + j + 1], lda
+                );
+            }
+        }
+
+        if (j1 < w) {
+            // U12 = L11^-1 * A12, then A22 -= L21 * U12
+            for (size_t i = j0 + 1; i < j1; i++) {
+                for (size_t k = j0; k < i; k++) {
+                    kern_axpy(w - j1, -a[i * lda + k], &a[k * lda + j1], &a[i * lda + j1]);
+                }
+            }
+            gemm_dgemm(
+                m - j1, w - j1, j1 - j0,
+                -1, &a[j1 * lda + j0], lda, 1,
+                &a[j0 * lda + j1], lda, 1,
+                1, &a[j1 * lda + j1], lda, 1
+            );
+        }
+    }
+    return 0;
+}
+
+// Applies one factored panel l (m x w, row pitch ldl) to the m x nb
+// block b below the panel's top: the panel's row exchanges, then
+// B1 = L11^-1 * B1 and B2 -= L21 * B1. This is both the trailing update
+// of the factorization and a step of the forward substitution.
+static void tiled_apply_panel(
+    const double *l, size_t ldl,
+    size_t m, size_t w,
+    const size_t *piv,
+    double *b, size_t ldb, size_t nb
+) {
+    for (size_t c = 0; c < w; c++) {
+        swap_rows(b, ldb, nb, c, piv[c]);
+    }
+    for (size_t i = 1; i < w; i++) {
+        for (size_t k = 0; k < i; k++) {
+            kern_axpy(nb, -l[i * ldl + k], &b[k * ldb], &b[i * ldb]);
+        }
+    }
+    gemm_dgemm(
+        m - w, nb, w,
+        -1, &l[w * ldl], ldl, 1,
+        b, ldb, 1,
+        1, &b[w * ldb], ldb, 1
+    );
+}
+
+// A step of the backward substitution with the slab u holding rows
+// 0 .. k0 + w of a U column: B1 = U11^-1 * B1 for the rows at k0, then
+// the rows above take B0 -= U01 * B1
+static void tiled_apply_upper(
+    const double *u, size_t ldu,
+    size_t k0, size_t w,
+    double *b, size_t ldb, size_t nb
+) {
+    const double *u11 = &u[k0 * ldu];
+    double *b1 = &b[k0 * ldb];
+    for (size_t i = w; i-- > 0;) {
+        for (size_t k = i + 1; k < w; k++) {
+            kern_axpy(nb, -u11[i * ldu + k], &b1[k * ldb], &b1[i * ldb]);
+        }
+        kern_scale(nb, 1 / u11[i * ldu + i], &b1[i * ldb]);
+    }
+    gemm_dgemm(
+        k0, nb, w,
+        -1, u, ldu, 1,
+        b1, ldb, 1,
+        1, b, ldb, 1
+    );
+}
+
+// Splits a budget between slabs of slab_bytes: at least min_slabs, and
+// up to TILED_STREAM_BUFS stream buffers out of what is left over.
+// Returns 0 buffers when the budget is too small.
+static size_t tiled_stream_bufs(size_t budget, size_t slab_bytes, size_t min_slabs) {
+    size_t slabs = slab_bytes > 0 ? budget / slab_bytes : 0;
+    if (slabs < min_slabs + 1) {
+        return 0;
+    }
+    return min_size(TILED_STREAM_BUFS, slabs - min_slabs);
+}
+
+// Right-looking LU by tile columns. Step k reads the panel below the
+// diagonal of tile column k, factors it in memory and streams the
+// trailing tile columns through the rank-tile update. Only the panel and
+// the stream buffers are ever resident, each a slab of n x tile.
+//
+// Row exchanges of step k are applied to the columns right of the panel
+// only: L is left as factored, and the solve replays each step's
+// exchanges before its column of L, as the factorization did.
+int mat2d_tiled_lu_factor(struct mat2d_tiled *mat, size_t *piv, size_t budget) {
+    if (mat->rows != mat->cols) {
+        return -1;
+    }
+    size_t n = mat->rows;
+    size_t tile = mat->tile;
+    size_t nt = mat->tile_rows;
+    size_t slab_bytes = nt * tiled_tile_bytes(mat);
+    size_t nbuf = tiled_stream_bufs(budget, slab_bytes, 1);
+    if (nbuf == 0) {
+        return -1;
+    }
+
+    double *panel = tiled_alloc(slab_bytes);
+    double *bufs[TILED_STREAM_BUFS] = { NULL };
+    struct slab_ref *refs = malloc(sizeof(struct slab_ref) * (nt > 0 ? nt : 1));
+    int rc = panel != NULL && refs != NULL ? 0 : -1;
+    for (size_t b = 0; b < nbuf && rc == 0; b++) {
+        bufs[b] = tiled_alloc(slab_bytes);
+        rc = bufs[b] != NULL ? 0 : -1;
+    }
+
+    struct tileio io;
+    if (rc == 0 && tileio_start(&io) != 0) {
+        rc = -1;
+    } else if (rc == 0) {
+        struct tileio_req panel_rd, panel_wr;
+        tileio_req_init(&panel_rd);
+        tileio_req_init(&panel_wr);
+        for (size_t k = 0; k < nt && rc == 0; k++) {
+            size_t k0 = k * tile;
+            size_t m = n - k0;
+            size_t w = min_size(tile, m);
+            size_t tiles = nt - k;
+
+            // Queued behind the writes of the previous step
+            tileio_submit(
+                &io, &panel_rd, mat->fd, false, panel,
+                tiles * tiled_tile_bytes(mat), tiled_offset(mat, k, k)
+            );
+            if (tileio_wait(&io, &panel_rd) != 0
+                || tiled_factor_panel(panel, tile, m, w, &piv[k0]) != 0) {
+                rc = -1;
+                break;
+            }
+            // Done already: the read just waited for was queued after it
+            tileio_wait(&io, &panel_wr);
+            tileio_submit(
+                &io, &panel_wr, mat->fd, true, panel,
+                tiles * tiled_tile_bytes(mat), tiled_offset(mat, k, k)
+            );
+
+            size_t count = 0;
+            for (size_t j = k + 1; j < nt; j++) {
+                refs[count++] = (struct slab_ref){ k, j, tiles };
+            }
+            struct slab_stream s;
+            stream_open(&s, &io, mat, refs, count, bufs, nbuf, true);
+            double *slab;
+            while ((slab = stream_next(&s)) != NULL) {
+                tiled_apply_panel(panel, tile, m, w, &piv[k0], slab, tile, tile);
+                stream_release(&s);
+            }
+            rc = stream_close(&s);
+
+            for (size_t c = 0; c < w; c++) {
+                piv[k0 + c] += k0;
+            }
+        }
+        // The last panel write is still queued; stopping drains it
+        if (tileio_stop(&io) != 0) {
+            rc = -1;
+        }
+    }
+
+    for (size_t b = 0; b < nbuf; b++) {
+        free(bufs[b]);
+    }
+    free(panel);
+    free(refs);
+    return rc;
+}
+
+// Solves with the factors of mat2d_tiled_lu_factor for the columns of
+// rhs, or of the identity when rhs is NULL, and stores the result in
+// out. As many tile columns of the right-hand side as the budget holds
+// are solved per pass over the factors.
+static int tiled_solve(
+    struct mat2d_tiled *lu,
+    const size_t *piv,
+    struct mat2d_tiled *rhs,
+    struct mat2d_tiled *out,
+    size_t budget
+) {
+    size_t n = lu->rows;
+    size_t tile = lu->tile;
+    size_t nt = lu->tile_rows;
+    size_t slab_bytes = nt * tiled_tile_bytes(lu);
+    size_t nbuf = tiled_stream_bufs(budget, slab_bytes, 1);
+    if (nbuf == 0) {
+        return -1;
+    }
+    size_t wmax = min_size(out->tile_cols, budget / slab_bytes - nbuf);
+
+    double *bufs[TILED_STREAM_BUFS] = { NULL };
+    struct slab_ref *fwd = malloc(sizeof(struct slab_ref) * (nt > 0 ? nt : 1));
+    struct slab_ref *bwd = malloc(sizeof(struct slab_ref) * (nt > 0 ? nt : 1));
+    size_t *local = malloc(sizeof(size_t) * tile);
+    double *b = tiled_alloc(slab_bytes * wmax);
+    int rc = fwd != NULL && bwd != NULL && local != NULL && b != NULL ? 0 : -1;
+    for (size_t i = 0; i < nbuf && rc == 0; i++) {
+        bufs[i] = tiled_alloc(slab_bytes);
+        rc = bufs[i] != NULL ? 0 : -1;
+    }
+    for (size_t k = 0; k < nt; k++) {
+        fwd[k] = (struct slab_ref){ k, k, nt - k };
+        bwd[k] = (struct slab_ref){ 0, nt - 1 - k, nt - k };
+    }
+
+    struct tileio io;
+    if (rc == 0 && tileio_start(&io) != 0) {
+        rc = -1;
+    } else if (rc == 0) {
+        for (size_t c0 = 0; c0 < out->tile_cols && rc == 0; c0 += wmax) {
+            size_t wc = min_size(wmax, out->tile_cols - c0);
+            size_t ldb = wc * tile;
+
+            // The block of right-hand sides, gathered from its slabs
+            memset(b, 0, sizeof(double) * nt * tile * ldb);
+            for (size_t c = 0; c < wc && rc == 0; c++) {
+                if (rhs == NULL) {
+                    for (size_t j = 0; j < tile && (c0 + c) * tile + j < n; j++) {
+                        b[((c0 + c) * tile + j) * ldb + c * tile + j] = 1;
+                    }
+                    continue;
+                }
+                rc = tileio_read_full(
+                    rhs->fd, bufs[0], slab_bytes, tiled_offset(rhs, 0, c0 + c)
+                );
+                for (size_t i = 0; i < nt * tile && rc == 0; i++) {
+                    memcpy(&b[i * ldb + c * tile], &bufs[0][i * tile], sizeof(double) * tile);
+                }
+            }
+
+            struct slab_stream s;
+            double *slab;
+            if (rc == 0) {
+                stream_open(&s, &io, lu, fwd, nt, bufs, nbuf, false);
+                for (size_t k = 0; (slab = stream_next(&s)) != NULL; k++) {
+                    size_t k0 = k * tile;
+                    size_t w = min_size(tile, n - k0);
+                    for (size_t c = 0; c < w; c++) {
+                        local[c] = piv[k0 + c] - k0;
+                    }
+                    tiled_apply_panel(slab, tile, n - k0, w, local, &b[k0 * ldb], ldb, ldb);
+                    stream_release(&s);
+                }
+                rc = stream_close(&s);
+            }
+            if (rc == 0) {
+                stream_open(&s, &io, lu, bwd, nt, bufs, nbuf, false);
+                for (size_t k = nt; (slab = stream_next(&s)) != NULL;) {
+                    size_t k0 = --k * tile;
+                    tiled_apply_upper(slab, tile, k0, min_size(tile, n - k0), b, ldb, ldb);
+                    stream_release(&s);
+                }
+                rc = stream_close(&s);
+            }
+
+            for (size_t c = 0; c < wc && rc == 0; c++) {
+                for (size_t i = 0; i < nt * tile; i++) {
+                    memcpy(&bufs[0][i * tile], &b[i * ldb + c * tile], sizeof(double) * tile);
+                }
+                rc = tileio_write_full(
+                    out->fd, bufs[0], slab_bytes, tiled_offset(out, 0, c0 + c)
+                );
+            }
+        }
+        if (tileio_stop(&io) != 0) {
+            rc = -1;
+        }
+    }
+
+    for (size_t i = 0; i < nbuf; i++) {
+        free(bufs[i]);
+    }
+    free(b);
+    free(local);
+    free(fwd);
+    free(bwd);
+    return rc;
+}
+
+static bool tiled_same_tiling(struct mat2d_tiled *a, struct mat2d_tiled *b) {
+    return a->tile == b->tile;
+}
+
+int mat2d_tiled_lu_solve(
+    struct mat2d_tiled *lu,
+    const size_t *piv,
+    struct mat2d_tiled *rhs,
+    size_t budget
+) {
+    if (lu->rows != lu->cols || rhs->rows != lu->rows
+        || !tiled_same_tiling(lu, rhs)) {
+        return -1;
+    }
+    return tiled_solve(lu, piv, rhs, rhs, budget);
+}
+
+int mat2d_tiled_inv(struct mat2d_tiled *out, struct mat2d_tiled *in, size_t budget) {
+    if (in->rows != in->cols || out->rows != in->rows || out->cols != in->cols
+        || !tiled_same_tiling(in, out)) {
+        return -1;
+    }
+    size_t *piv = malloc(sizeof(size_t) * (in->rows > 0 ? in->rows : 1));
+    if (piv == NULL) {
+        return -1;
+    }
+    int rc = mat2d_tiled_lu_factor(in, piv, budget);
+    if (rc == 0) {
+        rc = tiled_solve(in, piv, NULL, out, budget);
+    }
+    free(piv);
+    return rc;
+}
+
+// C is built a block of tile columns at a time, held in memory as one
+// slab per tile column, while the tile columns of A stream past: block
+// column j of C takes A(:, p) * B(p, j) for every p. Each pass reads A
+// once, so the wider the block the budget allows, the fewer passes.
+int mat2d_tiled_dot(
+    struct mat2d_tiled *out,
+    struct mat2d_tiled *left,
+    struct mat2d_tiled *right,
+    size_t budget
+) {
+    if (left->cols != right->rows
+        || out->rows != left->rows || out->cols != right->cols
+        || !tiled_same_tiling(out, left) || !tiled_same_tiling(out, right)) {
+        return -1;
+    }
+    size_t tile = out->tile;
+    size_t mt = left->tile_rows;
+    size_t kt = left->tile_cols;
+    size_t slab_bytes = mt * tiled_tile_bytes(out);
+    // Each C tile column also needs its tile of B
+    size_t col_bytes = slab_bytes + tiled_tile_bytes(out);
+    if (budget < slab_bytes + col_bytes) {
+        return -1;
+    }
+    size_t nbuf = min_size(TILED_STREAM_BUFS, (budget - col_bytes) / slab_bytes);
+    size_t wmax = min_size((budget - nbuf * slab_bytes) / col_bytes, out->tile_cols);
+
+    double *bufs[TILED_STREAM_BUFS] = { NULL };
+    struct slab_ref *refs = malloc(sizeof(struct slab_ref) * (kt > 0 ? kt : 1));
+    double *c = tiled_alloc(slab_bytes * wmax);
+    double *b = tiled_alloc(tiled_tile_bytes(out) * wmax);
+    int rc = refs != NULL && c != NULL && b != NULL ? 0 : -1;
+    for (size_t i = 0; i < nbuf && rc == 0; i++) {
+        bufs[i] = tiled_alloc(slab_bytes);
+        rc = bufs[i] != NULL ? 0 : -1;
+    }
+    for (size_t p = 0; p < kt; p++) {
+        refs[p] = (struct slab_ref){ 0, p, mt };
+    }
+
+    struct tileio io;
+    if (rc == 0 && tileio_start(&io) != 0) {
+        rc = -1;
+    } else if (rc == 0) {
+        size_t m = out->rows;
+        for (size_t c0 = 0; c0 < out->tile_cols && rc == 0; c0 += wmax) {
+            size_t wc = min_size(wmax, out->tile_cols - c0);
+            memset(c, 0, slab_bytes * wc);
+
+            struct slab_stream s;
+            stream_open(&s, &io, left, refs, kt, bufs, nbuf, false);
+            double *a;
+            for (size_t p = 0; rc == 0 && (a = stream_next(&s)) != NULL; p++) {
+                size_t kw = min_size(tile, left->cols - p * tile);
+                for (size_t j = 0; j < wc && rc == 0; j++) {
+                    rc = tileio_read_full(
+                        right->fd, &b[j * tile * tile],
+                        tiled_tile_bytes(out), tiled_offset(right, p, c0 + j)
+                    );
+                }
+                for (size_t j = 0; j < wc && rc == 0; j++) {
+                    gemm_dgemm(
+                        m, tile, kw,
+                        1, a, tile, 1,
+                        &b[j * tile * tile], tile, 1,
+                        1, &c[j * mt * tile * tile], tile, 1
+                    );
+                }
+                stream_release(&s);
+            }
+            if (stream_close(&s) != 0) {
+                rc = -1;
+            }
+
+            for (size_t j = 0; j < wc && rc == 0; j++) {
+                rc = tileio_write_full(
+                    out->fd, &c[j * mt * tile * tile],
+                    slab_bytes, tiled_offset(out, 0, c0 + j)
+                );
+            }
+        }
+        if (tileio_stop(&io) != 0) {
+            rc = -1;
+        }
+    }
+
+    for (size_t i = 0; i < nbuf; i++) {
+        free(bufs[i]);
+    }
+    free(refs);
+    free(c);
+    free(b);
+    return rc;
+}
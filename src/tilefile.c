@@ -0,0 +1,424 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "libmatrix/matrix.h"
+
+#include "binfile.h"
+#include "lz.h"
+#include "matrix_internal.h"
+#include "tileio.h"
+
+// On-disk layout of a compressed tile file, all fields little-endian:
+//
+//    0  magic         "MAT2DTLZ"
+//    8  version       u32, TILEFILE_VERSION
+//   12  flags         u32, MAT2D_TILE_SHUFFLE
+//   16  rows          u64
+//   24  cols          u64
+//   32  tile_rows     u64
+//   40  tile_cols     u64
+//   48  index_offset  u64
+//   56  index_sum     u64, checksum of the index
+//
+// Tiles follow the header in tile-row-major order, each one compressed
+// on its own. Edge tiles keep their real shape. The index at the end
+// holds one entry per tile:
+//
+//    0  offset        u64
+//    8  csize         u32, stored bytes; a raw tile is at most UINT32_MAX
+//   12  flags         u32, TILE_STORED when csize is the raw size
+//   16  checksum      u64, of the raw little-endian tile
+//
+// A tile decodes to its rows one after another, byte-shuffled first
+// when the file has MAT2D_TILE_SHUFFLE.
+
+#define TILEFILE_MAGIC "MAT2DTLZ"
+#define TILEFILE_MAGIC_SIZE 8
+#define TILEFILE_VERSION 1
+#define TILEFILE_HEADER_SIZE 64
+#define TILEFILE_ENTRY_SIZE 24
+
+// Compression did not pay off and the tile is kept raw
+#define TILE_STORED (1u << 0)
+
+struct tile_entry {
+    uint64_t offset;
+    uint32_t csize;
+    uint32_t flags;
+    uint64_t checksum;
+};
+
+struct mat2d_tilefile {
+    int fd;
+    unsigned flags;
+    size_t rows, cols;
+    size_t tile_rows, tile_cols;
+    // Tile counts
+    size_t nti, ntj;
+    struct tile_entry *index;
+};
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static uint64_t tile_sum(const void *data, size_t bytes) {
+    struct binfile_sum sum;
+    binfile_sum_init(&sum);
+    binfile_sum_update(&sum, data, bytes);
+    return binfile_sum_final(&sum);
+}
+
+// Scratch for one tile in each of its three forms
+struct tile_bufs {
+    double *tile;
+    unsigned char *raw;
+    unsigned char *packed;
+    size_t packed_cap;
+};
+
+static int tile_bufs_init(struct tile_bufs *b, size_t tile_rows, size_t tile_cols) {
+    size_t bytes = sizeof(double) * tile_rows * tile_cols;
+    b->packed_cap = LZ_BOUND(bytes);
+    b->tile = malloc(bytes > 0 ? bytes : 1);
+    b->raw = malloc(bytes > 0 ? bytes : 1);
+    b->packed = malloc(b->packed_cap);
+    return b->tile != NULL && b->raw != NULL && b->packed != NULL ? 0 : -1;
+}
+
+static void tile_bufs_destroy(struct tile_bufs *b) {
+    free(b->tile);
+    free(b->raw);
+    free(b->packed);
+}
+
+int mat2d_write_to_tilefile(
+    const struct mat2d *mat,
+    const char *filename,
+    size_t tile_rows, size_t tile_cols,
+    unsigned flags
+) {
+    // A stored tile's size has to fit the u32 csize of its index entry
+    if (tile_rows == 0 || tile_cols == 0
+        || tile_rows > UINT32_MAX / sizeof(double) / tile_cols) {
+        return -1;
+    }
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        return -1;
+    }
+
+    size_t nti = (mat->rows + tile_rows - 1) / tile_rows;
+    size_t ntj = (mat->cols + tile_cols - 1) / tile_cols;
+    size_t index_bytes = TILEFILE_ENTRY_SIZE * nti * ntj;
+    unsigned char *index = malloc(index_bytes > 0 ? index_bytes : 1);
+    int rc = index != NULL ? 0 : -1;
+
+    unsigned char hdr[TILEFILE_HEADER_SIZE] = { 0 };
+    if (rc == 0 && fwrite(hdr, 1, sizeof(hdr), file) != sizeof(hdr)) {
+        rc = -1;
+    }
+
+    // Tiles are encoded on all threads into per-thread buffers and
+    // written in tile order
+    uint64_t offset = TILEFILE_HEADER_SIZE;
+    size_t ntiles = rc == 0 ? nti * ntj : 0;
+    #pragma omp parallel
+    {
+        struct tile_bufs b;
+        int local_rc = tile_bufs_init(&b, tile_rows, tile_cols);
+
+        #pragma omp for ordered schedule(static, 1)
+        for (size_t t = 0; t < ntiles; t++) {
+            size_t ti = t / ntj;
+            size_t tj = t % ntj;
+            size_t r = min_size(tile_rows, mat->rows - ti * tile_rows);
+            size_t c = min_size(tile_cols, mat->cols - tj * tile_cols);
+            size_t words = r * c;
+            size_t bytes = sizeof(double) * words;
+            uint64_t checksum = 0;
+            const void *data = b.tile;
+            size_t csize = bytes;
+            uint32_t tflags = TILE_STORED;
+            if (local_rc == 0) {
+                for (size_t i = 0; i < r; i++) {
+                    const double *src = mat2d_at(mat, ti * tile_rows + i, tj * tile_cols);
+                    for (size_t j = 0; j < c; j++) {
+                        b.tile[i * c + j] = src[j * mat->cs];
+                    }
+                }
+                binfile_swap_words(b.tile, words);
+                checksum = tile_sum(b.tile, bytes);
+
+                if (flags & MAT2D_TILE_SHUFFLE) {
+                    lz_shuffle8(b.tile, b.raw, words);
+                    data = b.raw;
+                }
+                csize = lz_compress(data, bytes, b.packed, b.packed_cap);
+                if (csize == 0 || csize >= bytes) {
+                    // Stored tiles skip the shuffle too
+                    csize = bytes;
+                    data = b.tile;
+                } else {
+                    tflags = 0;
+                    data = b.packed;
+                }
+            }
+
+            #pragma omp ordered
+            {
+                if (local_rc != 0) {
+                    rc = -1;
+                }
+                if (rc == 0 && fwrite(data, 1, csize, file) != csize) {
+                    rc = -1;
+                }
+
+                unsigned char *e = &index[TILEFILE_ENTRY_SIZE * t];
+                binfile_store_le64(&e[0], offset);
+                binfile_store_le32(&e[8], (uint32_t)csize);
+                binfile_store_le32(&e[12], tflags);
+                binfile_store_le64(&e[16], checksum);
+                offset += csize;
+            }
+        }
+
+        tile_bufs_destroy(&b);
+    }
+
+    if (rc == 0 && fwrite(index, 1, index_bytes, file) != index_bytes) {
+        rc = -1;
+    }
+    if (rc == 0) {
+        memcpy(hdr, TILEFILE_MAGIC, TILEFILE_MAGIC_SIZE);
+        binfile_store_le32(&hdr[8], TILEFILE_VERSION);
+        binfile_store_le32(&hdr[12], flags & MAT2D_TILE_SHUFFLE);
+        binfile_store_le64(&hdr[16], mat->rows);
+        binfile_store_le64(&hdr[24], mat->cols);
+        binfile_store_le64(&hdr[32], tile_rows);
+        binfile_store_le64(&hdr[40], tile_cols);
+        binfile_store_le64(&hdr[48], offset);
+        binfile_store_le64(&hdr[56], tile_sum(index, index_bytes));
+        if (fseek(file, 0, SEEK_SET) != 0
+            || fwrite(hdr, 1, sizeof(hdr), file) != sizeof(hdr)) {
+            rc = -1;
+        }
+    }
+
+    if (fclose(file) != 0) {
+        rc = -1;
+    }
+    free(index);
+    return rc;
+}
+
+struct mat2d_tilefile *mat2d_tilefile_open(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct mat2d_tilefile *f = calloc(1, sizeof(struct mat2d_tilefile));
+    unsigned char hdr[TILEFILE_HEADER_SIZE];
+    struct stat st;
+    if (f == NULL || fstat(fd, &st) != 0
+        || tileio_read_full(fd, hdr, sizeof(hdr), 0) != 0
+        || memcmp(hdr, TILEFILE_MAGIC, TILEFILE_MAGIC_SIZE) != 0
+        || binfile_load_le32(&hdr[8]) != TILEFILE_VERSION) {
+        free(f);
+        close(fd);
+        return NULL;
+    }
+
+    f->fd = fd;
+    f->flags = binfile_load_le32(&hdr[12]);
+    f->rows = binfile_load_le64(&hdr[16]);
+    f->cols = binfile_load_le64(&hdr[24]);
+    f->tile_rows = binfile_load_le64(&hdr[32]);
+    f->tile_cols = binfile_load_le64(&hdr[40]);
+    uint64_t index_offset = binfile_load_le64(&hdr[48]);
+    if (f->tile_rows == 0 || f->tile_cols == 0
+        || f->tile_rows > UINT32_MAX / sizeof(double) / f->tile_cols) {
+        mat2d_tilefile_close(f);
+        return NULL;
+    }
+    f->nti = (f->rows + f->tile_rows - 1) / f->tile_rows;
+    f->ntj = (f->cols + f->tile_cols - 1) / f->tile_cols;
+
+    size_t count = f->nti * f->ntj;
+    size_t index_bytes = TILEFILE_ENTRY_SIZE * count;
+    if (index_offset < TILEFILE_HEADER_SIZE
+        || index_offset > (uint64_t)st.st_size
+        || index_bytes / TILEFILE_ENTRY_SIZE != count
+        || (uint64_t)st.st_size - index_offset != index_bytes) {
+        mat2d_tilefile_close(f);
+        return NULL;
+    }
+
+    unsigned char *raw = malloc(index_bytes > 0 ? index_bytes : 1);
+    f->index = malloc(sizeof(struct tile_entry) * (count > 0 ? count : 1));
+    int rc = raw != NULL && f->index != NULL ? 0 : -1;
+    if (rc == 0 && (tileio_read_full(fd, raw, index_bytes, index_offset) != 0
+        || tile_sum(raw, index_bytes) != binfile_load_le64(&hdr[56]))) {
+        rc = -1;
+    }
+    for (size_t t = 0; t < count && rc == 0; t++) {
+        const unsigned char *e = &raw[TILEFILE_ENTRY_SIZE * t];
+        struct tile_entry *entry = &f->index[t];
+        entry->offset = binfile_load_le64(&e[0]);
+        entry->csize = binfile_load_le32(&e[8]);
+        entry->flags = binfile_load_le32(&e[12]);
+        entry->checksum = binfile_load_le64(&e[16]);
+        if (entry->offset < TILEFILE_HEADER_SIZE
+            || entry->offset > index_offset
+            || entry->csize > index_offset - entry->offset) {
+            rc = -1;
+        }
+    }
+    free(raw);
+    if (rc != 0) {
+        mat2d_tilefile_close(f);
+        return NULL;
+    }
+    return f;
+}
+
+void mat2d_tilefile_close(struct mat2d_tilefile *f) {
+    if (f == NULL) {
+        return;
+    }
+    close(f->fd);
+    free(f->index);
+    free(f);
+}
+
+size_t mat2d_tilefile_get_rows(struct mat2d_tilefile *f) {
+    return f->rows;
+}
+
+size_t mat2d_tilefile_get_cols(struct mat2d_tilefile *f) {
+    return f->cols;
+}
+
+size_t mat2d_tilefile_get_tile_rows(struct mat2d_tilefile *f) {
+    return f->tile_rows;
+}
+
+size_t mat2d_tilefile_get_tile_cols(struct mat2d_tilefile *f) {
+    return f->tile_cols;
+}
+
+// Fetches, decodes and verifies tile (ti, tj) into b->tile as r x c
+// host doubles
+static int tile_load(
+    struct mat2d_tilefile *f,
+    size_t ti, size_t tj,
+    size_t r, size_t c,
+    struct tile_bufs *b
+) {
+    const struct tile_entry *e = &f->index[ti * f->ntj + tj];
+    size_t words = r * c;
+    size_t bytes = sizeof(double) * words;
+
+    if (e->flags & TILE_STORED) {
+        if (e->csize != bytes
+            || tileio_read_full(f->fd, b->tile, bytes, e->offset) != 0) {
+            return -1;
+        }
+    } else {
+        void *decoded = (f->flags & MAT2D_TILE_SHUFFLE) ? (void *)b->raw : (void *)b->tile;
+        if (e->csize > b->packed_cap
+            || tileio_read_full(f->fd, b->packed, e->csize, e->offset) != 0
+            || lz_decompress(b->packed, e->csize, decoded, bytes) != 0) {
+            return -1;
+        }
+        if (f->flags & MAT2D_TILE_SHUFFLE) {
+            lz_unshuffle8(b->raw, b->tile, words);
+        }
+    }
+
+    if (tile_sum(b->tile, bytes) != e->checksum) {
+        return -1;
+    }
+    binfile_swap_words(b->tile, words);
+    return 0;
+}
+
+// Touches only the tiles that overlap the block
+int mat2d_tilefile_read_block(
+    struct mat2d_tilefile *f,
+    size_t row, size_t col,
+    struct mat2d *dst
+) {
+    if (row + dst->rows > f->rows || col + dst->cols > f->cols) {
+        return -1;
+    }
+    if (dst->rows == 0 || dst->cols == 0) {
+        return 0;
+    }
+
+    // Tiles come off pread and are decoded on all threads, each into its
+    // own part of dst; compressed sizes differ, hence guided
+    size_t ti_first = row / f->tile_rows;
+    size_t tj_first = col / f->tile_cols;
+    size_t nti = (row + dst->rows - 1) / f->tile_rows - ti_first + 1;
+    size_t ntj = (col + dst->cols - 1) / f->tile_cols - tj_first + 1;
+    int failed = 0;
+    #pragma omp parallel reduction(|:failed) if(nti * ntj > 1)
+    {
+        struct tile_bufs b;
+        if (tile_bufs_init(&b, f->tile_rows, f->tile_cols) != 0) {
+            failed = 1;
+        }
+
+        #pragma omp for schedule(guided)
+        for (size_t t = 0; t < nti * ntj; t++) {
+            size_t ti = ti_first + t / ntj;
+            size_t tj = tj_first + t % ntj;
+            size_t r0 = ti * f->tile_rows;
+            size_t c0 = tj * f->tile_cols;
+            size_t r = min_size(f->tile_rows, f->rows - r0);
+            size_t c = min_size(f->tile_cols, f->cols - c0);
+            if (failed || tile_load(f, ti, tj, r, c, &b) != 0) {
+                failed = 1;
+                continue;
+            }
+
+            // Overlap of the tile and the block, in matrix coordinates
+            size_t i0 = r0 > row ? r0 : row;
+            size_t j0 = c0 > col ? c0 : col;
+            size_t i1 = min_size(r0 + r, row + dst->rows);
+            size_t j1 = min_size(c0 + c, col + dst->cols);
+            for (size_t i = i0; i < i1; i++) {
+                const double *src = &b.tile[(i - r0) * c + (j0 - c0)];
+                double *out = mat2d_at(dst, i - row, j0 - col);
+                for (size_t j = 0; j < j1 - j0; j++) {
+                    out[j * dst->cs] = src[j];
+                }
+            }
+        }
+
+        tile_bufs_destroy(&b);
+    }
+    return failed ? -1 : 0;
+}
+
+int mat2d_read_from_tilefile(struct mat2d **out, const char *filename) {
+    struct mat2d_tilefile *f = mat2d_tilefile_open(filename);
+    if (f == NULL) {
+        return -1;
+    }
+    struct mat2d *mat = mat2d_create(f->rows, f->cols);
+    int rc = mat != NULL ? mat2d_tilefile_read_block(f, 0, 0, mat) : -1;
+    mat2d_tilefile_close(f);
+    if (rc != 0) {
+        mat2d_destroy(mat);
+        return -1;
+    }
+    *out = mat;
+    return 0;
+}
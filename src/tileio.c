@@ -0,0 +1,143 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include "tileio.h"
+
+int tileio_read_full(int fd, void *buf, size_t bytes, off_t offset) {
+    char *p = buf;
+    while (bytes > 0) {
+        ssize_t got = pread(fd, p, bytes, offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        p += got;
+        bytes -= got;
+        offset += got;
+    }
+    return 0;
+}
+
+int tileio_write_full(int fd, const void *buf, size_t bytes, off_t offset) {
+    const char *p = buf;
+    while (bytes > 0) {
+        ssize_t put = pwrite(fd, p, bytes, offset);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            return -1;
+        }
+        p += put;
+        bytes -= put;
+        offset += put;
+    }
+    return 0;
+}
+
+static void *tileio_worker(void *arg) {
+    struct tileio *io = arg;
+    pthread_mutex_lock(&io->lock);
+    for (;;) {
+        while (io->head == NULL && !io->stop) {
+            pthread_cond_wait(&io->cond, &io->lock);
+        }
+        struct tileio_req *req = io->head;
+        if (req == NULL) {
+            break;
+        }
+        pthread_mutex_unlock(&io->lock);
+
+        int rc = req->write
+            ? tileio_write_full(req->fd, req->buf, req->bytes, req->offset)
+            : tileio_read_full(req->fd, req->buf, req->bytes, req->offset);
+
+        pthread_mutex_lock(&io->lock);
+        io->head = req->next;
+        if (io->head == NULL) {
+            io->tail = NULL;
+        }
+        req->rc = rc;
+        req->done = true;
+        if (rc != 0) {
+            io->failed = true;
+        }
+        pthread_cond_broadcast(&io->cond);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return NULL;
+}
+
+int tileio_start(struct tileio *io) {
+    io->head = NULL;
+    io->tail = NULL;
+    io->stop = false;
+    io->failed = false;
+    if (pthread_mutex_init(&io->lock, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_cond_init(&io->cond, NULL) != 0) {
+        pthread_mutex_destroy(&io->lock);
+        return -1;
+    }
+    if (pthread_create(&io->thread, NULL, tileio_worker, io) != 0) {
+        pthread_cond_destroy(&io->cond);
+        pthread_mutex_destroy(&io->lock);
+        return -1;
+    }
+    return 0;
+}
+
+int tileio_stop(struct tileio *io) {
+    pthread_mutex_lock(&io->lock);
+    io->stop = true;
+    pthread_cond_broadcast(&io->cond);
+    pthread_mutex_unlock(&io->lock);
+    pthread_join(io->thread, NULL);
+
+    pthread_cond_destroy(&io->cond);
+    pthread_mutex_destroy(&io->lock);
+    return io->failed ? -1 : 0;
+}
+
+void tileio_req_init(struct tileio_req *req) {
+    req->done = true;
+    req->rc = 0;
+    req->next = NULL;
+}
+
+void tileio_submit(
+    struct tileio *io, struct tileio_req *req,
+    int fd, bool write, void *buf, size_t bytes, off_t offset
+) {
+    req->fd = fd;
+    req->write = write;
+    req->buf = buf;
+    req->bytes = bytes;
+    req->offset = offset;
+    req->done = false;
+    req->rc = 0;
+    req->next = NULL;
+
+    pthread_mutex_lock(&io->lock);
+    if (io->tail != NULL) {
+        io->tail->next = req;
+    } else {
+        io->head = req;
+    }
+    io->tail = req;
+    pthread_cond_broadcast(&io->cond);
+    pthread_mutex_unlock(&io->lock);
+}
+
+int tileio_wait(struct tileio *io, struct tileio_req *req) {
+    pthread_mutex_lock(&io->lock);
+    while (!req->done) {
+        pthread_cond_wait(&io->cond, &io->lock);
+    }
+    int rc = req->rc;
+    pthread_mutex_unlock(&io->lock);
+    return rc;
+}
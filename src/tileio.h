@@ -0,0 +1,55 @@
+#ifndef TILEIO_H
+#define TILEIO_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// Background file I/O for the out-of-core drivers: one worker thread
+// serves positioned reads and writes in submission order, so compute
+// overlaps prefetch and write-behind. Because the order is kept, a read
+// into a buffer queued after a write from the same buffer starts only
+// once that write is done.
+
+struct tileio_req {
+    int fd;
+    bool write;
+    void *buf;
+    size_t bytes;
+    off_t offset;
+    // Owned by the worker between tileio_submit and completion
+    bool done;
+    int rc;
+    struct tileio_req *next;
+};
+
+struct tileio {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct tileio_req *head, *tail;
+    bool stop;
+    // Some request failed since tileio_start
+    bool failed;
+};
+
+int tileio_start(struct tileio *io);
+// Finishes every queued request and joins the worker. Returns -1 if any
+// request failed, including writes nobody waited for.
+int tileio_stop(struct tileio *io);
+
+// Initializes a request as already complete, so waiting on one that was
+// never submitted returns at once
+void tileio_req_init(struct tileio_req *req);
+void tileio_submit(
+    struct tileio *io, struct tileio_req *req,
+    int fd, bool write, void *buf, size_t bytes, off_t offset
+);
+int tileio_wait(struct tileio *io, struct tileio_req *req);
+
+// Synchronous positioned I/O that retries short transfers
+int tileio_read_full(int fd, void *buf, size_t bytes, off_t offset);
+int tileio_write_full(int fd, const void *buf, size_t bytes, off_t offset);
+
+#endif
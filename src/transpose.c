@@ -0,0 +1,296 @@
+#include <stddef.h>
+
+#include <immintrin.h>
+
+#include "cpu.h"
+#include "transpose.h"
+
+// Recursion stops once a block fits comfortably in L1
+#define TRANSPOSE_LEAF 32
+
+// Threads split blocks of this many elements a side, and only once
+// there are at least TRANSPOSE_PAR_MIN elements
+#define TRANSPOSE_PAR_BLOCK 256
+#define TRANSPOSE_PAR_MIN (1 << 16)
+
+typedef void (*transpose_leaf_fn)(
+    size_t m, size_t n,
+    const double *a, size_t lda,
+    double *b, size_t ldb
+);
+
+typedef void (*swap_leaf_fn)(
+    size_t m, size_t n,
+    double *x, size_t ldx,
+    double *y, size_t ldy
+);
+
+typedef void (*inplace_leaf_fn)(size_t n, double *a, size_t lda);
+
+struct transpose_kernels {
+    transpose_leaf_fn transpose;
+    swap_leaf_fn swap;
+    inplace_leaf_fn inplace;
+};
+
+// Splits n in two, keeping the first half a multiple of the 4x4 tile
+static size_t split_half(size_t n) {
+    size_t half = (n / 2 + 3) & ~(size_t)3;
+    return half < n ? half : n / 2;
+}
+
+static void transpose_leaf_scalar(
+    size_t m, size_t n,
+    const double *a, size_t lda,
+    double *b, size_t ldb
+) {
+    for (size_t i = 0; i < m; i++) {
+        const double *arow = &a[i * lda];
+        for (size_t j = 0; j < n; j++) {
+            b[j * ldb + i] = arow[j];
+        }
+    }
+}
+
+// Swaps the m x n block X with the transpose of the n x m block Y
+static void swap_leaf_scalar(
+    size_t m, size_t n,
+    double *x, size_t ldx,
+    double *y, size_t ldy
+) {
+    for (size_t i = 0; i < m; i++) {
+        double *xrow = &x[i * ldx];
+        for (size_t j = 0; j < n; j++) {
+            double tmp = xrow[j];
+            xrow[j] = y[j * ldy + i];
+            y[j * ldy + i] = tmp;
+        }
+    }
+}
+
+static void inplace_leaf_scalar(size_t n, double *a, size_t lda) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            double tmp = a[i * lda + j];
+            a[i * lda + j] = a[j * lda + i];
+            a[j * lda + i] = tmp;
+        }
+    }
+}
+
+#define TRANSPOSE_AVX_4X4(r0, r1, r2, r3)                                   \
+    do {                                                                    \
+        __m256d t0 = _mm256_unpacklo_pd(r0, r1);                            \
+        __m256d t1 = _mm256_unpackhi_pd(r0, r1);                            \
+        __m256d t2 = _mm256_unpacklo_pd(r2, r3);                            \
+        __m256d t3 = _mm256_unpackhi_pd(r2, r3);                            \
+        r0 = _mm256_permute2f128_pd(t0, t2, 0x20);                          \
+        r1 = _mm256_permute2f128_pd(t1, t3, 0x20);                          \
+        r2 = _mm256_permute2f128_pd(t0, t2, 0x31);                          \
+        r3 = _mm256_permute2f128_pd(t1, t3, 0x31);                          \
+    } while (0)
+
+__attribute__((target("avx")))
+static inline void tile_transpose_avx(
+    const double *a, size_t lda,
+    double *b, size_t ldb
+) {
+    __m256d r0 = _mm256_loadu_pd(a);
+    __m256d r1 = _mm256_loadu_pd(a + lda);
+    __m256d r2 = _mm256_loadu_pd(a + 2 * lda);
+    __m256d r3 = _mm256_loadu_pd(a + 3 * lda);
+    TRANSPOSE_AVX_4X4(r0, r1, r2, r3);
+    _mm256_storeu_pd(b, r0);
+    _mm256_storeu_pd(b + ldb, r1);
+    _mm256_storeu_pd(b + 2 * ldb, r2);
+    _mm256_storeu_pd(b + 3 * ldb, r3);
+}
+
+__attribute__((target("avx")))
+static inline void tile_swap_avx(
+    double *x, size_t ldx,
+    double *y, size_t ldy
+) {
+    __m256d x0 = _mm256_loadu_pd(x);
+    __m256d x1 = _mm256_loadu_pd(x + ldx);
+    __m256d x2 = _mm256_loadu_pd(x + 2 * ldx);
+    __m256d x3 = _mm256_loadu_pd(x + 3 * ldx);
+    __m256d y0 = _mm256_loadu_pd(y);
+    __m256d y1 = _mm256_loadu_pd(y + ldy);
+    __m256d y2 = _mm256_loadu_pd(y + 2 * ldy);
+    __m256d y3 = _mm256_loadu_pd(y + 3 * ldy);
+    TRANSPOSE_AVX_4X4(x0, x1, x2, x3);
+    TRANSPOSE_AVX_4X4(y0, y1, y2, y3);
+    _mm256_storeu_pd(x, y0);
+    _mm256_storeu_pd(x + ldx, y1);
+    _mm256_storeu_pd(x + 2 * ldx, y2);
+    _mm256_storeu_pd(x + 3 * ldx, y3);
+    _mm256_storeu_pd(y, x0);
+    _mm256_storeu_pd(y + ldy, x1);
+    _mm256_storeu_pd(y + 2 * ldy, x2);
+    _mm256_storeu_pd(y + 3 * ldy, x3);
+}
+
+__attribute__((target("avx")))
+static void transpose_leaf_avx(
+    size_t m, size_t n,
+    const double *a, size_t lda,
+    double *b, size_t ldb
+) {
+    size_t m4 = m & ~(size_t)3;
+    size_t n4 = n & ~(size_t)3;
+    for (size_t i = 0; i < m4; i += 4) {
+        for (size_t j = 0; j < n4; j += 4) {
+            tile_transpose_avx(&a[i * lda + j], lda, &b[j * ldb + i], ldb);
+        }
+    }
+    transpose_leaf_scalar(m4, n - n4, &a[n4], lda, &b[n4 * ldb], ldb);
+    transpose_leaf_scalar(m - m4, n, &a[m4 * lda], lda, &b[m4], ldb);
+}
+
+__attribute__((target("avx")))
+static void swap_leaf_avx(
+    size_t m, size_t n,
+    double *x, size_t ldx,
+    double *y, size_t ldy
+) {
+    size_t m4 = m & ~(size_t)3;
+    size_t n4 = n & ~(size_t)3;
+    for (size_t i = 0; i < m4; i += 4) {
+        for (size_t j = 0; j < n4; j += 4) {
+            tile_swap_avx(&x[i * ldx + j], ldx, &y[j * ldy + i], ldy);
+        }
+    }
+    swap_leaf_scalar(m4, n - n4, &x[n4], ldx, &y[n4 * ldy], ldy);
+    swap_leaf_scalar(m - m4, n, &x[m4 * ldx], ldx, &y[m4], ldy);
+}
+
+__attribute__((target("avx")))
+static void inplace_leaf_avx(size_t n, double *a, size_t lda) {
+    size_t n4 = n & ~(size_t)3;
+    for (size_t i = 0; i < n4; i += 4) {
+        double *diag = &a[i * lda + i];
+        __m256d r0 = _mm256_loadu_pd(diag);
+        __m256d r1 = _mm256_loadu_pd(diag + lda);
+        __m256d r2 = _mm256_loadu_pd(diag + 2 * lda);
+        __m256d r3 = _mm256_loadu_pd(diag + 3 * lda);
+        TRANSPOSE_AVX_4X4(r0, r1, r2, r3);
+        _mm256_storeu_pd(diag, r0);
+        _mm256_storeu_pd(diag + lda, r1);
+        _mm256_storeu_pd(diag + 2 * lda, r2);
+        _mm256_storeu_pd(diag + 3 * lda, r3);
+        for (size_t j = i + 4; j < n4; j += 4) {
+            tile_swap_avx(&a[i * lda + j], lda, &a[j * lda + i], lda);
+        }
+    }
+    // Trailing columns pair up with trailing rows
+    for (size_t j = n4; j < n; j++) {
+        for (size_t i = 0; i < j; i++) {
+            double tmp = a[i * lda + j];
+            a[i * lda + j] = a[j * lda + i];
+            a[j * lda + i] = tmp;
+        }
+    }
+}
+
+static const struct transpose_kernels *transpose_get_kernels(void) {
+    static const struct transpose_kernels scalar = {
+        transpose_leaf_scalar, swap_leaf_scalar, inplace_leaf_scalar
+    };
+    static const struct transpose_kernels avx = {
+        transpose_leaf_avx, swap_leaf_avx, inplace_leaf_avx
+    };
+    return cpu_get_level() >= CPU_LEVEL_AVX2 ? &avx : &scalar;
+}
+
+static void transpose_rec(
+    const struct transpose_kernels *k,
+    size_t m, size_t n,
+    const double *a, size_t lda,
+    double *b, size_t ldb
+) {
+    if (m <= TRANSPOSE_LEAF && n <= TRANSPOSE_LEAF) {
+        k->transpose(m, n, a, lda, b, ldb);
+    } else if (m >= n) {
+        size_t m1 = split_half(m);
+        transpose_rec(k, m1, n, a, lda, b, ldb);
+        transpose_rec(k, m - m1, n, &a[m1 * lda], lda, &b[m1], ldb);
+    } else {
+        size_t n1 = split_half(n);
+        transpose_rec(k, m, n1, a, lda, b, ldb);
+        transpose_rec(k, m, n - n1, &a[n1], lda, &b[n1 * ldb], ldb);
+    }
+}
+
+static void swap_rec(
+    const struct transpose_kernels *k,
+    size_t m, size_t n,
+    double *x, size_t ldx,
+    double *y, size_t ldy
+) {
+    if (m <= TRANSPOSE_LEAF && n <= TRANSPOSE_LEAF) {
+        k->swap(m, n, x, ldx, y, ldy);
+    } else if (m >= n) {
+        size_t m1 = split_half(m);
+        swap_rec(k, m1, n, x, ldx, y, ldy);
+        swap_rec(k, m - m1, n, &x[m1 * ldx], ldx, &y[m1], ldy);
+    } else {
+        size_t n1 = split_half(n);
+        swap_rec(k, m, n1, x, ldx, y, ldy);
+        swap_rec(k, m, n - n1, &x[n1], ldx, &y[n1 * ldy], ldy);
+    }
+}
+
+// Transposes both diagonal quadrants in place and swaps the off-diagonal
+// ones through their transposes
+static void inplace_rec(
+    const struct transpose_kernels *k,
+    size_t n, double *a, size_t lda
+) {
+    if (n <= TRANSPOSE_LEAF) {
+        k->inplace(n, a, lda);
+        return;
+    }
+    size_t n1 = split_half(n);
+    inplace_rec(k, n1, a, lda);
+    inplace_rec(k, n - n1, &a[n1 * lda + n1], lda);
+    swap_rec(k, n1, n - n1, &a[n1], lda, &a[n1 * lda], lda);
+}
+
+// Each thread takes whole blocks of rows of A, which are blocks of
+// columns of B
+void transpose_d(
+    size_t m, size_t n,
+    const double *a, size_t lda,
+    double *b, size_t ldb
+) {
+    if (m == 0 || n == 0) {
+        return;
+    }
+    const struct transpose_kernels *k = transpose_get_kernels();
+    #pragma omp parallel for schedule(static) if(m * n >= TRANSPOSE_PAR_MIN)
+    for (size_t i0 = 0; i0 < m; i0 += TRANSPOSE_PAR_BLOCK) {
+        size_t mb = m - i0 < TRANSPOSE_PAR_BLOCK ? m - i0 : TRANSPOSE_PAR_BLOCK;
+        transpose_rec(k, mb, n, &a[i0 * lda], lda, &b[i0], ldb);
+    }
+}
+
+// Block row bi transposes its diagonal block and swaps the blocks right
+// of it with those below; rows get shorter going down, hence guided
+void transpose_inplace_d(size_t n, double *a, size_t lda) {
+    if (n < 2) {
+        return;
+    }
+    const struct transpose_kernels *k = transpose_get_kernels();
+    size_t nblocks = (n + TRANSPOSE_PAR_BLOCK - 1) / TRANSPOSE_PAR_BLOCK;
+    #pragma omp parallel for schedule(guided) if(n * n >= TRANSPOSE_PAR_MIN)
+    for (size_t bi = 0; bi < nblocks; bi++) {
+        size_t i0 = bi * TRANSPOSE_PAR_BLOCK;
+        size_t ib = n - i0 < TRANSPOSE_PAR_BLOCK ? n - i0 : TRANSPOSE_PAR_BLOCK;
+        inplace_rec(k, ib, &a[i0 * lda + i0], lda);
+        for (size_t j0 = i0 + ib; j0 < n; j0 += TRANSPOSE_PAR_BLOCK) {
+            size_t jb = n - j0 < TRANSPOSE_PAR_BLOCK ? n - j0 : TRANSPOSE_PAR_BLOCK;
+            swap_rec(k, ib, jb, &a[i0 * lda + j0], lda, &a[j0 * lda + i0], lda);
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#include <stddef.h>
+
+// B = A^T for a row-major m x n block A; B is n x m. A and B must not
+// overlap.
+void transpose_d(
+    size_t m, size_t n,
+    const double *a, size_t lda,
+    double *b, size_t ldb
+);
+
+// A = A^T for a square n x n block
+void transpose_inplace_d(size_t n, double *a, size_t lda);
+
+#endif